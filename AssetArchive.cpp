@@ -0,0 +1,132 @@
+#include "AssetArchive.h"
+#include <stdexcept>
+#include <cstring>
+
+#ifdef HAVE_LZ4
+# include <lz4.h>
+#endif
+
+uint64_t	fnv1a64(const char* data, size_t size) {
+	uint64_t	hash = 0xcbf29ce484222325ull;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= static_cast<unsigned char>(data[i]);
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+static bool	inBounds(uint64_t offset, uint64_t size, uint64_t fileSize) {
+	return offset <= fileSize && size <= fileSize - offset;
+}
+
+void	AssetArchive::open(const std::string& filename) {
+	MappedFile	mapped(filename, MapHint::Random);
+
+	if (mapped.size() < sizeof(ArchiveHeader)) {
+		throw std::runtime_error("asset archive " + filename + " is truncated");
+	}
+
+	const ArchiveHeader*	mappedHeader = reinterpret_cast<const ArchiveHeader*>(mapped.data());
+
+	if (mappedHeader->magic != ARCHIVE_MAGIC || mappedHeader->version != ARCHIVE_VERSION) {
+		throw std::runtime_error("asset archive " + filename + " has an unsupported format");
+	}
+
+	if (mappedHeader->bucketCount == 0 || (mappedHeader->bucketCount & (mappedHeader->bucketCount - 1)) != 0
+			|| mappedHeader->bucketCount <= mappedHeader->entryCount
+			|| !inBounds(mappedHeader->bucketsOffset, uint64_t(mappedHeader->bucketCount) * sizeof(uint32_t), mapped.size())
+			|| !inBounds(mappedHeader->entriesOffset, uint64_t(mappedHeader->entryCount) * sizeof(ArchiveEntry), mapped.size())
+			|| !inBounds(mappedHeader->namesOffset, mappedHeader->namesSize, mapped.size())) {
+		throw std::runtime_error("asset archive " + filename + " has a corrupt index");
+	}
+
+	const ArchiveEntry*	mappedEntries = reinterpret_cast<const ArchiveEntry*>(mapped.data() + mappedHeader->entriesOffset);
+
+	// Uncompressed payloads and decoded images are handed out at their
+	// stated size, so that size has to match what is stored
+	for (uint32_t i = 0; i < mappedHeader->entryCount; i++) {
+		const ArchiveEntry&	entry = mappedEntries[i];
+
+		if (!inBounds(entry.offset, entry.storedSize, mapped.size())
+				|| !inBounds(entry.nameOffset, entry.nameLength, mappedHeader->namesSize)
+				|| (entry.compression == AssetCompression::None && entry.size != entry.storedSize)
+				|| (entry.type == AssetType::Image && entry.size != uint64_t(entry.width) * entry.height * 4)) {
+			throw std::runtime_error("asset archive " + filename + " has a corrupt entry");
+		}
+	}
+
+	file = std::move(mapped);
+	header = reinterpret_cast<const ArchiveHeader*>(file.data());
+	buckets = reinterpret_cast<const uint32_t*>(file.data() + header->bucketsOffset);
+	entries = reinterpret_cast<const ArchiveEntry*>(file.data() + header->entriesOffset);
+	names = file.data() + header->namesOffset;
+}
+
+bool	AssetArchive::isOpen(void) const {
+	return header != nullptr;
+}
+
+uint32_t	AssetArchive::getEntryCount(void) const {
+	return header != nullptr ? header->entryCount : 0;
+}
+
+const ArchiveEntry*	AssetArchive::find(const std::string& name) const {
+	uint64_t	hash;
+	uint32_t	mask;
+
+	if (header == nullptr) {
+		return nullptr;
+	}
+
+	hash = fnv1a64(name.data(), name.size());
+	mask = header->bucketCount - 1;
+
+	// At least one bucket is always empty, which ends every probe sequence
+	for (uint32_t index = static_cast<uint32_t>(hash) & mask; ; index = (index + 1) & mask) {
+		uint32_t	bucket = buckets[index];
+
+		if (bucket == ARCHIVE_EMPTY_BUCKET || bucket >= header->entryCount) {
+			return nullptr;
+		}
+
+		const ArchiveEntry&	entry = entries[bucket];
+
+		if (entry.nameHash == hash && entry.nameLength == name.size()
+				&& memcmp(names + entry.nameOffset, name.data(), name.size()) == 0) {
+			return &entry;
+		}
+	}
+}
+
+AssetData	AssetArchive::load(const ArchiveEntry& entry) const {
+	AssetData	asset;
+
+	asset.entry = &entry;
+
+	if (entry.compression == AssetCompression::None) {
+		asset.data = file.data() + entry.offset;
+		asset.size = static_cast<size_t>(entry.size);
+		return asset;
+	}
+
+#ifdef HAVE_LZ4
+	if (entry.compression == AssetCompression::LZ4) {
+		asset.storage.resize(static_cast<size_t>(entry.size));
+
+		int	decoded = LZ4_decompress_safe(file.data() + entry.offset, asset.storage.data(),
+				static_cast<int>(entry.storedSize), static_cast<int>(entry.size));
+
+		if (decoded < 0 || static_cast<uint64_t>(decoded) != entry.size) {
+			throw std::runtime_error("failed to decompress archive entry " + std::string(names + entry.nameOffset, entry.nameLength));
+		}
+
+		asset.data = asset.storage.data();
+		asset.size = asset.storage.size();
+		return asset;
+	}
+#endif
+
+	throw std::runtime_error("archive entry " + std::string(names + entry.nameOffset, entry.nameLength)
+		+ " uses a compression this build does not support");
+}
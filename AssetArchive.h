@@ -0,0 +1,94 @@
+#pragma once
+
+#include "readfile.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Packed asset file, written by tools/packer and mapped whole at runtime:
+//
+//   ArchiveHeader
+//   uint32_t        buckets[bucketCount]   open addressed, index into entries
+//   ArchiveEntry    entries[entryCount]
+//   char            names[]                not null terminated
+//   payloads, each aligned to ARCHIVE_ALIGNMENT
+//
+// Names are looked up by FNV-1a hash with linear probing, so finding an
+// asset is a constant number of reads from the mapping.
+const uint32_t	ARCHIVE_MAGIC = 0x4b504b56;	// "VKPK"
+const uint32_t	ARCHIVE_VERSION = 1;
+const uint64_t	ARCHIVE_ALIGNMENT = 4096;
+const uint32_t	ARCHIVE_EMPTY_BUCKET = UINT32_MAX;
+
+enum class	AssetType : uint32_t {
+	Raw,
+	Image
+};
+
+enum class	AssetCompression : uint32_t {
+	None,
+	LZ4
+};
+
+struct	ArchiveHeader {
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	entryCount;
+	uint32_t	bucketCount;
+	uint64_t	bucketsOffset;
+	uint64_t	entriesOffset;
+	uint64_t	namesOffset;
+	uint64_t	namesSize;
+};
+
+// Images are stored decoded, ready to be copied into an image of format
+struct	ArchiveEntry {
+	uint64_t			nameHash;
+	uint64_t			offset;
+	uint64_t			storedSize;
+	uint64_t			size;
+	uint32_t			nameOffset;
+	uint32_t			nameLength;
+	AssetType			type;
+	AssetCompression	compression;
+	uint32_t			width;
+	uint32_t			height;
+	uint32_t			format;
+	uint32_t			reserved;
+};
+
+static_assert(sizeof(ArchiveHeader) == 48, "archive header layout changed");
+static_assert(sizeof(ArchiveEntry) == 64, "archive entry layout changed");
+
+uint64_t	fnv1a64(const char* data, size_t size);
+
+// Payload of one entry. Uncompressed entries point straight into the
+// mapping; compressed ones are inflated into storage.
+struct	AssetData {
+	const ArchiveEntry*	entry = nullptr;
+	const char*			data = nullptr;
+	size_t				size = 0;
+	std::vector<char>	storage;
+};
+
+class	AssetArchive
+{
+	public:
+		void	open(const std::string& filename);
+
+		bool	isOpen(void) const;
+
+		uint32_t	getEntryCount(void) const;
+
+		const ArchiveEntry*	find(const std::string& name) const;
+
+		AssetData	load(const ArchiveEntry& entry) const;
+
+	private:
+		MappedFile				file;
+		const ArchiveHeader*	header = nullptr;
+		const uint32_t*			buckets = nullptr;
+		const ArchiveEntry*		entries = nullptr;
+		const char*				names = nullptr;
+};
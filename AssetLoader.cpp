@@ -0,0 +1,204 @@
+#include "AssetLoader.h"
+#include "readfile.h"
+#include "Ktx2.h"
+#include <stb/stb_image.h>
+#include <stdexcept>
+#include <iostream>
+#include <cstring>
+
+void	AssetLoader::init(JobSystem& jobs, const AssetArchive* archive, const TextureCache* textureCache) {
+	this->jobs = &jobs;
+	this->archive = archive;
+	this->textureCache = textureCache;
+}
+
+void	AssetLoader::destroy(void) {
+	jobs->wait(requiredDecodes);
+	jobs->wait(decodes);
+
+	for (auto& request : ready) {
+		stbi_image_free(request->decoded);
+	}
+	ready.clear();
+	pendingCount = 0;
+	requiredPendingCount = 0;
+}
+
+void	AssetLoader::loadImage(const std::string& path, bool required, ImageReadyCallback onReady, bool allowCompressed) {
+	ImageRequest*	request = new ImageRequest();
+
+	request->image.path = path;
+	request->required = required;
+	request->allowCompressed = allowCompressed;
+	request->onReady = std::move(onReady);
+	request->requestTime = Clock::now();
+
+	pendingCount++;
+	if (required) {
+		requiredPendingCount++;
+	}
+
+	// Required decodes get their own counter so waitRequired() can help
+	// with them without also waiting for optional ones
+	jobs->submit([this, request]() {
+		decode(request);
+	}, required ? &requiredDecodes : &decodes);
+}
+
+static bool	isKtx2(const char* data, size_t size) {
+	return size >= sizeof(KTX2_IDENTIFIER) && memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+}
+
+void	AssetLoader::setCompressed(ImageRequest& request, const char* ktx, size_t size) {
+	KtxTexture	texture = parseKtx2(ktx, size);
+
+	request.image.format = texture.format;
+	request.image.width = static_cast<int>(texture.width);
+	request.image.height = static_cast<int>(texture.height);
+	request.image.pixels = reinterpret_cast<const unsigned char*>(ktx);
+	request.image.levels.clear();
+	for (const KtxLevel& level : texture.levels) {
+		request.image.levels.push_back({level.offset, level.size, level.width, level.height});
+	}
+}
+
+void	AssetLoader::decode(ImageRequest* request) {
+	std::unique_ptr<ImageRequest>	owned(request);
+	int								channels;
+	const ArchiveEntry*				entry = archive != nullptr ? archive->find(owned->image.path) : nullptr;
+	bool							compress = owned->allowCompressed && textureCache != nullptr && textureCache->isEnabled();
+	const char*						sourceData;
+	size_t							sourceSize;
+	uint64_t						sourceHash = 0;
+	MappedFile						cached;
+
+	owned->decodeStart = Clock::now();
+	try {
+		if (entry != nullptr) {
+			owned->archived = archive->load(*entry);
+			sourceData = owned->archived.data;
+			sourceSize = owned->archived.size;
+		} else {
+			owned->source = MappedFile(owned->image.path, MapHint::Sequential);
+			sourceData = owned->source.data();
+			sourceSize = owned->source.size();
+		}
+
+		if (compress) {
+			sourceHash = TextureCache::hashSource(sourceData, sourceSize);
+		}
+
+		if (isKtx2(sourceData, sourceSize)) {
+			if (!owned->allowCompressed) {
+				throw std::runtime_error("KTX2 source can't be loaded uncompressed");
+			}
+			setCompressed(*owned, sourceData, sourceSize);
+		} else if (compress && textureCache->open(sourceHash, cached)) {
+			owned->source = std::move(cached);
+			owned->archived = AssetData{};
+			setCompressed(*owned, owned->source.data(), owned->source.size());
+		} else {
+			if (entry != nullptr && entry->type == AssetType::Image) {
+				owned->image.width = static_cast<int>(entry->width);
+				owned->image.height = static_cast<int>(entry->height);
+				owned->image.pixels = reinterpret_cast<const unsigned char*>(sourceData);
+			} else {
+				owned->decoded = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(sourceData), static_cast<int>(sourceSize),
+						&owned->image.width, &owned->image.height, &channels, STBI_rgb_alpha);
+				owned->image.pixels = owned->decoded;
+				if (owned->decoded == nullptr) {
+					owned->error = stbi_failure_reason();
+				}
+			}
+
+			if (owned->image.pixels != nullptr) {
+				uint32_t	width = static_cast<uint32_t>(owned->image.width);
+				uint32_t	height = static_cast<uint32_t>(owned->image.height);
+
+				owned->image.levels.push_back({0, static_cast<size_t>(width) * height * 4, width, height});
+
+				if (compress) {
+					owned->transcoded = TextureCache::transcode(owned->image.pixels, width, height);
+					textureCache->store(sourceHash, owned->transcoded);
+					setCompressed(*owned, owned->transcoded.data(), owned->transcoded.size());
+					stbi_image_free(owned->decoded);
+					owned->decoded = nullptr;
+				}
+			}
+		}
+	} catch (const std::exception& e) {
+		owned->image.pixels = nullptr;
+		owned->error = e.what();
+	}
+	owned->decodeEnd = Clock::now();
+
+	std::lock_guard<std::mutex>	lock(readyMutex);
+	ready.push_back(std::move(owned));
+}
+
+void	AssetLoader::deliver(ImageRequest& request) {
+	std::chrono::duration<double, std::milli>	queued = request.decodeStart - request.requestTime;
+	std::chrono::duration<double, std::milli>	decoded = request.decodeEnd - request.decodeStart;
+
+	pendingCount--;
+	if (request.required) {
+		requiredPendingCount--;
+	}
+
+	if (request.image.pixels == nullptr) {
+		throw std::runtime_error("failed to load texture image " + request.image.path + ": " + request.error);
+	}
+
+	Clock::time_point	uploadStart = Clock::now();
+
+	try {
+		request.onReady(request.image);
+	} catch (...) {
+		stbi_image_free(request.decoded);
+		throw;
+	}
+	stbi_image_free(request.decoded);
+
+	std::chrono::duration<double, std::milli>	uploaded = Clock::now() - uploadStart;
+
+	std::cout << "Loaded " << request.image.path << " (" << request.image.width << "x" << request.image.height
+		<< ", " << request.image.levels.size() << (request.image.format == VK_FORMAT_R8G8B8A8_SRGB ? " RGBA8" : " compressed")
+		<< " levels): queued " << queued.count() << " ms, decode " << decoded.count()
+		<< " ms, upload " << uploaded.count() << " ms" << std::endl;
+}
+
+uint32_t	AssetLoader::pump(uint32_t maxAssets) {
+	uint32_t	delivered = 0;
+
+	while (delivered < maxAssets) {
+		std::unique_ptr<ImageRequest>	request;
+
+		{
+			std::lock_guard<std::mutex>	lock(readyMutex);
+
+			if (ready.empty()) {
+				break;
+			}
+			request = std::move(ready.front());
+			ready.pop_front();
+		}
+
+		deliver(*request);
+		delivered++;
+	}
+
+	return delivered;
+}
+
+// Callbacks may request more required images, e.g. to retry without
+// compression, so the counter is waited on again for each delivery
+void	AssetLoader::waitRequired(void) {
+	while (requiredPendingCount > 0) {
+		jobs->wait(requiredDecodes);
+		pump(1);
+	}
+}
+
+bool	AssetLoader::isIdle(void) const {
+	return pendingCount == 0;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "JobSystem.h"
+#include "AssetArchive.h"
+#include "TextureCache.h"
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Offsets are from pixels
+struct	ImageLevel {
+	size_t		offset;
+	size_t		size;
+	uint32_t	width;
+	uint32_t	height;
+};
+
+// Either one level of RGBA8 texels or a block compressed mip chain
+struct	DecodedImage {
+	std::string		path;
+	int				width = 0;
+	int				height = 0;
+	VkFormat		format = VK_FORMAT_R8G8B8A8_SRGB;
+	const unsigned char*	pixels = nullptr;
+	std::vector<ImageLevel>	levels;
+};
+
+using ImageReadyCallback = std::function<void(const DecodedImage& image)>;
+
+// Decodes images on the job system and hands them back to the thread that
+// calls pump(), which is where GPU uploads are recorded. Earlier images
+// upload while later ones are still decoding. Images found in the archive
+// are already decoded and are handed out straight from its mapping.
+// Assets flagged as required are the ones waitRequired() blocks startup
+// on; the rest keep arriving through pump() once frames are running.
+//
+// With a texture cache, images are handed out block compressed: KTX2
+// files are used as is, anything else is transcoded once and cached.
+class	AssetLoader
+{
+	public:
+		void	init(JobSystem& jobs, const AssetArchive* archive = nullptr, const TextureCache* textureCache = nullptr);
+
+		void	destroy(void);
+
+		void	loadImage(const std::string& path, bool required, ImageReadyCallback onReady, bool allowCompressed = true);
+
+		uint32_t	pump(uint32_t maxAssets = UINT32_MAX);
+
+		void	waitRequired(void);
+
+		bool	isIdle(void) const;
+
+	private:
+		using Clock = std::chrono::high_resolution_clock;
+
+		struct	ImageRequest {
+			DecodedImage		image;
+			unsigned char*		decoded = nullptr;
+			AssetData			archived;
+			MappedFile			source;
+			std::vector<char>	transcoded;
+			bool				required = false;
+			bool				allowCompressed = true;
+			ImageReadyCallback	onReady;
+			std::string			error;
+			Clock::time_point	requestTime;
+			Clock::time_point	decodeStart;
+			Clock::time_point	decodeEnd;
+		};
+
+		JobSystem*			jobs = nullptr;
+		const AssetArchive*	archive = nullptr;
+		const TextureCache*	textureCache = nullptr;
+		JobCounter	decodes;
+		JobCounter	requiredDecodes;
+		uint32_t	pendingCount = 0;
+		uint32_t	requiredPendingCount = 0;
+
+		std::mutex									readyMutex;
+		std::deque<std::unique_ptr<ImageRequest>>	ready;
+
+		void	decode(ImageRequest* request);
+
+		void	setCompressed(ImageRequest& request, const char* ktx, size_t size);
+
+		void	deliver(ImageRequest& request);
+};
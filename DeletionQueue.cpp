@@ -0,0 +1,41 @@
+#include "DeletionQueue.h"
+#include <utility>
+
+void	DeletionQueue::init(GpuTimeline& timeline) {
+	this->timeline = &timeline;
+}
+
+void	DeletionQueue::retire(std::function<void(void)> destroy, TimelinePoint lastUse) {
+	pending.push_back({std::move(destroy), lastUse});
+}
+
+void	DeletionQueue::update(void) {
+	std::vector<Deletion>	due;
+	auto					it = pending.begin();
+
+	while (it != pending.end()) {
+		if (!timeline->isComplete(it->lastUse)) {
+			++it;
+			continue;
+		}
+		due.push_back(std::move(*it));
+		it = pending.erase(it);
+	}
+
+	// Deletions may queue others, so none run while pending is walked
+	for (Deletion& deletion : due) {
+		deletion.destroy();
+	}
+}
+
+void	DeletionQueue::flush(void) {
+	std::vector<Deletion>	due;
+
+	while (!pending.empty()) {
+		due.swap(pending);
+		for (Deletion& deletion : due) {
+			deletion.destroy();
+		}
+		due.clear();
+	}
+}
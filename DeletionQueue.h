@@ -0,0 +1,45 @@
+#pragma once
+
+#include "DeviceHandle.h"
+#include "GpuTimeline.h"
+
+#include <functional>
+#include <vector>
+
+// Destroys objects once the timeline reaches the last submission that used
+// them, so they can be released mid-run without idling the device. Handles
+// are moved in; anything else, such as allocator memory, is queued as a
+// callback. Deletions that become due together run in the order they were
+// queued, so dependents are queued before what they depend on.
+class	DeletionQueue
+{
+	public:
+		void	init(GpuTimeline& timeline);
+
+		void	retire(std::function<void(void)> destroy, TimelinePoint lastUse);
+
+		template <typename T, void (VKAPI_PTR* Destroy)(VkDevice, T, const VkAllocationCallbacks*)>
+		void	retire(DeviceHandle<T, Destroy>&& handle, TimelinePoint lastUse) {
+			VkDevice	device = handle.getDevice();
+			T			object = handle.release();
+
+			if (object != VK_NULL_HANDLE) {
+				retire([device, object]() { Destroy(device, object, nullptr); }, lastUse);
+			}
+		}
+
+		// Runs the deletions whose point is reached; once per frame
+		void	update(void);
+
+		// Runs every deletion; the device must be idle
+		void	flush(void);
+
+	private:
+		struct	Deletion {
+			std::function<void(void)>	destroy;
+			TimelinePoint				lastUse;
+		};
+
+		GpuTimeline*			timeline = nullptr;
+		std::vector<Deletion>	pending;
+};
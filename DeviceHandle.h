@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// Owns one object created from a VkDevice and destroys it with Destroy
+// when reset, reassigned or destroyed. Move only; it converts to the raw
+// handle, so it is passed to Vulkan calls as is. The device must outlive
+// it, so owners reset their handles before destroying the device.
+template <typename T, void (VKAPI_PTR* Destroy)(VkDevice, T, const VkAllocationCallbacks*)>
+class	DeviceHandle
+{
+	public:
+		DeviceHandle(void) = default;
+
+		DeviceHandle(VkDevice device, T handle) : device(device), handle(handle) {}
+
+		DeviceHandle(DeviceHandle&& other) noexcept : device(other.device), handle(other.release()) {}
+
+		DeviceHandle(const DeviceHandle&) = delete;
+
+		~DeviceHandle(void) {
+			reset();
+		}
+
+		DeviceHandle&	operator=(DeviceHandle&& other) noexcept {
+			if (this != &other) {
+				reset();
+				device = other.device;
+				handle = other.release();
+			}
+			return *this;
+		}
+
+		DeviceHandle&	operator=(const DeviceHandle&) = delete;
+
+		operator T(void) const {
+			return handle;
+		}
+
+		T	get(void) const {
+			return handle;
+		}
+
+		VkDevice	getDevice(void) const {
+			return device;
+		}
+
+		// Destroys the current object and returns where a vkCreate* call
+		// writes the next one
+		T*	replace(VkDevice device) {
+			reset();
+			this->device = device;
+			return &handle;
+		}
+
+		// Gives up ownership without destroying
+		T	release(void) {
+			T	released = handle;
+
+			handle = VK_NULL_HANDLE;
+			return released;
+		}
+
+		void	reset(void) {
+			if (handle != VK_NULL_HANDLE) {
+				Destroy(device, handle, nullptr);
+				handle = VK_NULL_HANDLE;
+			}
+		}
+
+	private:
+		VkDevice	device = VK_NULL_HANDLE;
+		T			handle = VK_NULL_HANDLE;
+};
+
+using UniqueBuffer = DeviceHandle<VkBuffer, vkDestroyBuffer>;
+using UniqueImage = DeviceHandle<VkImage, vkDestroyImage>;
+using UniqueImageView = DeviceHandle<VkImageView, vkDestroyImageView>;
+using UniqueSampler = DeviceHandle<VkSampler, vkDestroySampler>;
+using UniqueFramebuffer = DeviceHandle<VkFramebuffer, vkDestroyFramebuffer>;
+using UniqueRenderPass = DeviceHandle<VkRenderPass, vkDestroyRenderPass>;
+using UniqueShaderModule = DeviceHandle<VkShaderModule, vkDestroyShaderModule>;
+using UniqueDescriptorSetLayout = DeviceHandle<VkDescriptorSetLayout, vkDestroyDescriptorSetLayout>;
+using UniqueDescriptorPool = DeviceHandle<VkDescriptorPool, vkDestroyDescriptorPool>;
+using UniquePipelineLayout = DeviceHandle<VkPipelineLayout, vkDestroyPipelineLayout>;
+using UniquePipeline = DeviceHandle<VkPipeline, vkDestroyPipeline>;
+using UniqueCommandPool = DeviceHandle<VkCommandPool, vkDestroyCommandPool>;
+using UniqueSemaphore = DeviceHandle<VkSemaphore, vkDestroySemaphore>;
+using UniqueQueryPool = DeviceHandle<VkQueryPool, vkDestroyQueryPool>;
+using UniqueSwapchain = DeviceHandle<VkSwapchainKHR, vkDestroySwapchainKHR>;
@@ -0,0 +1,242 @@
+#include "GeometryPool.h"
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+
+void	RangeAllocator::init(uint32_t capacity) {
+	this->capacity = capacity;
+	used = 0;
+	freeRanges.clear();
+	if (capacity > 0) {
+		freeRanges[0] = capacity;
+	}
+}
+
+bool	RangeAllocator::allocate(uint32_t count, uint32_t& offset) {
+	auto	best = freeRanges.end();
+
+	if (count == 0) {
+		offset = 0;
+		return true;
+	}
+
+	for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+		if (it->second >= count && (best == freeRanges.end() || it->second < best->second)) {
+			best = it;
+			if (it->second == count) {
+				break;
+			}
+		}
+	}
+
+	if (best == freeRanges.end()) {
+		return false;
+	}
+
+	offset = best->first;
+	if (best->second > count) {
+		freeRanges[offset + count] = best->second - count;
+	}
+	freeRanges.erase(best);
+	used += count;
+	return true;
+}
+
+void	RangeAllocator::free(uint32_t offset, uint32_t count) {
+	auto	next = freeRanges.lower_bound(offset);
+
+	if (count == 0) {
+		return;
+	}
+
+	used -= count;
+
+	if (next != freeRanges.begin()) {
+		auto	prev = std::prev(next);
+
+		if (prev->first + prev->second == offset) {
+			offset = prev->first;
+			count += prev->second;
+			freeRanges.erase(prev);
+		}
+	}
+	if (next != freeRanges.end() && offset + count == next->first) {
+		count += next->second;
+		freeRanges.erase(next);
+	}
+
+	freeRanges[offset] = count;
+}
+
+uint32_t	RangeAllocator::getCapacity(void) const {
+	return capacity;
+}
+
+uint32_t	RangeAllocator::getUsed(void) const {
+	return used;
+}
+
+uint32_t	RangeAllocator::getLargestFree(void) const {
+	uint32_t	largest = 0;
+
+	for (const auto& range : freeRanges) {
+		largest = std::max(largest, range.second);
+	}
+	return largest;
+}
+
+void	GeometryPool::init(VkDevice device, GpuAllocator& allocator, Uploader& uploader, DeletionQueue& deletionQueue, uint32_t vertexStride, uint32_t maxVertices, uint32_t maxIndices, uint32_t maxMeshlets) {
+	this->device = device;
+	this->allocator = &allocator;
+	this->uploader = &uploader;
+	this->deletionQueue = &deletionQueue;
+	this->vertexStride = vertexStride;
+
+	vertexBuffer = createBuffer(static_cast<VkDeviceSize>(vertexStride) * maxVertices,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexAllocation);
+	indexBuffer = createBuffer(sizeof(uint32_t) * static_cast<VkDeviceSize>(maxIndices),
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexAllocation);
+	meshletBuffer = createBuffer(sizeof(Meshlet) * static_cast<VkDeviceSize>(maxMeshlets),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshletAllocation);
+
+	vertexRanges.init(maxVertices);
+	indexRanges.init(maxIndices);
+	meshletRanges.init(maxMeshlets);
+}
+
+void	GeometryPool::destroy(void) {
+	vertexBuffer.reset();
+	allocator->free(vertexAllocation);
+	indexBuffer.reset();
+	allocator->free(indexAllocation);
+	meshletBuffer.reset();
+	allocator->free(meshletAllocation);
+
+	meshes.clear();
+	freeMeshes.clear();
+}
+
+UniqueBuffer	GeometryPool::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, GpuAllocation& allocation) {
+	VkBufferCreateInfo		bufferInfo{};
+	AllocationCreateInfo	allocInfo{};
+	UniqueBuffer			buffer;
+
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, buffer.replace(device)) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create geometry pool buffer!");
+	}
+
+	allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	allocInfo.kind = AllocationKind::Buffer;
+	allocation = allocator->allocateForBuffer(buffer, allocInfo);
+
+	return buffer;
+}
+
+uint32_t	GeometryPool::addMesh(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount, const std::vector<Meshlet>& meshlets, const std::vector<MeshLod>& lods) {
+	MeshRange				range;
+	uint32_t				vertexOffset;
+	uint32_t				mesh;
+	uint32_t				meshletCount = static_cast<uint32_t>(meshlets.size());
+	VkDeviceSize			vertexBytes = static_cast<VkDeviceSize>(vertexStride) * vertexCount;
+	VkDeviceSize			indexBytes = sizeof(uint32_t) * static_cast<VkDeviceSize>(indexCount);
+	VkDeviceSize			meshletBytes = sizeof(Meshlet) * static_cast<VkDeviceSize>(meshletCount);
+	std::vector<Meshlet>	rebased(meshlets);
+
+	if (lods.size() > MAX_MESH_LODS) {
+		throw std::runtime_error("mesh has too many levels of detail!");
+	}
+	if (!vertexRanges.allocate(vertexCount, vertexOffset)) {
+		throw std::runtime_error("geometry pool is out of vertex space!");
+	}
+	if (!indexRanges.allocate(indexCount, range.firstIndex)) {
+		vertexRanges.free(vertexOffset, vertexCount);
+		throw std::runtime_error("geometry pool is out of index space!");
+	}
+	if (!meshletRanges.allocate(meshletCount, range.firstMeshlet)) {
+		vertexRanges.free(vertexOffset, vertexCount);
+		indexRanges.free(range.firstIndex, indexCount);
+		throw std::runtime_error("geometry pool is out of meshlet space!");
+	}
+
+	range.indexCount = indexCount;
+	range.vertexOffset = static_cast<int32_t>(vertexOffset);
+	range.vertexCount = vertexCount;
+	range.meshletCount = meshletCount;
+	range.lodCount = lods.empty() ? 1 : static_cast<uint32_t>(lods.size());
+	range.lods[0] = {0, indexCount, 0.0f, 0};
+	for (size_t i = 0; i < lods.size(); i++) {
+		range.lods[i] = lods[i];
+	}
+	for (uint32_t i = 0; i < range.lodCount; i++) {
+		range.lods[i].firstIndex += range.firstIndex;
+	}
+
+	if (vertexBytes > 0) {
+		uploader->uploadBuffer(vertexBuffer, static_cast<VkDeviceSize>(vertexStride) * vertexOffset, vertices, vertexBytes);
+		uploader->releaseBuffer(vertexBuffer, static_cast<VkDeviceSize>(vertexStride) * vertexOffset, vertexBytes,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+	}
+	if (indexBytes > 0) {
+		uploader->uploadBuffer(indexBuffer, sizeof(uint32_t) * static_cast<VkDeviceSize>(range.firstIndex), indices, indexBytes);
+		uploader->releaseBuffer(indexBuffer, sizeof(uint32_t) * static_cast<VkDeviceSize>(range.firstIndex), indexBytes,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+	}
+	if (meshletBytes > 0) {
+		for (Meshlet& meshlet : rebased) {
+			meshlet.firstIndex += range.firstIndex;
+		}
+		uploader->uploadBuffer(meshletBuffer, sizeof(Meshlet) * static_cast<VkDeviceSize>(range.firstMeshlet), rebased.data(), meshletBytes);
+		uploader->releaseBuffer(meshletBuffer, sizeof(Meshlet) * static_cast<VkDeviceSize>(range.firstMeshlet), meshletBytes,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	}
+
+	if (freeMeshes.empty()) {
+		mesh = static_cast<uint32_t>(meshes.size());
+		meshes.push_back(range);
+	} else {
+		mesh = freeMeshes.back();
+		freeMeshes.pop_back();
+		meshes[mesh] = range;
+	}
+	return mesh;
+}
+
+void	GeometryPool::removeMesh(uint32_t mesh, TimelinePoint lastUse) {
+	deletionQueue->retire([this, mesh]() {
+		MeshRange&	range = meshes[mesh];
+
+		vertexRanges.free(static_cast<uint32_t>(range.vertexOffset), range.vertexCount);
+		indexRanges.free(range.firstIndex, range.indexCount);
+		meshletRanges.free(range.firstMeshlet, range.meshletCount);
+		range = MeshRange{};
+		freeMeshes.push_back(mesh);
+	}, lastUse);
+}
+
+const MeshRange&	GeometryPool::getMesh(uint32_t mesh) const {
+	return meshes.at(mesh);
+}
+
+VkBuffer	GeometryPool::getVertexBuffer(void) const {
+	return vertexBuffer;
+}
+
+VkBuffer	GeometryPool::getIndexBuffer(void) const {
+	return indexBuffer;
+}
+
+VkBuffer	GeometryPool::getMeshletBuffer(void) const {
+	return meshletBuffer;
+}
+
+void	GeometryPool::printStats(std::ostream& out) const {
+	out << "Geometry pool: " << meshes.size() - freeMeshes.size() << " meshes, "
+		<< vertexRanges.getUsed() << "/" << vertexRanges.getCapacity() << " vertices (largest free " << vertexRanges.getLargestFree() << "), "
+		<< indexRanges.getUsed() << "/" << indexRanges.getCapacity() << " indices (largest free " << indexRanges.getLargestFree() << "), "
+		<< meshletRanges.getUsed() << "/" << meshletRanges.getCapacity() << " meshlets" << std::endl;
+}
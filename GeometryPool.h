@@ -0,0 +1,109 @@
+#pragma once
+
+#include "DeletionQueue.h"
+#include "DeviceHandle.h"
+#include "GpuAllocator.h"
+#include "Uploader.h"
+#include "MeshOptimizer.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <vector>
+
+// Where a mesh lives in the geometry pool, in elements. Indices are
+// relative to the mesh, so draws pass vertexOffset along with firstIndex.
+// firstIndex and indexCount span every level of detail; draws take the
+// range of one of lods, whose firstIndex is in the pool's index buffer.
+// Meshes added without meshlets have a meshletCount of 0, and without
+// levels of detail a single level covering all their indices.
+struct	MeshRange {
+	uint32_t	firstIndex = 0;
+	uint32_t	indexCount = 0;
+	int32_t		vertexOffset = 0;
+	uint32_t	vertexCount = 0;
+	uint32_t	firstMeshlet = 0;
+	uint32_t	meshletCount = 0;
+	uint32_t	lodCount = 0;
+	MeshLod		lods[MAX_MESH_LODS]{};
+};
+
+// Best fit free list over a range of elements; freed ranges are merged
+// with their neighbours
+class	RangeAllocator
+{
+	public:
+		void	init(uint32_t capacity);
+
+		bool	allocate(uint32_t count, uint32_t& offset);
+
+		void	free(uint32_t offset, uint32_t count);
+
+		uint32_t	getCapacity(void) const;
+
+		uint32_t	getUsed(void) const;
+
+		uint32_t	getLargestFree(void) const;
+
+	private:
+		uint32_t						capacity = 0;
+		uint32_t						used = 0;
+		std::map<uint32_t, uint32_t>	freeRanges;
+};
+
+// One device local vertex buffer and one 32-bit index buffer shared by
+// every mesh, so the renderer binds them once and any mesh is drawn by
+// its MeshRange alone, which is what indirect draws need. Mesh data is
+// uploaded through the Uploader and released to the graphics queue per
+// range. Meshlets go to a storage buffer for the culling pass, their
+// firstIndex rebased onto the pool's index buffer.
+//
+// A removed mesh may still be read by submitted frames, so its ranges
+// are retired to the deletion queue and return to the free lists once
+// the timeline reaches the last submission that used it.
+class	GeometryPool
+{
+	public:
+		void	init(VkDevice device, GpuAllocator& allocator, Uploader& uploader, DeletionQueue& deletionQueue, uint32_t vertexStride, uint32_t maxVertices, uint32_t maxIndices, uint32_t maxMeshlets);
+
+		void	destroy(void);
+
+		uint32_t	addMesh(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount, const std::vector<Meshlet>& meshlets = {}, const std::vector<MeshLod>& lods = {});
+
+		void	removeMesh(uint32_t mesh, TimelinePoint lastUse);
+
+		const MeshRange&	getMesh(uint32_t mesh) const;
+
+		VkBuffer	getVertexBuffer(void) const;
+
+		VkBuffer	getIndexBuffer(void) const;
+
+		VkBuffer	getMeshletBuffer(void) const;
+
+		void	printStats(std::ostream& out) const;
+
+	private:
+		VkDevice		device = VK_NULL_HANDLE;
+		GpuAllocator*	allocator = nullptr;
+		Uploader*		uploader = nullptr;
+		DeletionQueue*	deletionQueue = nullptr;
+		uint32_t		vertexStride = 0;
+
+		UniqueBuffer	vertexBuffer;
+		GpuAllocation	vertexAllocation;
+		UniqueBuffer	indexBuffer;
+		GpuAllocation	indexAllocation;
+		UniqueBuffer	meshletBuffer;
+		GpuAllocation	meshletAllocation;
+
+		RangeAllocator	vertexRanges;
+		RangeAllocator	indexRanges;
+		RangeAllocator	meshletRanges;
+
+		std::vector<MeshRange>	meshes;
+		std::vector<uint32_t>	freeMeshes;
+
+		UniqueBuffer	createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, GpuAllocation& allocation);
+};
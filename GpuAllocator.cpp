@@ -0,0 +1,374 @@
+#include "GpuAllocator.h"
+#include <stdexcept>
+#include <algorithm>
+
+static VkDeviceSize	alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static bool	kindsConflict(AllocationKind a, AllocationKind b) {
+	return (a == AllocationKind::ImageOptimal) != (b == AllocationKind::ImageOptimal);
+}
+
+// True when the last byte of the resource at [aOffset, aOffset + aSize)
+// and the first byte of a resource starting at bOffset share a page.
+static bool	onSamePage(VkDeviceSize aOffset, VkDeviceSize aSize, VkDeviceSize bOffset, VkDeviceSize pageSize) {
+	VkDeviceSize	aEndPage = (aOffset + aSize - 1) & ~(pageSize - 1);
+	VkDeviceSize	bStartPage = bOffset & ~(pageSize - 1);
+
+	return aEndPage == bStartPage;
+}
+
+void	GpuAllocator::init(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize preferredBlockSize) {
+	VkPhysicalDeviceProperties	properties;
+
+	this->device = device;
+	this->preferredBlockSize = preferredBlockSize;
+
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+	bufferImageGranularity = std::max<VkDeviceSize>(properties.limits.bufferImageGranularity, 1);
+	maxAllocationCount = properties.limits.maxMemoryAllocationCount;
+	dedicatedThreshold = preferredBlockSize / 2;
+}
+
+void	GpuAllocator::destroy(void) {
+	std::lock_guard<std::mutex>	lock(mutex);
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		for (auto& block : blocks[i]) {
+			freeDeviceMemory(block->memory, i);
+		}
+		blocks[i].clear();
+	}
+}
+
+uint32_t	GpuAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags requiredFlags, VkMemoryPropertyFlags preferredFlags) {
+	VkMemoryPropertyFlags	wantedFlags = requiredFlags | preferredFlags;
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & wantedFlags) == wantedFlags) {
+			return i;
+		}
+	}
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & requiredFlags) == requiredFlags) {
+			return i;
+		}
+	}
+
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+VkDeviceSize	GpuAllocator::blockSizeForType(uint32_t memoryTypeIndex) {
+	VkDeviceSize	heapSize = memProperties.memoryHeaps[memProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+
+	// Small heaps (e.g. the 256MiB host-visible BAR window) would be
+	// exhausted by a handful of full-size blocks
+	if (heapSize <= (1ull << 30)) {
+		return std::min(preferredBlockSize, heapSize / 8);
+	}
+
+	return preferredBlockSize;
+}
+
+VkDeviceMemory	GpuAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, const void* pNext, void** mapped) {
+	VkMemoryAllocateInfo	allocInfo{};
+	VkDeviceMemory			memory;
+
+	if (deviceAllocationCount >= maxAllocationCount) {
+		throw std::runtime_error("exceeded maxMemoryAllocationCount!");
+	}
+
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.pNext = pNext;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate device memory!");
+	}
+	deviceAllocationCount++;
+
+	// Host-visible memory is mapped once for its whole lifetime, a
+	// VkDeviceMemory can't be mapped twice so sub-allocations share it
+	*mapped = nullptr;
+	if (memProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+			throw std::runtime_error("failed to map device memory!");
+		}
+	}
+
+	return memory;
+}
+
+void	GpuAllocator::freeDeviceMemory(VkDeviceMemory memory, uint32_t memoryTypeIndex) {
+	if (memProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		vkUnmapMemory(device, memory);
+	}
+	vkFreeMemory(device, memory, nullptr);
+	deviceAllocationCount--;
+}
+
+bool	GpuAllocator::allocateFromBlock(MemoryBlock& block, const VkMemoryRequirements& requirements, AllocationKind kind, GpuAllocation& allocation) {
+	auto			next = block.suballocations.begin();
+	VkDeviceSize	cursor = 0;
+
+	// First fit over the gaps between live sub-allocations
+	while (true) {
+		VkDeviceSize	gapEnd = (next == block.suballocations.end()) ? block.size : next->first;
+		VkDeviceSize	offset = alignUp(cursor, requirements.alignment);
+		bool			fits = true;
+
+		for (auto prev = next; prev != block.suballocations.begin(); ) {
+			--prev;
+			if (!onSamePage(prev->first, prev->second.size, offset, bufferImageGranularity)) {
+				break;
+			}
+			if (kindsConflict(prev->second.kind, kind)) {
+				offset = alignUp(offset, bufferImageGranularity);
+				break;
+			}
+		}
+
+		if (offset + requirements.size > gapEnd) {
+			fits = false;
+		}
+
+		for (auto it = next; fits && it != block.suballocations.end(); ++it) {
+			if (!onSamePage(offset, requirements.size, it->first, bufferImageGranularity)) {
+				break;
+			}
+			if (kindsConflict(it->second.kind, kind)) {
+				fits = false;
+			}
+		}
+
+		if (fits) {
+			block.suballocations[offset] = {requirements.size, kind};
+			block.usedBytes += requirements.size;
+
+			allocation.memory = block.memory;
+			allocation.offset = offset;
+			allocation.size = requirements.size;
+			allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + offset : nullptr;
+			allocation.memoryTypeIndex = block.memoryTypeIndex;
+			allocation.block = &block;
+			return true;
+		}
+
+		if (next == block.suballocations.end()) {
+			return false;
+		}
+		cursor = next->first + next->second.size;
+		++next;
+	}
+}
+
+void	GpuAllocator::freeFromBlock(MemoryBlock& block, VkDeviceSize offset) {
+	auto	it = block.suballocations.find(offset);
+
+	if (it == block.suballocations.end()) {
+		throw std::runtime_error("freeing unknown sub-allocation!");
+	}
+
+	block.usedBytes -= it->second.size;
+	block.suballocations.erase(it);
+}
+
+GpuAllocation	GpuAllocator::allocate(const VkMemoryRequirements& requirements, const AllocationCreateInfo& createInfo) {
+	VkMemoryDedicatedRequirements	dedicatedRequirements{};
+
+	return allocate(requirements, createInfo, nullptr, dedicatedRequirements);
+}
+
+GpuAllocation	GpuAllocator::allocate(const VkMemoryRequirements& requirements, const AllocationCreateInfo& createInfo,
+		const VkMemoryDedicatedAllocateInfo* dedicatedInfo, const VkMemoryDedicatedRequirements& dedicatedRequirements) {
+	std::lock_guard<std::mutex>	lock(mutex);
+	GpuAllocation				allocation{};
+	uint32_t					memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, createInfo.requiredFlags, createInfo.preferredFlags);
+	VkDeviceSize				blockSize = blockSizeForType(memoryTypeIndex);
+
+	if (createInfo.dedicated || dedicatedRequirements.requiresDedicatedAllocation || dedicatedRequirements.prefersDedicatedAllocation
+			|| requirements.size > std::min(dedicatedThreshold, blockSize / 2)) {
+		allocation.memory = allocateDeviceMemory(requirements.size, memoryTypeIndex, dedicatedInfo, &allocation.mapped);
+		allocation.offset = 0;
+		allocation.size = requirements.size;
+		allocation.memoryTypeIndex = memoryTypeIndex;
+		allocation.block = nullptr;
+
+		dedicatedStats[memoryTypeIndex].dedicatedCount++;
+		dedicatedStats[memoryTypeIndex].dedicatedBytes += requirements.size;
+		return allocation;
+	}
+
+	for (auto& block : blocks[memoryTypeIndex]) {
+		if (block->size - block->usedBytes >= requirements.size
+				&& allocateFromBlock(*block, requirements, createInfo.kind, allocation)) {
+			return allocation;
+		}
+	}
+
+	auto	block = std::make_unique<MemoryBlock>();
+
+	block->size = blockSize;
+	block->memoryTypeIndex = memoryTypeIndex;
+	block->memory = allocateDeviceMemory(blockSize, memoryTypeIndex, nullptr, &block->mapped);
+
+	if (!allocateFromBlock(*block, requirements, createInfo.kind, allocation)) {
+		freeDeviceMemory(block->memory, memoryTypeIndex);
+		throw std::runtime_error("allocation does not fit in an empty memory block!");
+	}
+
+	blocks[memoryTypeIndex].push_back(std::move(block));
+
+	return allocation;
+}
+
+GpuAllocation	GpuAllocator::allocateForBuffer(VkBuffer buffer, const AllocationCreateInfo& createInfo) {
+	VkBufferMemoryRequirementsInfo2	requirementsInfo{};
+	VkMemoryDedicatedRequirements	dedicatedRequirements{};
+	VkMemoryRequirements2			memRequirements{};
+	VkMemoryDedicatedAllocateInfo	dedicatedInfo{};
+	GpuAllocation					allocation;
+
+	requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+	requirementsInfo.buffer = buffer;
+	dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+	memRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	memRequirements.pNext = &dedicatedRequirements;
+
+	vkGetBufferMemoryRequirements2(device, &requirementsInfo, &memRequirements);
+
+	dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+	dedicatedInfo.buffer = buffer;
+	allocation = allocate(memRequirements.memoryRequirements, createInfo, &dedicatedInfo, dedicatedRequirements);
+
+	if (vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+		throw std::runtime_error("failed to bind buffer memory!");
+	}
+
+	return allocation;
+}
+
+// Drivers that want an image in memory of its own, typically render
+// targets, say so through VkMemoryDedicatedRequirements
+GpuAllocation	GpuAllocator::allocateForImage(VkImage image, const AllocationCreateInfo& createInfo) {
+	VkImageMemoryRequirementsInfo2	requirementsInfo{};
+	VkMemoryDedicatedRequirements	dedicatedRequirements{};
+	VkMemoryRequirements2			memRequirements{};
+	VkMemoryDedicatedAllocateInfo	dedicatedInfo{};
+	GpuAllocation					allocation;
+
+	requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+	requirementsInfo.image = image;
+	dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+	memRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	memRequirements.pNext = &dedicatedRequirements;
+
+	vkGetImageMemoryRequirements2(device, &requirementsInfo, &memRequirements);
+
+	dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+	dedicatedInfo.image = image;
+	allocation = allocate(memRequirements.memoryRequirements, createInfo, &dedicatedInfo, dedicatedRequirements);
+
+	if (vkBindImageMemory(device, image, allocation.memory, allocation.offset) != VK_SUCCESS) {
+		throw std::runtime_error("failed to bind image memory!");
+	}
+
+	return allocation;
+}
+
+void	GpuAllocator::free(GpuAllocation& allocation) {
+	std::lock_guard<std::mutex>	lock(mutex);
+	uint32_t					memoryTypeIndex = allocation.memoryTypeIndex;
+
+	if (allocation.memory == VK_NULL_HANDLE) {
+		return;
+	}
+
+	if (allocation.block == nullptr) {
+		freeDeviceMemory(allocation.memory, memoryTypeIndex);
+		dedicatedStats[memoryTypeIndex].dedicatedCount--;
+		dedicatedStats[memoryTypeIndex].dedicatedBytes -= allocation.size;
+	} else {
+		auto&	typeBlocks = blocks[memoryTypeIndex];
+
+		freeFromBlock(*allocation.block, allocation.offset);
+
+		// Keep a single empty block around per type to avoid churn
+		if (allocation.block->suballocations.empty()) {
+			size_t	emptyBlocks = std::count_if(typeBlocks.begin(), typeBlocks.end(),
+					[](const auto& block) { return block->suballocations.empty(); });
+
+			if (emptyBlocks > 1) {
+				auto	it = std::find_if(typeBlocks.begin(), typeBlocks.end(),
+						[&](const auto& block) { return block.get() == allocation.block; });
+
+				freeDeviceMemory((*it)->memory, memoryTypeIndex);
+				typeBlocks.erase(it);
+			}
+		}
+	}
+
+	allocation = GpuAllocation{};
+}
+
+GpuAllocatorStats	GpuAllocator::getStats(uint32_t memoryTypeIndex) {
+	GpuAllocatorStats	stats = dedicatedStats[memoryTypeIndex];
+
+	stats.allocationCount = stats.dedicatedCount;
+	stats.usedBytes = stats.dedicatedBytes;
+
+	for (const auto& block : blocks[memoryTypeIndex]) {
+		stats.blockCount++;
+		stats.blockBytes += block->size;
+		stats.usedBytes += block->usedBytes;
+		stats.allocationCount += static_cast<uint32_t>(block->suballocations.size());
+	}
+
+	return stats;
+}
+
+GpuAllocatorStats	GpuAllocator::getTotalStats(void) {
+	std::lock_guard<std::mutex>	lock(mutex);
+	GpuAllocatorStats			total{};
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		GpuAllocatorStats	stats = getStats(i);
+
+		total.blockCount += stats.blockCount;
+		total.dedicatedCount += stats.dedicatedCount;
+		total.allocationCount += stats.allocationCount;
+		total.blockBytes += stats.blockBytes;
+		total.dedicatedBytes += stats.dedicatedBytes;
+		total.usedBytes += stats.usedBytes;
+	}
+
+	return total;
+}
+
+void	GpuAllocator::printStats(std::ostream& out) {
+	GpuAllocatorStats	total = getTotalStats();
+
+	std::lock_guard<std::mutex>	lock(mutex);
+
+	out << "GPU memory: " << total.allocationCount << " allocations in "
+		<< total.blockCount << " blocks + " << total.dedicatedCount << " dedicated, "
+		<< deviceAllocationCount << "/" << maxAllocationCount << " vkAllocateMemory calls\n";
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		GpuAllocatorStats	stats = getStats(i);
+
+		if (stats.allocationCount == 0 && stats.blockCount == 0) {
+			continue;
+		}
+		out << "\ttype " << i << " (heap " << memProperties.memoryTypes[i].heapIndex << "): "
+			<< stats.allocationCount << " allocations, "
+			<< (stats.usedBytes >> 10) << " KiB used of "
+			<< ((stats.blockBytes + stats.dedicatedBytes) >> 10) << " KiB reserved\n";
+	}
+	out << std::flush;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// Kind of resource bound to an allocation. Linear and optimal-tiling
+// resources placed on the same bufferImageGranularity page alias on some
+// hardware, so the allocator keeps them apart.
+enum class	AllocationKind {
+	Free,
+	Buffer,
+	ImageLinear,
+	ImageOptimal
+};
+
+struct	AllocationCreateInfo {
+	VkMemoryPropertyFlags	requiredFlags = 0;
+	VkMemoryPropertyFlags	preferredFlags = 0;
+	AllocationKind			kind = AllocationKind::Buffer;
+	bool					dedicated = false;
+};
+
+struct	MemoryBlock;
+
+struct	GpuAllocation {
+	VkDeviceMemory	memory = VK_NULL_HANDLE;
+	VkDeviceSize	offset = 0;
+	VkDeviceSize	size = 0;
+	void*			mapped = nullptr;
+	uint32_t		memoryTypeIndex = 0;
+	MemoryBlock*	block = nullptr;
+};
+
+struct	GpuAllocatorStats {
+	uint32_t		blockCount = 0;
+	uint32_t		dedicatedCount = 0;
+	uint32_t		allocationCount = 0;
+	VkDeviceSize	blockBytes = 0;
+	VkDeviceSize	dedicatedBytes = 0;
+	VkDeviceSize	usedBytes = 0;
+};
+
+struct	Suballocation {
+	VkDeviceSize	size;
+	AllocationKind	kind;
+};
+
+struct	MemoryBlock {
+	VkDeviceMemory							memory = VK_NULL_HANDLE;
+	VkDeviceSize							size = 0;
+	VkDeviceSize							usedBytes = 0;
+	uint32_t								memoryTypeIndex = 0;
+	void*									mapped = nullptr;
+	std::map<VkDeviceSize, Suballocation>	suballocations;
+};
+
+class	GpuAllocator
+{
+	public:
+		void	init(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize preferredBlockSize = 64ull << 20);
+
+		void	destroy(void);
+
+		GpuAllocation	allocate(const VkMemoryRequirements& requirements, const AllocationCreateInfo& createInfo);
+
+		GpuAllocation	allocateForBuffer(VkBuffer buffer, const AllocationCreateInfo& createInfo);
+
+		GpuAllocation	allocateForImage(VkImage image, const AllocationCreateInfo& createInfo);
+
+		void	free(GpuAllocation& allocation);
+
+		uint32_t	findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags requiredFlags, VkMemoryPropertyFlags preferredFlags = 0);
+
+		GpuAllocatorStats	getTotalStats(void);
+
+		void	printStats(std::ostream& out);
+
+	private:
+		VkDevice							device = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties	memProperties{};
+		VkDeviceSize						bufferImageGranularity = 1;
+		VkDeviceSize						dedicatedThreshold = 0;
+		VkDeviceSize						preferredBlockSize = 0;
+		uint32_t							maxAllocationCount = 0;
+		uint32_t							deviceAllocationCount = 0;
+
+		std::mutex																mutex;
+		std::array<std::vector<std::unique_ptr<MemoryBlock>>, VK_MAX_MEMORY_TYPES>	blocks;
+		std::array<GpuAllocatorStats, VK_MAX_MEMORY_TYPES>						dedicatedStats{};
+
+		// Resources that ask for, or are large enough to get, memory of their
+		// own are given it through dedicatedInfo when one is passed
+		GpuAllocation	allocate(const VkMemoryRequirements& requirements, const AllocationCreateInfo& createInfo,
+				const VkMemoryDedicatedAllocateInfo* dedicatedInfo, const VkMemoryDedicatedRequirements& dedicatedRequirements);
+
+		// The caller must hold mutex
+		GpuAllocatorStats	getStats(uint32_t memoryTypeIndex);
+
+		VkDeviceSize	blockSizeForType(uint32_t memoryTypeIndex);
+
+		VkDeviceMemory	allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, const void* pNext, void** mapped);
+
+		void	freeDeviceMemory(VkDeviceMemory memory, uint32_t memoryTypeIndex);
+
+		bool	allocateFromBlock(MemoryBlock& block, const VkMemoryRequirements& requirements, AllocationKind kind, GpuAllocation& allocation);
+
+		void	freeFromBlock(MemoryBlock& block, VkDeviceSize offset);
+};
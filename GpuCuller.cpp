@@ -0,0 +1,257 @@
+#include "GpuCuller.h"
+#include <stdexcept>
+#include <algorithm>
+#include <array>
+
+// Culled commands are skipped with instanceCount 0, and firstInstance
+// selects the object, so both features are needed even without the count
+bool	GpuCuller::isSupported(VkPhysicalDevice physicalDevice, uint32_t objectCount) {
+	VkPhysicalDeviceFeatures	features;
+	VkPhysicalDeviceProperties	properties;
+
+	vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	return features.multiDrawIndirect && features.drawIndirectFirstInstance
+		&& objectCount <= properties.limits.maxDrawIndirectCount;
+}
+
+void	GpuCuller::init(VkDevice device, GpuAllocator& allocator, VkPipelineCache pipelineCache, VkShaderModule computeShader, uint32_t framesInFlight, VkBuffer objectBuffer, VkDeviceSize objectStride, uint32_t objectCount, VkBuffer meshletBuffer, uint32_t maxDraws, PFN_vkCmdDrawIndexedIndirectCount drawIndirectCount) {
+	std::array<VkDescriptorSetLayoutBinding, 4>	bindings{};
+	VkDescriptorSetLayoutCreateInfo				layoutInfo{};
+	VkPushConstantRange							pushConstantRange{};
+	VkPipelineLayoutCreateInfo					pipelineLayoutInfo{};
+	VkComputePipelineCreateInfo					pipelineInfo{};
+	VkDescriptorPoolSize						poolSize{};
+	VkDescriptorPoolCreateInfo					poolInfo{};
+	VkDescriptorSetAllocateInfo					setInfo{};
+	std::vector<VkDescriptorSetLayout>			setLayouts;
+	VkDescriptorSetLayout						setLayout;
+	VkBufferCreateInfo							lodStateInfo{};
+	AllocationCreateInfo						lodStateAllocInfo{};
+
+	this->device = device;
+	this->allocator = &allocator;
+	this->objectCount = objectCount;
+	this->maxDraws = std::max(maxDraws, objectCount);
+	this->drawIndirectCount = drawIndirectCount;
+
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, descriptorSetLayout.replace(device)) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create cull descriptor set layout!");
+	}
+	setLayout = descriptorSetLayout;
+
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.size = sizeof(CullConstants);
+
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, pipelineLayout.replace(device)) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create cull pipeline layout!");
+	}
+
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = computeShader;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = pipelineLayout;
+
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, pipeline.replace(device)) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create cull pipeline!");
+	}
+
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = framesInFlight * static_cast<uint32_t>(bindings.size());
+
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = framesInFlight;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, descriptorPool.replace(device)) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create cull descriptor pool!");
+	}
+
+	setLayouts.assign(framesInFlight, setLayout);
+	descriptorSets.resize(framesInFlight);
+
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setInfo.descriptorPool = descriptorPool;
+	setInfo.descriptorSetCount = framesInFlight;
+	setInfo.pSetLayouts = setLayouts.data();
+
+	if (vkAllocateDescriptorSets(device, &setInfo, descriptorSets.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate cull descriptor sets!");
+	}
+
+	// Cleared by the first cull, since the object's levels persist
+	lodStateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	lodStateInfo.size = sizeof(uint32_t) * static_cast<VkDeviceSize>(std::max(objectCount, 1u));
+	lodStateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	lodStateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &lodStateInfo, nullptr, lodStateBuffer.replace(device)) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create level of detail state buffer!");
+	}
+
+	lodStateAllocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	lodStateAllocInfo.kind = AllocationKind::Buffer;
+	lodStateAllocation = allocator.allocateForBuffer(lodStateBuffer, lodStateAllocInfo);
+	lodStateCleared = false;
+
+	drawBuffers.resize(framesInFlight);
+	drawAllocations.resize(framesInFlight);
+	drawCounts.assign(framesInFlight, objectCount);
+
+	for (uint32_t frame = 0; frame < framesInFlight; frame++) {
+		VkBufferCreateInfo						bufferInfo{};
+		AllocationCreateInfo					allocInfo{};
+		std::array<VkDescriptorBufferInfo, 4>	descriptorBuffers{};
+		std::array<VkWriteDescriptorSet, 4>		descriptorWrites{};
+
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = HEADER_SIZE + sizeof(VkDrawIndexedIndirectCommand) * static_cast<VkDeviceSize>(this->maxDraws);
+		bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateBuffer(device, &bufferInfo, nullptr, drawBuffers[frame].replace(device)) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create indirect draw buffer!");
+		}
+
+		allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		allocInfo.kind = AllocationKind::Buffer;
+		drawAllocations[frame] = allocator.allocateForBuffer(drawBuffers[frame], allocInfo);
+
+		descriptorBuffers[0].buffer = objectBuffer;
+		descriptorBuffers[0].offset = 0;
+		descriptorBuffers[0].range = objectStride * objectCount;
+
+		descriptorBuffers[1].buffer = drawBuffers[frame];
+		descriptorBuffers[1].offset = 0;
+		descriptorBuffers[1].range = VK_WHOLE_SIZE;
+
+		descriptorBuffers[2].buffer = meshletBuffer;
+		descriptorBuffers[2].offset = 0;
+		descriptorBuffers[2].range = VK_WHOLE_SIZE;
+
+		descriptorBuffers[3].buffer = lodStateBuffer;
+		descriptorBuffers[3].offset = 0;
+		descriptorBuffers[3].range = VK_WHOLE_SIZE;
+
+		for (uint32_t i = 0; i < descriptorWrites.size(); i++) {
+			descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[i].dstSet = descriptorSets[frame];
+			descriptorWrites[i].dstBinding = i;
+			descriptorWrites[i].descriptorCount = 1;
+			descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[i].pBufferInfo = &descriptorBuffers[i];
+		}
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void	GpuCuller::destroy(void) {
+	drawBuffers.clear();
+	for (GpuAllocation& allocation : drawAllocations) {
+		allocator->free(allocation);
+	}
+	drawAllocations.clear();
+	drawCounts.clear();
+	descriptorSets.clear();
+	lodStateBuffer.reset();
+	allocator->free(lodStateAllocation);
+
+	descriptorPool.reset();
+	pipeline.reset();
+	pipelineLayout.reset();
+	descriptorSetLayout.reset();
+}
+
+// The draw buffer was last read by this frame slot's previous submit,
+// which the caller has waited on, so only the header writes need
+// ordering. The level of detail state was last written by the previous
+// frame's cull, whatever its slot.
+void	GpuCuller::cull(VkCommandBuffer commandBuffer, uint32_t frame, const glm::mat4& viewProj, const glm::vec3& cameraPosition, const MeshRange& mesh, const glm::vec3& boundsMin, const glm::vec3& boundsMax, bool perMeshlet, float lodScale) {
+	std::array<VkBufferMemoryBarrier, 2>	barriers{};
+	VkBufferMemoryBarrier&				barrier = barriers[0];
+	CullConstants						constants{};
+	uint64_t							meshletDraws = static_cast<uint64_t>(objectCount) * mesh.meshletCount;
+
+	constants.viewProj = viewProj;
+	constants.cameraPosition = cameraPosition;
+	constants.objectCount = objectCount;
+	constants.lodCount = mesh.lodCount;
+	constants.lodScale = lodScale;
+	constants.vertexOffset = mesh.vertexOffset;
+	constants.boundsMin = boundsMin;
+	constants.boundsMax = boundsMax;
+	constants.compact = drawIndirectCount != nullptr;
+
+	drawCounts[frame] = objectCount;
+	if (perMeshlet && mesh.meshletCount > 0 && meshletDraws <= maxDraws) {
+		constants.firstMeshlet = mesh.firstMeshlet;
+		constants.meshletCount = mesh.meshletCount;
+		drawCounts[frame] = static_cast<uint32_t>(meshletDraws);
+	}
+
+	vkCmdFillBuffer(commandBuffer, drawBuffers[frame], 0, sizeof(uint32_t), 0);
+	vkCmdUpdateBuffer(commandBuffer, drawBuffers[frame], LOD_TABLE_OFFSET, sizeof(MeshLod) * mesh.lodCount, mesh.lods);
+	if (!lodStateCleared) {
+		vkCmdFillBuffer(commandBuffer, lodStateBuffer, 0, VK_WHOLE_SIZE, 0);
+		lodStateCleared = true;
+	}
+
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = drawBuffers[frame];
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+
+	barriers[1] = barrier;
+	barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	barriers[1].buffer = lodStateBuffer;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[frame], 0, nullptr);
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+	vkCmdDispatch(commandBuffer, (drawCounts[frame] + 63) / 64, 1, 1);
+
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0,
+			0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+// Expects the instanced pipeline with the object buffer on the instance
+// binding, and the geometry pool buffers bound
+void	GpuCuller::draw(VkCommandBuffer commandBuffer, uint32_t frame) {
+	if (drawIndirectCount != nullptr) {
+		drawIndirectCount(commandBuffer, drawBuffers[frame], HEADER_SIZE, drawBuffers[frame], 0, drawCounts[frame], sizeof(VkDrawIndexedIndirectCommand));
+	} else {
+		vkCmdDrawIndexedIndirect(commandBuffer, drawBuffers[frame], HEADER_SIZE, drawCounts[frame], sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
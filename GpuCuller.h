@@ -0,0 +1,92 @@
+#pragma once
+
+#include "GpuAllocator.h"
+#include "GeometryPool.h"
+#include "DeviceHandle.h"
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Frustum culls a scene-wide object buffer on the GPU. Each frame a
+// compute pass writes one VkDrawIndexedIndirectCommand per visible object
+// to that frame's draw buffer, whose header holds the draw count and the
+// mesh's levels of detail. firstInstance is the object index, so the
+// instanced pipeline fetches each object's DrawItem straight from the
+// object buffer and the CPU cost is one dispatch and one draw whatever the
+// object count.
+//
+// Each visible object draws the level of detail its projected error
+// picks, with the same rule and hysteresis as HelloTriApp::selectLod; the
+// level each object drew last is kept in a buffer across frames.
+//
+// Per meshlet culling writes one command per visible (object, meshlet)
+// pair instead, each drawing the meshlet's index range, and adds normal
+// cone back face tests. Meshlets only cover the full detail level. The
+// draw buffers hold maxDraws commands.
+//
+// With VK_KHR_draw_indirect_count the commands are compacted and the
+// count is read by the GPU; otherwise every candidate keeps its own slot
+// and culled ones get an instance count of zero.
+class	GpuCuller
+{
+	public:
+		static bool	isSupported(VkPhysicalDevice physicalDevice, uint32_t objectCount);
+
+		void	init(VkDevice device, GpuAllocator& allocator, VkPipelineCache pipelineCache, VkShaderModule computeShader, uint32_t framesInFlight, VkBuffer objectBuffer, VkDeviceSize objectStride, uint32_t objectCount, VkBuffer meshletBuffer, uint32_t maxDraws, PFN_vkCmdDrawIndexedIndirectCount drawIndirectCount);
+
+		void	destroy(void);
+
+		// Outside a render pass, before draw() for the same frame. Every
+		// object draws mesh, whose mesh space bounds are tested. The camera
+		// position is in the space object models map to. perMeshlet falls
+		// back to per object culling if the mesh has no meshlets or the
+		// pairs exceed maxDraws. lodScale is the pixels a unit of mesh
+		// space error covers at distance 1 over the pixel error allowed;
+		// 0 draws every object at full detail.
+		void	cull(VkCommandBuffer commandBuffer, uint32_t frame, const glm::mat4& viewProj, const glm::vec3& cameraPosition, const MeshRange& mesh, const glm::vec3& boundsMin, const glm::vec3& boundsMax, bool perMeshlet, float lodScale);
+
+		void	draw(VkCommandBuffer commandBuffer, uint32_t frame);
+
+	private:
+		// Packed into the 128 bytes every device accepts
+		struct	CullConstants {
+			glm::mat4	viewProj;
+			glm::vec3	cameraPosition;
+			uint32_t	objectCount;
+			glm::vec3	boundsMin;
+			uint32_t	lodCount;
+			glm::vec3	boundsMax;
+			float		lodScale;
+			int32_t		vertexOffset;
+			uint32_t	compact;
+			uint32_t	firstMeshlet;
+			uint32_t	meshletCount;
+		};
+
+		static_assert(sizeof(CullConstants) == 128, "cull constants exceed the guaranteed push constant size");
+
+		// Draw count padded to 16 bytes, then the level of detail table
+		static const VkDeviceSize	LOD_TABLE_OFFSET = 16;
+		static const VkDeviceSize	HEADER_SIZE = LOD_TABLE_OFFSET + sizeof(MeshLod) * MAX_MESH_LODS;
+
+		VkDevice					device = VK_NULL_HANDLE;
+		GpuAllocator*				allocator = nullptr;
+		UniqueDescriptorSetLayout	descriptorSetLayout;
+		UniquePipelineLayout		pipelineLayout;
+		UniquePipeline				pipeline;
+		UniqueDescriptorPool		descriptorPool;
+		uint32_t					objectCount = 0;
+		uint32_t					maxDraws = 0;
+		UniqueBuffer				lodStateBuffer;
+		GpuAllocation				lodStateAllocation;
+		bool						lodStateCleared = false;
+
+		PFN_vkCmdDrawIndexedIndirectCount	drawIndirectCount = nullptr;
+
+		std::vector<UniqueBuffer>		drawBuffers;
+		std::vector<GpuAllocation>		drawAllocations;
+		std::vector<VkDescriptorSet>	descriptorSets;
+		std::vector<uint32_t>			drawCounts;
+};
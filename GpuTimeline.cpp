@@ -0,0 +1,153 @@
+#include "GpuTimeline.h"
+#include <stdexcept>
+#include <algorithm>
+
+bool	GpuTimeline::isSupported(VkPhysicalDevice physicalDevice) {
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR	timelineFeatures{};
+	VkPhysicalDeviceFeatures2						features{};
+
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &timelineFeatures;
+
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+	return timelineFeatures.timelineSemaphore == VK_TRUE;
+}
+
+void	GpuTimeline::init(VkDevice device) {
+	this->device = device;
+
+	waitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR"));
+	getSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR"));
+
+	if (waitSemaphores == nullptr || getSemaphoreCounterValue == nullptr) {
+		throw std::runtime_error("failed to load timeline semaphore functions!");
+	}
+}
+
+void	GpuTimeline::destroy(void) {
+	for (QueueTimeline& timeline : queues) {
+		vkDestroySemaphore(device, timeline.semaphore, nullptr);
+	}
+	queues.clear();
+}
+
+uint32_t	GpuTimeline::addQueue(VkQueue queue) {
+	VkSemaphoreTypeCreateInfoKHR	typeInfo{};
+	VkSemaphoreCreateInfo			semaphoreInfo{};
+	QueueTimeline					timeline;
+
+	for (uint32_t i = 0; i < queues.size(); i++) {
+		if (queues[i].queue == queue) {
+			return i;
+		}
+	}
+
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+	typeInfo.initialValue = 0;
+
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+
+	timeline.queue = queue;
+	if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timeline.semaphore) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create timeline semaphore!");
+	}
+
+	queues.push_back(timeline);
+	return static_cast<uint32_t>(queues.size() - 1);
+}
+
+TimelinePoint	GpuTimeline::submit(uint32_t queue, const VkCommandBuffer* commandBuffers, uint32_t commandBufferCount,
+		const std::vector<TimelineWait>& waits, const std::vector<VkSemaphore>& binarySignals) {
+	QueueTimeline&						timeline = queues[queue];
+	VkTimelineSemaphoreSubmitInfoKHR	timelineInfo{};
+	VkSubmitInfo						submitInfo{};
+	uint64_t							value = timeline.submitted + 1;
+
+	submitWaits.clear();
+	submitWaitValues.clear();
+	submitWaitStages.clear();
+	for (const TimelineWait& wait : waits) {
+		submitWaits.push_back(wait.semaphore);
+		submitWaitValues.push_back(wait.value);
+		submitWaitStages.push_back(wait.stage);
+	}
+
+	// Binary semaphores ignore their value
+	submitSignals.assign(1, timeline.semaphore);
+	submitSignalValues.assign(1, value);
+	for (VkSemaphore semaphore : binarySignals) {
+		submitSignals.push_back(semaphore);
+		submitSignalValues.push_back(0);
+	}
+
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+	timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(submitWaitValues.size());
+	timelineInfo.pWaitSemaphoreValues = submitWaitValues.data();
+	timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(submitSignalValues.size());
+	timelineInfo.pSignalSemaphoreValues = submitSignalValues.data();
+
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.waitSemaphoreCount = static_cast<uint32_t>(submitWaits.size());
+	submitInfo.pWaitSemaphores = submitWaits.data();
+	submitInfo.pWaitDstStageMask = submitWaitStages.data();
+	submitInfo.commandBufferCount = commandBufferCount;
+	submitInfo.pCommandBuffers = commandBuffers;
+	submitInfo.signalSemaphoreCount = static_cast<uint32_t>(submitSignals.size());
+	submitInfo.pSignalSemaphores = submitSignals.data();
+
+	if (vkQueueSubmit(timeline.queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit to queue!");
+	}
+
+	timeline.submitted = value;
+	return TimelinePoint{queue, value};
+}
+
+TimelineWait	GpuTimeline::waitFor(TimelinePoint point, VkPipelineStageFlags stage) const {
+	return TimelineWait{queues[point.queue].semaphore, point.value, stage};
+}
+
+TimelinePoint	GpuTimeline::getLastSubmitted(uint32_t queue) const {
+	return TimelinePoint{queue, queues[queue].submitted};
+}
+
+bool	GpuTimeline::isComplete(TimelinePoint point) {
+	QueueTimeline&	timeline = queues[point.queue];
+
+	if (point.value <= timeline.completed) {
+		return true;
+	}
+	if (getSemaphoreCounterValue(device, timeline.semaphore, &timeline.completed) != VK_SUCCESS) {
+		throw std::runtime_error("failed to read timeline semaphore!");
+	}
+	return point.value <= timeline.completed;
+}
+
+void	GpuTimeline::wait(TimelinePoint point) {
+	VkSemaphoreWaitInfoKHR	waitInfo{};
+
+	if (isComplete(point)) {
+		return;
+	}
+
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &queues[point.queue].semaphore;
+	waitInfo.pValues = &point.value;
+
+	if (waitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+		throw std::runtime_error("failed to wait for timeline semaphore!");
+	}
+	queues[point.queue].completed = std::max(queues[point.queue].completed, point.value);
+}
+
+void	GpuTimeline::waitIdle(void) {
+	for (uint32_t i = 0; i < queues.size(); i++) {
+		wait(getLastSubmitted(i));
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// A value on one queue's timeline. It is reached once the submission
+// that signals it, and every earlier one on that queue, has completed.
+// Value 0 is reached from the start, so a default point never waits.
+struct	TimelinePoint {
+	uint32_t	queue = 0;
+	uint64_t	value = 0;
+};
+
+// A semaphore a submission waits on before stage: a queue's timeline at
+// value, or a binary semaphore, such as a swapchain acquire's, when value
+// is 0
+struct	TimelineWait {
+	VkSemaphore				semaphore = VK_NULL_HANDLE;
+	uint64_t				value = 0;
+	VkPipelineStageFlags	stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+};
+
+// Schedules every submission on a timeline semaphore per queue
+// (VK_KHR_timeline_semaphore). Each submit signals its queue's next
+// value and returns it as a TimelinePoint, which stands in for a fence:
+// the host waits on or polls it, other queues wait on it, and resources
+// are reused or destroyed once it is reached. Unlike binary semaphores,
+// a point can be waited on any number of times, by any queue, and before
+// it has been submitted from the host's point of view.
+//
+// Submits and queries come from one thread.
+class	GpuTimeline
+{
+	public:
+		static bool	isSupported(VkPhysicalDevice physicalDevice);
+
+		void	init(VkDevice device);
+
+		void	destroy(void);
+
+		// Queues given the same VkQueue share a timeline
+		uint32_t	addQueue(VkQueue queue);
+
+		// binarySignals are signaled along with the timeline, for
+		// presentation, which can't wait on timelines
+		TimelinePoint	submit(uint32_t queue, const VkCommandBuffer* commandBuffers, uint32_t commandBufferCount,
+				const std::vector<TimelineWait>& waits, const std::vector<VkSemaphore>& binarySignals = {});
+
+		TimelineWait	waitFor(TimelinePoint point, VkPipelineStageFlags stage) const;
+
+		TimelinePoint	getLastSubmitted(uint32_t queue) const;
+
+		bool	isComplete(TimelinePoint point);
+
+		void	wait(TimelinePoint point);
+
+		// Waits for everything submitted on every queue, without the
+		// presentation engine a device idle would also wait for
+		void	waitIdle(void);
+
+	private:
+		struct	QueueTimeline {
+			VkQueue		queue = VK_NULL_HANDLE;
+			VkSemaphore	semaphore = VK_NULL_HANDLE;
+			uint64_t	submitted = 0;
+			uint64_t	completed = 0;
+		};
+
+		VkDevice	device = VK_NULL_HANDLE;
+
+		PFN_vkWaitSemaphoresKHR				waitSemaphores = nullptr;
+		PFN_vkGetSemaphoreCounterValueKHR	getSemaphoreCounterValue = nullptr;
+
+		std::vector<QueueTimeline>			queues;
+		std::vector<VkSemaphore>			submitWaits;
+		std::vector<uint64_t>				submitWaitValues;
+		std::vector<VkPipelineStageFlags>	submitWaitStages;
+		std::vector<VkSemaphore>			submitSignals;
+		std::vector<uint64_t>				submitSignalValues;
+};
@@ -18,9 +18,24 @@
 #include <map>
 #include <algorithm>
 #include <limits>
+#include <cmath>
+#include <fstream>
 
-void	HelloTriApp::run(void)
+void	HelloTriApp::run(const AppOptions& options)
 {
+	this->options = options;
+	activeRecordThreads = options.recordThreads;
+	activeInstanced = options.instanced;
+	activeGpuCulling = options.gpuCulling;
+	activeMeshletCulling = options.meshletCulling;
+	activeLod = options.lodPixelError > 0.0f;
+	frameProfile = options.frameProfile;
+	requestedProfile = options.frameProfile;
+	framesInFlight = FRAME_PROFILES[static_cast<size_t>(frameProfile)].framesInFlight;
+
+	jobs.init(options.workerThreads);
+	std::cout << "Job system running " << jobs.getWorkerCount() << " workers" << std::endl;
+
 	initWindow();
 	initVulkan();
 	mainLoop();
@@ -182,6 +197,11 @@ QueueFamilyIndices	HelloTriApp::findQueueFamilies(VkPhysicalDevice device)
 		i++;
 	}
 
+	// Without a dedicated transfer family uploads share the graphics queue
+	if (!indices.transferFamily.has_value()) {
+		indices.transferFamily = indices.graphicsFamily;
+	}
+
 	return indices;
 }
 
@@ -218,6 +238,22 @@ bool	HelloTriApp::checkDeviceExtensionSupport(VkPhysicalDevice device)
 	return requiredExtensions.empty();
 }
 
+bool	HelloTriApp::isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName)
+{
+	uint32_t	extensionCount;
+
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties>	extensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+
+	for (const auto& extension : extensions) {
+		if (strcmp(extension.extensionName, extensionName) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
 int	HelloTriApp::rateDeviceSuitability(VkPhysicalDevice device)
 {
 	VkPhysicalDeviceProperties		deviceProperties;
@@ -241,6 +277,16 @@ int	HelloTriApp::rateDeviceSuitability(VkPhysicalDevice device)
 		return 0;
 	}
 
+	// Mutable-format storage views used by the mip fallback are core in 1.1
+	if (deviceProperties.apiVersion < VK_API_VERSION_1_1) {
+		return 0;
+	}
+
+	// Every submission is scheduled on timeline semaphores
+	if (!GpuTimeline::isSupported(device)) {
+		return 0;
+	}
+
 	switch (deviceProperties.deviceType)
 	{
 		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
@@ -289,15 +335,32 @@ VkExtent2D	HelloTriApp::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabil
 
 VkPresentModeKHR	HelloTriApp::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
 {
-	for (const auto& availablePresentMode : availablePresentModes) {
-		if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-			return availablePresentMode;
+	for (VkPresentModeKHR presentMode : FRAME_PROFILES[static_cast<size_t>(frameProfile)].presentModes) {
+		if (std::find(availablePresentModes.begin(), availablePresentModes.end(), presentMode) != availablePresentModes.end()) {
+			return presentMode;
 		}
 	}
 
 	return VK_PRESENT_MODE_FIFO_KHR;
 }
 
+static const char*	getPresentModeName(VkPresentModeKHR presentMode)
+{
+	switch (presentMode)
+	{
+		case VK_PRESENT_MODE_IMMEDIATE_KHR:
+			return "immediate";
+		case VK_PRESENT_MODE_MAILBOX_KHR:
+			return "mailbox";
+		case VK_PRESENT_MODE_FIFO_KHR:
+			return "fifo";
+		case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+			return "fifo relaxed";
+		default:
+			return "unknown";
+	}
+}
+
 VkSurfaceFormatKHR	HelloTriApp::chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats)
 {
 	for (const auto& availableFormat : availableFormats) {
@@ -347,23 +410,23 @@ std::string	HelloTriApp::getPhysicalDeviceName(VkPhysicalDevice&	device)
 	return std::string(deviceProperties.deviceName);
 }
 
-uint32_t	HelloTriApp::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
-{
-	VkPhysicalDeviceMemoryProperties	memProperties;
-
-	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) { 
-		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-			return i;
-		}
-	}
+static void	framebufferResizeCallback(GLFWwindow* window, int width, int height) {
+	auto app = reinterpret_cast<HelloTriApp*>(glfwGetWindowUserPointer(window));
+	app->framebufferResized = true;
+}
 
-	throw std::runtime_error("failed to find suitable memory type!");
+static void	windowRefreshCallback(GLFWwindow* window) {
+	auto app = reinterpret_cast<HelloTriApp*>(glfwGetWindowUserPointer(window));
+	app->redraw();
 }
 
-static void	framebufferResizeCallback(GLFWwindow* window, int width, int height) {
+// Keys 1 to 3 pick a frame profile; the main loop applies it between frames
+static void	keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
 	auto app = reinterpret_cast<HelloTriApp*>(glfwGetWindowUserPointer(window));
-	app->framebufferResized = true;
+
+	if (action == GLFW_PRESS && key >= GLFW_KEY_1 && key <= GLFW_KEY_3) {
+		app->requestedProfile = static_cast<FrameProfile>(key - GLFW_KEY_1);
+	}
 }
 
 void	HelloTriApp::initWindow(void)
@@ -376,6 +439,8 @@ void	HelloTriApp::initWindow(void)
 	window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
 	glfwSetWindowUserPointer(window, this);
 	glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+	glfwSetKeyCallback(window, keyCallback);
+	glfwSetWindowRefreshCallback(window, windowRefreshCallback);
 	std::cout << "Window created!" << std::endl;
 }
 
@@ -399,7 +464,7 @@ void	HelloTriApp::createInstance(void)
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName	= "No Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	appInfo.apiVersion = VK_API_VERSION_1_1;
 
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	createInfo.pApplicationInfo = &appInfo;
@@ -434,11 +499,42 @@ void	HelloTriApp::createLogicalDevice(void)
 {
 	VkDeviceCreateInfo						createInfo{};
 	VkPhysicalDeviceFeatures				deviceFeatures{};
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR	timelineFeatures{};
+	VkPhysicalDevicePresentIdFeaturesKHR	presentIdFeatures{};
+	VkPhysicalDevicePresentWaitFeaturesKHR	presentWaitFeatures{};
 	QueueFamilyIndices						indices = findQueueFamilies(physicalDevice);
 	float									queuePriority = 1.0f;
 	std::vector<VkDeviceQueueCreateInfo>	queueCreateInfos;
 
 	std::vector<uint32_t>					uniqueQueueFamilies = getUniqueQueueFamilies(physicalDevice);
+	VkPhysicalDeviceFeatures				supportedFeatures;
+	std::vector<const char*>				enabledExtensions = deviceExtensions;
+
+	vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
+	// Optional, lets the texture streamer size its budget from the driver
+	memoryBudgetSupported = isDeviceExtensionSupported(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (memoryBudgetSupported) {
+		enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+
+	// GPU culling needs multi-draw indirect; the draw count extension
+	// lets it compact the commands
+	gpuCullingSupported = GpuCuller::isSupported(physicalDevice, options.drawCount);
+	drawIndirectCountSupported = gpuCullingSupported
+		&& isDeviceExtensionSupported(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	if (drawIndirectCountSupported) {
+		enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	}
+
+	// Optional, tells when frames reach the display for latency and pacing
+	presentWaitSupported = isDeviceExtensionSupported(physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME)
+		&& isDeviceExtensionSupported(physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)
+		&& PresentPacer::isSupported(physicalDevice);
+	if (presentWaitSupported) {
+		enabledExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+		enabledExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+	}
 
 	for (uint32_t queueFamily : uniqueQueueFamilies) {
 		VkDeviceQueueCreateInfo	queueCreateInfo{};
@@ -451,13 +547,29 @@ void	HelloTriApp::createLogicalDevice(void)
 	}
 
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+	deviceFeatures.multiDrawIndirect = gpuCullingSupported;
+	deviceFeatures.drawIndirectFirstInstance = gpuCullingSupported;
+
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+	timelineFeatures.timelineSemaphore = VK_TRUE;
+
+	if (presentWaitSupported) {
+		presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+		presentIdFeatures.presentId = VK_TRUE;
+		presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+		presentWaitFeatures.pNext = &presentIdFeatures;
+		presentWaitFeatures.presentWait = VK_TRUE;
+		timelineFeatures.pNext = &presentWaitFeatures;
+	}
 
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	createInfo.pNext = &timelineFeatures;
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.queueCreateInfoCount = queueCreateInfos.size();
 	createInfo.pEnabledFeatures = &deviceFeatures;
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 	// For compatibility with older Vulkan implementations since
 	// device specific validation layers have been deprecated
@@ -473,6 +585,7 @@ void	HelloTriApp::createLogicalDevice(void)
 	}
 
 	vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
+	vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
 	vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
 }
 
@@ -483,6 +596,42 @@ void	HelloTriApp::createSurface(void)
 	}
 }
 
+void	HelloTriApp::createTimeline(void)
+{
+	timeline.init(device);
+	graphicsTimeline = timeline.addQueue(graphicsQueue);
+	transferTimeline = timeline.addQueue(transferQueue);
+	deletionQueue.init(timeline);
+
+	presentPacer.init(device, presentWaitSupported);
+	if (!presentWaitSupported) {
+		std::cout << "Present wait is not supported, latency is estimated to frame completion" << std::endl;
+	}
+}
+
+void	HelloTriApp::createAllocator(void)
+{
+	allocator.init(physicalDevice, device);
+}
+
+void	HelloTriApp::createPipelineCache(void)
+{
+	pipelineCache.init(physicalDevice, device, PIPELINE_CACHE_PATH);
+}
+
+// The compute shader is only needed when the texture format can't be blitted
+void	HelloTriApp::createMipGenerator(void)
+{
+	UniqueShaderModule	computeShader;
+
+	if (!MipGenerator::supportsBlit(physicalDevice, VK_FORMAT_R8G8B8A8_SRGB)) {
+		std::cout << "Texture format can't be blitted, generating mips with compute" << std::endl;
+		computeShader = loadShaderModule("shaders/mip.spv");
+	}
+
+	mipGenerator.init(physicalDevice, device, deletionQueue, pipelineCache.get(), computeShader);
+}
+
 void	HelloTriApp::createSwapChain(void)
 {
 	VkSwapchainCreateInfoKHR	createInfo{};
@@ -493,9 +642,12 @@ void	HelloTriApp::createSwapChain(void)
 	VkPresentModeKHR	presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
 	VkExtent2D			extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-	uint32_t			imageCount = swapChainSupport.capabilities.minImageCount + 1;
+	uint32_t			imageCount = swapChainSupport.capabilities.minImageCount
+		+ FRAME_PROFILES[static_cast<size_t>(frameProfile)].extraImages;
 
-	std::vector<uint32_t>	queueFamilyIndices = getUniqueQueueFamilies(physicalDevice);
+	QueueFamilyIndices	indices = findQueueFamilies(physicalDevice);
+	uint32_t			queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+	UniqueSwapchain		newSwapChain;
 
 	if (swapChainSupport.capabilities.maxImageCount > 0
 			&& imageCount > swapChainSupport.capabilities.maxImageCount) {
@@ -514,37 +666,46 @@ void	HelloTriApp::createSwapChain(void)
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	createInfo.presentMode = presentMode;
 	createInfo.clipped = VK_TRUE;
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
-
-	createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-	createInfo.queueFamilyIndexCount = queueFamilyIndices.size();
-	createInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+	// Null on first creation; on recreation the current swapchain, retired
+	// below, whose resources the new one may reuse
+	createInfo.oldSwapchain = swapChain;
+
+	// Swap chain images are only touched by rendering and presentation
+	if (indices.graphicsFamily != indices.presentFamily) {
+		createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+		createInfo.queueFamilyIndexCount = 2;
+		createInfo.pQueueFamilyIndices = queueFamilyIndices;
+	} else {
+		createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	}
 
-	if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
+	if (vkCreateSwapchainKHR(device, &createInfo, nullptr, newSwapChain.replace(device)) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create swap chain");
 	}
 
-	std::cout << "Created swap chain!" << std::endl;
+	// Presents already queued to the old swapchain still complete
+	retireSwapChain();
+	swapChain = std::move(newSwapChain);
 
 	vkGetSwapchainImagesKHR(device, swapChain, &imageCount, nullptr);
 	swapChainImages.resize(imageCount);
 	vkGetSwapchainImagesKHR(device, swapChain, &imageCount, swapChainImages.data());
 	swapChainImageFormat = surfaceFormat.format;
 	swapChainExtent = extent;
+	swapChainPresentMode = presentMode;
+
+	std::cout << "Created swap chain! " << imageCount << " images, " << getPresentModeName(presentMode) << " present mode" << std::endl;
 }
 
+// Destroys the current swapchain and every retired one, along with
+// anything else still queued for deletion; the device must be idle
 void	HelloTriApp::cleanupSwapChain(void) {
-	for (size_t i = 0; i < swapChainFramebuffers.size(); i++) {
-		vkDestroyFramebuffer(device, swapChainFramebuffers[i], nullptr);
-	}
-
-	for (size_t i = 0; i < swapChainImageViews.size(); i++) {
-		vkDestroyImageView(device, swapChainImageViews[i], nullptr);
-	}
-
-	vkDestroySwapchainKHR(device, swapChain, nullptr);
+	retireSwapChain();
+	deletionQueue.flush();
 }
 
+// Frames already submitted keep rendering to and presenting the old
+// images; the new swapchain is used from the next acquire on
 void	HelloTriApp::recreateSwapChain(void) {
 	int width = 0, height = 0;
 
@@ -554,15 +715,37 @@ void	HelloTriApp::recreateSwapChain(void) {
 		glfwWaitEvents();
 	}
 
-	vkDeviceWaitIdle(device);
-
-	cleanupSwapChain();
-
 	createSwapChain();
 	createImageViews();
 	createFramebuffers();
 }
 
+// Queues the views and framebuffers for deletion once the last frame that
+// rendered to them completes. That frame's present is queued after its
+// submit, so the swapchain itself waits for the next submission, which
+// uses its replacement, and for its own presents to complete.
+void	HelloTriApp::retireSwapChain(void) {
+	TimelinePoint	lastUse = timeline.getLastSubmitted(graphicsTimeline);
+	TimelinePoint	nextSubmit = {graphicsTimeline, lastUse.value + 1};
+	VkSwapchainKHR	retired = swapChain.release();
+
+	for (UniqueFramebuffer& framebuffer : swapChainFramebuffers) {
+		deletionQueue.retire(std::move(framebuffer), lastUse);
+	}
+	for (UniqueImageView& imageView : swapChainImageViews) {
+		deletionQueue.retire(std::move(imageView), lastUse);
+	}
+	swapChainFramebuffers.clear();
+	swapChainImageViews.clear();
+
+	if (retired != VK_NULL_HANDLE) {
+		deletionQueue.retire([this, retired]() {
+			presentPacer.drain(retired);
+			vkDestroySwapchainKHR(device, retired, nullptr);
+		}, nextSubmit);
+	}
+}
+
 void	HelloTriApp::createImageViews(void)
 {
 	swapChainImageViews.resize(swapChainImages.size());
@@ -584,7 +767,7 @@ void	HelloTriApp::createImageViews(void)
 		createInfo.subresourceRange.baseArrayLayer = 0;
 		createInfo.subresourceRange.layerCount = 1;
 
-		if (vkCreateImageView(device, &createInfo, nullptr, &swapChainImageViews[i]) != VK_SUCCESS) {
+		if (vkCreateImageView(device, &createInfo, nullptr, swapChainImageViews[i].replace(device)) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create image views");
 		}
 	}
@@ -592,22 +775,38 @@ void	HelloTriApp::createImageViews(void)
 	std::cout << "Created swap chain image views!" << std::endl;
 }
 
-VkShaderModule	HelloTriApp::createShaderModule(const std::vector<char>& code)
+UniqueShaderModule	HelloTriApp::createShaderModule(const char* code, size_t size)
 {
 	VkShaderModuleCreateInfo	createInfo{};
-	VkShaderModule				shaderModule;
+	UniqueShaderModule			shaderModule;
 
 	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = code.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+	createInfo.codeSize = size;
+	createInfo.pCode = reinterpret_cast<const uint32_t*>(code);
 
-	if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+	if (vkCreateShaderModule(device, &createInfo, nullptr, shaderModule.replace(device)) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create shader module!");
 	}
 
 	return shaderModule;
 }
 
+// Archived SPIR-V is used in place, loose files are mapped
+UniqueShaderModule	HelloTriApp::loadShaderModule(const std::string& path)
+{
+	const ArchiveEntry*	entry = assetArchive.find(path);
+
+	if (entry != nullptr) {
+		AssetData	asset = assetArchive.load(*entry);
+
+		return createShaderModule(asset.data, asset.size);
+	}
+
+	MappedFile	file(path, MapHint::WillNeed);
+
+	return createShaderModule(file.data(), file.size());
+}
+
 void	HelloTriApp::createRenderPass(void)
 {
 	VkAttachmentDescription	colorAttachment{};
@@ -647,7 +846,7 @@ void	HelloTriApp::createRenderPass(void)
 	renderPassInfo.dependencyCount = 1;
 	renderPassInfo.pDependencies = &dependency;
 
-	if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+	if (vkCreateRenderPass(device, &renderPassInfo, nullptr, renderPass.replace(device)) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create render pass");
 	}
 
@@ -655,12 +854,12 @@ void	HelloTriApp::createRenderPass(void)
 }
 
 void	HelloTriApp::createDescriptorSetLayout(void) {
-	std::array<VkDescriptorSetLayoutBinding, 2>	bindings{};
+	std::array<VkDescriptorSetLayoutBinding, 3>	bindings{};
 
 	VkDescriptorSetLayoutCreateInfo	layoutInfo{};
 
 	bindings[0].binding = 0;
-	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	bindings[0].descriptorCount = 1;
 	bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	bindings[0].pImmutableSamplers = nullptr;
@@ -671,11 +870,17 @@ void	HelloTriApp::createDescriptorSetLayout(void) {
 	bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 	bindings[1].pImmutableSamplers = nullptr;
 
+	bindings[2].binding = 2;
+	bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	bindings[2].descriptorCount = 1;
+	bindings[2].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	bindings[2].pImmutableSamplers = nullptr;
+
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
 	layoutInfo.pBindings = bindings.data();
 
-	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, descriptorSetLayout.replace(device)) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create descriptor set layout!");
 	}
 }
@@ -684,15 +889,16 @@ void	HelloTriApp::createGraphicsPipeline(void)
 {
 	VkGraphicsPipelineCreateInfo		pipelineInfo{};
 
-	std::vector<char>					vertShaderCode = readFile("shaders/vert.spv");
-	std::vector<char>					fragShaderCode = readFile("shaders/frag.spv");
-
-	VkShaderModule						vertShaderModule = createShaderModule(vertShaderCode);
-	VkShaderModule						fragShaderModule = createShaderModule(fragShaderCode);
+	UniqueShaderModule					vertShaderModule = loadShaderModule("shaders/vert.spv");
+	UniqueShaderModule					fragShaderModule = loadShaderModule("shaders/frag.spv");
 
 	VkPipelineShaderStageCreateInfo		vertShaderStageInfo{};
 	VkPipelineShaderStageCreateInfo		fragShaderStageInfo{};
 
+	VkSpecializationMapEntry			specializationEntry{};
+	VkSpecializationInfo				specializationInfo{};
+	VkBool32							instanced = VK_FALSE;
+
 	VkPipelineDynamicStateCreateInfo		dynamicState{};
 	VkPipelineInputAssemblyStateCreateInfo	inputAssembly{};
 	VkPipelineViewportStateCreateInfo		viewportState{};
@@ -707,12 +913,14 @@ void	HelloTriApp::createGraphicsPipeline(void)
 	VkRect2D								scissor{};
 
 	VkPipelineLayoutCreateInfo				pipelineLayoutInfo{};
+	VkDescriptorSetLayout					setLayout = descriptorSetLayout;
 
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	pipelineLayoutInfo.setLayoutCount = 1;
-	pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+	pipelineLayoutInfo.pSetLayouts = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 0;
 
-	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, pipelineLayout.replace(device)) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create pipeline layout!");
 	}
 
@@ -761,13 +969,13 @@ void	HelloTriApp::createGraphicsPipeline(void)
 	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
 	rasterizer.depthBiasEnable = VK_FALSE;
 
-	auto	bindingDescription = Vertex::getBindingDescription();
-	auto	attributeDescriptions = Vertex::getAttributeDescriptions();
+	auto	bindingDescriptions = getBindingDescriptions<SceneVertex>();
+	auto	attributeDescriptions = getAttributeDescriptions<SceneVertex>();
 
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
+	vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
 	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+	vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
 	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
 	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -782,6 +990,17 @@ void	HelloTriApp::createGraphicsPipeline(void)
 	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
 	vertShaderStageInfo.module = vertShaderModule;
 	vertShaderStageInfo.pName = "main";
+	vertShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
+	// constant_id 0 selects where the vertex shader reads per-draw data
+	specializationEntry.constantID = 0;
+	specializationEntry.offset = 0;
+	specializationEntry.size = sizeof(VkBool32);
+
+	specializationInfo.mapEntryCount = 1;
+	specializationInfo.pMapEntries = &specializationEntry;
+	specializationInfo.dataSize = sizeof(VkBool32);
+	specializationInfo.pData = &instanced;
 
 	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -790,9 +1009,6 @@ void	HelloTriApp::createGraphicsPipeline(void)
 
 	VkPipelineShaderStageCreateInfo		shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
-	std::cout << "Vert shader size: " << vertShaderCode.size() << " bytes\n";
-	std::cout << "Frag shader size: " << fragShaderCode.size() << " bytes\n";
-
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 	pipelineInfo.stageCount = 2;
 	pipelineInfo.pStages = shaderStages;
@@ -808,14 +1024,23 @@ void	HelloTriApp::createGraphicsPipeline(void)
 	pipelineInfo.renderPass = renderPass;
 	pipelineInfo.subpass = 0;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+	auto	pipelineStart = std::chrono::high_resolution_clock::now();
+
+	if (vkCreateGraphicsPipelines(device, pipelineCache.get(), 1, &pipelineInfo, nullptr, graphicsPipeline.replace(device)) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline");
 	}
 
-	std::cout << "Created graphics pipeline!" << std::endl;
+	// Same state, per-draw data comes from the instance binding
+	instanced = VK_TRUE;
+
+	if (vkCreateGraphicsPipelines(device, pipelineCache.get(), 1, &pipelineInfo, nullptr, instancedPipeline.replace(device)) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create instanced graphics pipeline");
+	}
 
-	vkDestroyShaderModule(device, vertShaderModule, nullptr);
-	vkDestroyShaderModule(device, fragShaderModule, nullptr);
+	std::chrono::duration<double, std::milli>	pipelineTime = std::chrono::high_resolution_clock::now() - pipelineStart;
+
+	std::cout << "Created graphics pipelines in " << pipelineTime.count() << " ms ("
+		<< (pipelineCache.isWarm() ? "warm" : "cold") << " pipeline cache)" << std::endl;
 }
 
 void	HelloTriApp::createFramebuffers(void)
@@ -837,7 +1062,7 @@ void	HelloTriApp::createFramebuffers(void)
 		framebufferInfo.height = swapChainExtent.height;
 		framebufferInfo.layers = 1;
 
-		if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS) {
+		if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, swapChainFramebuffers[i].replace(device)) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create framebuffer");
 		}
 	}
@@ -848,37 +1073,34 @@ void	HelloTriApp::createFramebuffers(void)
 void	HelloTriApp::createCommandPools(void)
 {
 	VkCommandPoolCreateInfo	graphicsPoolInfo{};
-	VkCommandPoolCreateInfo	transferPoolInfo{};
 	QueueFamilyIndices		queueFamilyIndices = findQueueFamilies(physicalDevice);
 
 	graphicsPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	graphicsPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 	graphicsPoolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
 
-	transferPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	transferPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
-	transferPoolInfo.queueFamilyIndex = queueFamilyIndices.transferFamily.value();
-
-	if (vkCreateCommandPool(device, &graphicsPoolInfo, nullptr, &graphicsCommandPool) != VK_SUCCESS) {
+	if (vkCreateCommandPool(device, &graphicsPoolInfo, nullptr, graphicsCommandPool.replace(device)) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics command pool");
 	}
+}
 
-	if (vkCreateCommandPool(device, &transferPoolInfo, nullptr, &transferCommandPool) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create tranfer command pool");
-	}
+void	HelloTriApp::createUploader(void)
+{
+	QueueFamilyIndices	queueFamilyIndices = findQueueFamilies(physicalDevice);
+
+	uploader.init(device, allocator, timeline, transferTimeline, queueFamilyIndices.transferFamily.value(), queueFamilyIndices.graphicsFamily.value());
 }
 
-void	HelloTriApp::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage &image, VkDeviceMemory &imageMemory) {
+void	HelloTriApp::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkImageCreateFlags flags, VkMemoryPropertyFlags properties, UniqueImage &image, GpuAllocation &imageAllocation) {
 	VkImageCreateInfo		imageInfo{};
-	VkMemoryRequirements	memRequirements;
-	VkMemoryAllocateInfo	allocInfo{};
+	AllocationCreateInfo	allocInfo{};
 
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	imageInfo.imageType = VK_IMAGE_TYPE_2D;
 	imageInfo.extent.width = static_cast<uint32_t>(width);
 	imageInfo.extent.height = static_cast<uint32_t>(height);
 	imageInfo.extent.depth = 1;
-	imageInfo.mipLevels = 1;
+	imageInfo.mipLevels = mipLevels;
 	imageInfo.arrayLayers = 1;
 	imageInfo.format = format;
 	imageInfo.tiling = tiling;
@@ -886,81 +1108,145 @@ void	HelloTriApp::createImage(uint32_t width, uint32_t height, VkFormat format,
 	imageInfo.usage = usage;
 	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-	imageInfo.flags = 0;
+	imageInfo.flags = flags;
 
-	if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+	if (vkCreateImage(device, &imageInfo, nullptr, image.replace(device)) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create image!");
 	}
 
-	vkGetImageMemoryRequirements(device, textureImage, &memRequirements);
+	allocInfo.requiredFlags = properties;
+	allocInfo.kind = (tiling == VK_IMAGE_TILING_OPTIMAL) ? AllocationKind::ImageOptimal : AllocationKind::ImageLinear;
 
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+	imageAllocation = allocator.allocateForImage(image, allocInfo);
+}
 
-	if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate texture memory!");
+void	HelloTriApp::openAssetArchive(void) {
+	if (options.archivePath.empty() || !std::ifstream(options.archivePath).good()) {
+		return;
 	}
 
-	vkBindImageMemory(device, image, imageMemory, 0);
+	assetArchive.open(options.archivePath);
+	std::cout << "Opened asset archive " << options.archivePath << " (" << assetArchive.getEntryCount() << " entries)" << std::endl;
+}
+
+void	HelloTriApp::loadTextureImage(void) {
+	assetLoader.loadImage("textures/texture.jpg", true, [this](const DecodedImage& image) {
+		createTextureImage(image);
+	}, options.compressTextures);
+}
+
+// Block compressed formats need the device feature on top of format support
+bool	HelloTriApp::isTextureFormatSupported(VkFormat format) {
+	VkFormatProperties			properties;
+	VkPhysicalDeviceFeatures	features;
+	VkFormatFeatureFlags		required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT
+		| VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+
+	vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+
+	if (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK && !features.textureCompressionBC) {
+		return false;
+	}
+	return (properties.optimalTilingFeatures & required) == required;
 }
 
-void	HelloTriApp::createTextureImage(void) {
-	int						texWidth, texHeight, texChannels;
-	VkDeviceSize			imageSize;
-	VkBuffer				stagingBuffer;
-	VkDeviceMemory			stagingBufferMemory;
-	void*					mappedBuffer;
+void	HelloTriApp::createTextureImage(const DecodedImage& image) {
+	uint32_t		texWidth = static_cast<uint32_t>(image.width);
+	uint32_t		texHeight = static_cast<uint32_t>(image.height);
+	VkDeviceSize	rgbaSize = static_cast<VkDeviceSize>(texWidth) * texHeight * 4;
+	VkFormat		format = image.format;
+	bool			generateMips = (image.levels.size() == 1 && format == VK_FORMAT_R8G8B8A8_SRGB);
+	VkImage			texture;
+
+	if (!isTextureFormatSupported(format)) {
+		if (format == VK_FORMAT_R8G8B8A8_SRGB) {
+			throw std::runtime_error("device can't sample RGBA8 sRGB textures!");
+		}
+		std::cout << "Compressed format " << format << " of " << image.path << " is unsupported, reloading as RGBA8" << std::endl;
+		assetLoader.loadImage(image.path, true, [this](const DecodedImage& reloaded) {
+			createTextureImage(reloaded);
+		}, false);
+		return;
+	}
 
-	stbi_uc*	pixels = stbi_load("textures/texture.jpg", &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-	imageSize = texWidth * texHeight * 4;
+	textureFormat = format;
+	textureExtent = {texWidth, texHeight};
 
-	if (!pixels) {
-		throw std::runtime_error("failed to load texture image!");
+	if (image.levels.size() > 1) {
+		textureMipLevels = static_cast<uint32_t>(image.levels.size());
+		streamedTexture = textureStreamer.addTexture(image);
+		textureStreamed = true;
+		return;
 	}
 
-	createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	textureMipLevels = generateMips ? MipGenerator::mipLevelsFor(texWidth, texHeight) : static_cast<uint32_t>(image.levels.size());
+
+	createImage(texWidth, texHeight, textureMipLevels, format, VK_IMAGE_TILING_OPTIMAL,
+			(generateMips ? mipGenerator.getImageUsage(format) : VK_IMAGE_USAGE_TRANSFER_DST_BIT) | VK_IMAGE_USAGE_SAMPLED_BIT,
+			generateMips ? mipGenerator.getImageFlags(format) : 0,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageAllocation);
+	transitionImageLayout(uploader.getCommandBuffer(), textureImage, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, textureMipLevels);
+
+	for (uint32_t i = 0; i < image.levels.size(); i++) {
+		const ImageLevel&	level = image.levels[i];
 
-	vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &mappedBuffer);
-	memcpy(mappedBuffer, pixels, static_cast<size_t>(imageSize));
-	vkUnmapMemory(device, stagingBufferMemory);
+		uploader.uploadImage(textureImage, format, level.width, level.height, image.pixels + level.offset, level.size, i);
+	}
+
+	std::cout << "Texture " << image.path << " uses " << textureImageAllocation.size / 1024 << " KiB ("
+		<< rgbaSize * (textureMipLevels > 1 ? 4 : 3) / 3 / 1024 << " KiB as RGBA8)" << std::endl;
 
-	stbi_image_free(pixels);
+	if (!generateMips || textureMipLevels == 1) {
+		uploader.releaseImage(textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		return;
+	}
 
-	createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
-	transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-	copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-	transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	// The transfer queue may not support blits or dispatches, so the rest
+	// of the chain is generated on the graphics queue once it owns the image
+	texture = textureImage;
+	uploader.releaseImage(textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+			[this, texture, format, texWidth, texHeight](VkCommandBuffer commandBuffer) {
+		// Acquires are recorded into the next graphics submission
+		TimelinePoint	lastUse{graphicsTimeline, timeline.getLastSubmitted(graphicsTimeline).value + 1};
 
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+		mipGenerator.generate(commandBuffer, texture, format, texWidth, texHeight, textureMipLevels, lastUse);
+	});
 }
 
 void	HelloTriApp::createTextureImageView(void) {
 	VkImageViewCreateInfo	createInfo{};
 
+	if (textureStreamed) {
+		return;
+	}
+
 	createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	createInfo.image = textureImage;
-	createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	createInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+	createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+	createInfo.format = textureFormat;
 	createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
 	createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
 	createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
 	createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
 	createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	createInfo.subresourceRange.baseMipLevel = 0;
-	createInfo.subresourceRange.levelCount = 1;
+	createInfo.subresourceRange.levelCount = textureMipLevels;
 	createInfo.subresourceRange.baseArrayLayer = 0;
 	createInfo.subresourceRange.layerCount = 1;
 
-	if (vkCreateImageView(device, &createInfo, nullptr, &textureImageView) != VK_SUCCESS) {
+	if (vkCreateImageView(device, &createInfo, nullptr, textureImageView.replace(device)) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create image views");
 	}
 }
 
-void	HelloTriApp::createTextureSampler(void) {
+// Linear min, mag and mip filtering; a maxLod of 0 restricts sampling to
+// the base level
+UniqueSampler	HelloTriApp::createSampler(float maxLod) {
 	VkSamplerCreateInfo			samplerInfo{};
 	VkPhysicalDeviceProperties	properties{};
+	UniqueSampler				sampler;
 
 	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
 
@@ -979,81 +1265,90 @@ void	HelloTriApp::createTextureSampler(void) {
 	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerInfo.mipLodBias = 0.0f;
 	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = 0.0f;
+	samplerInfo.maxLod = maxLod;
 
-	if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS) {
+	if (vkCreateSampler(device, &samplerInfo, nullptr, sampler.replace(device)) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create texture sampler!");
 	}
+
+	return sampler;
 }
 
-void	HelloTriApp::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
-	VkBufferCreateInfo		bufferInfo{};
-	VkMemoryAllocateInfo	allocInfo{};
-	VkMemoryRequirements	memRequirements;
-	std::vector<uint32_t>	queueFamilyIndices = getUniqueQueueFamilies(physicalDevice);
+void	HelloTriApp::createTextureSampler(void) {
+	textureSampler = createSampler(static_cast<float>(textureMipLevels));
+	activeTextureSampler = textureSampler;
+}
 
-	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	bufferInfo.size = size;
-	bufferInfo.usage = usage;
-	bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
-	bufferInfo.queueFamilyIndexCount = queueFamilyIndices.size();
-	bufferInfo.pQueueFamilyIndices = queueFamilyIndices.data();
+void	HelloTriApp::createTextureStreamer(void) {
+	textureStreamer.init(physicalDevice, device, allocator, uploader, timeline, deletionQueue, graphicsTimeline, MAX_FRAMES_IN_FLIGHT,
+			static_cast<VkDeviceSize>(options.textureBudgetMiB) << 20, memoryBudgetSupported);
+}
 
-	if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create buffer!");
-	}
+VkImageView	HelloTriApp::getTextureView(void) {
+	return textureStreamed ? textureStreamer.getView(streamedTexture) : textureImageView;
+}
 
-	vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+VkDeviceSize	HelloTriApp::getTextureBytes(void) {
+	return textureStreamed ? textureStreamer.getResidency(streamedTexture).residentBytes : textureImageAllocation.size;
+}
 
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+// Requests the mip level whose texels are closest to one per pixel on the
+// largest quad on screen, using the matrices of the previous frame
+void	HelloTriApp::updateTextureStreaming(void) {
+	glm::mat4	viewProj = frameUbo.proj * frameUbo.view * frameUbo.model;
+	glm::vec2	viewport(swapChainExtent.width, swapChainExtent.height);
+	uint32_t	level = textureMipLevels - 1;
 
-	if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate buffer memory!");
+	if (!textureStreamed) {
+		return;
 	}
 
-	vkBindBufferMemory(device, buffer, bufferMemory, 0);
-}
-
-VkCommandBuffer	HelloTriApp::beginSingleTimeCommands(const VkCommandPool& commandPool) {
-	VkCommandBufferAllocateInfo	allocInfo{};
-	VkCommandBuffer				commandBuffer;
+	for (const DrawItem& draw : drawList) {
+		glm::mat4	transform = viewProj * draw.model;
+		glm::vec4	corners[3] = {
+			transform * glm::vec4(-0.5f, -0.5f, 0.0f, 1.0f),
+			transform * glm::vec4(0.5f, -0.5f, 0.0f, 1.0f),
+			transform * glm::vec4(-0.5f, 0.5f, 0.0f, 1.0f)
+		};
+		glm::vec2	pixels[3];
+		float		texelsPerPixel;
 
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = commandPool;
-	allocInfo.commandBufferCount = 1;
+		if (corners[0].w <= 0.0f || corners[1].w <= 0.0f || corners[2].w <= 0.0f) {
+			continue;
+		}
+		for (int i = 0; i < 3; i++) {
+			pixels[i] = (glm::vec2(corners[i].x, corners[i].y) / corners[i].w * 0.5f + 0.5f) * viewport;
+		}
 
-	if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate transfer command buffer!");
+		texelsPerPixel = std::max(textureExtent.width / std::max(glm::length(pixels[1] - pixels[0]), 1.0f),
+				textureExtent.height / std::max(glm::length(pixels[2] - pixels[0]), 1.0f));
+		level = std::min(level, static_cast<uint32_t>(std::max(std::floor(std::log2(texelsPerPixel)), 0.0f)));
 	}
 
-	VkCommandBufferBeginInfo	beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-	vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-	return commandBuffer;
+	textureStreamer.requestLevel(streamedTexture, level, frameNumber);
+	textureStreamer.update(frameNumber);
 }
 
-void	HelloTriApp::endSingleTimeCommands(VkCommandPool& commandPool, VkCommandBuffer commandBuffer, VkQueue& queue) {
-	vkEndCommandBuffer(commandBuffer);
+void	HelloTriApp::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, UniqueBuffer& buffer, GpuAllocation& bufferAllocation) {
+	VkBufferCreateInfo		bufferInfo{};
+	AllocationCreateInfo	allocInfo{};
 
-	VkSubmitInfo	submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-	vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(queue);
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, buffer.replace(device)) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create buffer!");
+	}
 
-	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+	allocInfo.requiredFlags = properties;
+	allocInfo.kind = AllocationKind::Buffer;
+
+	bufferAllocation = allocator.allocateForBuffer(buffer, allocInfo);
 }
 
-void	HelloTriApp::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
-	VkCommandBuffer			commandBuffer = beginSingleTimeCommands(graphicsCommandPool);
+void	HelloTriApp::transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseMipLevel, uint32_t levelCount) {
 	VkImageMemoryBarrier	barrier{};
 	VkPipelineStageFlags	sourceStage;
 	VkPipelineStageFlags	dstStage;
@@ -1064,12 +1359,14 @@ void	HelloTriApp::transitionImageLayout(VkImage image, VkFormat format, VkImageL
 
 		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
 		dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-	} else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+	} else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
 		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
 		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
 		dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	} else {
+		throw std::invalid_argument("unsupported layout transition!");
 	}
 
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -1079,105 +1376,139 @@ void	HelloTriApp::transitionImageLayout(VkImage image, VkFormat format, VkImageL
 	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseMipLevel = baseMipLevel;
+	barrier.subresourceRange.levelCount = levelCount;
 	barrier.subresourceRange.baseArrayLayer = 0;
 	barrier.subresourceRange.layerCount = 1;
-	barrier.srcAccessMask = 0; //TODO
-	barrier.dstAccessMask = 0; //TODO
 
 	vkCmdPipelineBarrier(commandBuffer, sourceStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-	endSingleTimeCommands(graphicsCommandPool, commandBuffer, graphicsQueue);
 }
 
-void	HelloTriApp::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-	VkCommandBuffer		commandBuffer = beginSingleTimeCommands(transferCommandPool);
-	VkBufferImageCopy	region{};
+// The scene draws either the built-in quad or one imported mesh, packed
+// into the build's vertex layout
+void	HelloTriApp::createGeometryPool(void)
+{
+	ImportedMesh				mesh;
+	std::vector<SceneVertex>	packed;
+
+	if (options.meshPath.empty()) {
+		mesh.vertices = vertices;
+		mesh.indices = indices;
+		mesh.meshlets = buildMeshlets(mesh.vertices, mesh.indices);
+		mesh.lods = buildLods(mesh.vertices, mesh.indices);
+		mesh.boundsMin = glm::vec3(-0.5f, -0.5f, 0.0f);
+		mesh.boundsMax = glm::vec3(0.5f, 0.5f, 0.0f);
+	} else {
+		MeshImporter	importer;
 
-	region.bufferOffset = 0;
-	region.bufferRowLength = 0;
-	region.bufferImageHeight = 0;
+		importer.init(options.meshCacheDir, assetArchive.isOpen() ? &assetArchive : nullptr);
+		mesh = importer.load(options.meshPath);
+		MeshImporter::printStats(mesh, std::cout);
+	}
+
+	// Indices include the appended levels of detail
+	geometryPool.init(device, allocator, uploader, deletionQueue, sizeof(SceneVertex),
+			std::max(GEOMETRY_POOL_VERTICES, static_cast<uint32_t>(mesh.vertices.size())),
+			std::max(GEOMETRY_POOL_INDICES, static_cast<uint32_t>(mesh.indices.size())),
+			std::max(GEOMETRY_POOL_MESHLETS, static_cast<uint32_t>(mesh.meshlets.size())));
 
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.mipLevel = 0;
-	region.imageSubresource.baseArrayLayer = 0;
-	region.imageSubresource.layerCount = 1;
+	sceneBoundsMin = mesh.boundsMin;
+	sceneBoundsMax = mesh.boundsMax;
+	sceneQuantization = getVertexQuantization<SceneVertex>(mesh.boundsMin, mesh.boundsMax);
+	packed = encodeVertices<SceneVertex>(mesh.vertices, sceneQuantization);
 
-	region.imageOffset = {0, 0, 0};
-	region.imageExtent = {width, height, 1};
+	// Culling sees packed positions; the quantization scale is uniform
+	for (Meshlet& meshlet : mesh.meshlets) {
+		meshlet.center = sceneQuantization.quantize(meshlet.center);
+		meshlet.radius *= sceneQuantization.scale.x;
+	}
+	for (MeshLod& lod : mesh.lods) {
+		lod.error *= sceneQuantization.scale.x;
+	}
 
-	vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	sceneMesh = geometryPool.addMesh(packed.data(), static_cast<uint32_t>(packed.size()),
+			mesh.indices.data(), static_cast<uint32_t>(mesh.indices.size()), mesh.meshlets, mesh.lods);
 
-	endSingleTimeCommands(transferCommandPool, commandBuffer, transferQueue);
+	std::cout << "Vertex layout " << VERTEX_LAYOUT_NAME << ": " << sizeof(SceneVertex) << " bytes per vertex, "
+		<< packed.size() * sizeof(SceneVertex) / 1024 << " KiB of vertices (" << packed.size() * sizeof(Vertex) / 1024
+		<< " KiB as float)" << std::endl;
 }
 
-void	HelloTriApp::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-	VkCommandBuffer	commandBuffer = beginSingleTimeCommands(transferCommandPool);
+// One frame holds the frame constants and a block per draw, each padded
+// to the offset alignment
+void	HelloTriApp::createUniformBuffers(void) {
+	VkPhysicalDeviceProperties	properties;
+	VkDeviceSize				alignment;
+	VkDeviceSize				frameSize;
 
-	VkBufferCopy	copyRegion{};
-	copyRegion.srcOffset = 0;
-	copyRegion.dstOffset = 0;
-	copyRegion.size = size;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 16);
 
-	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+	frameSize = (sizeof(UniformBufferObject) + alignment) + (sizeof(DrawItem) + alignment) * options.drawCount;
 
-	endSingleTimeCommands(transferCommandPool, commandBuffer, transferQueue);
+	uniformRing.init(physicalDevice, device, allocator, framesInFlight, frameSize);
 }
 
-void	HelloTriApp::createVertexBuffer(void)
-{
-	VkDeviceSize	bufferSize = sizeof(vertices[0]) * vertices.size();
-	VkBuffer		stagingBuffer;
-	VkDeviceMemory	stagingBufferMemory;
-	void*	data;
-
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, vertices.data(), (size_t) bufferSize);
-	vkUnmapMemory(device, stagingBufferMemory);
+void	HelloTriApp::createInstanceBuffers(void) {
+	VkDeviceSize	bufferSize = sizeof(DrawItem) * options.drawCount;
 
-	createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
+	instanceBuffers.resize(framesInFlight);
+	instanceBufferAllocations.resize(framesInFlight);
 
-	copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
-
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+	for (size_t i = 0; i < framesInFlight; i++) {
+		createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, instanceBuffers[i], instanceBufferAllocations[i]);
+	}
 }
 
-void	HelloTriApp::createIndexBuffer(void)
-{
-	VkDeviceSize	bufferSize = sizeof(indices[0]) * indices.size();
-	VkBuffer		stagingBuffer;
-	VkDeviceMemory	stagingBufferMemory;
-	void*			data;
-
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, indices.data(), (size_t) bufferSize);
-	vkUnmapMemory(device, stagingBufferMemory);
+void	HelloTriApp::createObjectBuffer(void) {
+	VkDeviceSize	bufferSize = sizeof(DrawItem) * drawList.size();
 
-	createBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+	if (!gpuCullingSupported) {
+		return;
+	}
 
-	copyBuffer(stagingBuffer, indexBuffer, bufferSize);
+	createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, objectBuffer, objectBufferAllocation);
 
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+	uploader.uploadBuffer(objectBuffer, 0, drawList.data(), bufferSize);
+	uploader.releaseBuffer(objectBuffer, 0, bufferSize, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
 }
 
-void	HelloTriApp::createUniformBuffers(void) {
-	VkDeviceSize	bufferSize = sizeof(UniformBufferObject);
+// Draw buffers are sized for per meshlet culling whenever the pairs fit,
+// so the benchmark can compare it with per object culling
+void	HelloTriApp::createGpuCuller(void) {
+	UniqueShaderModule					computeShader;
+	PFN_vkCmdDrawIndexedIndirectCount	drawIndirectCount = nullptr;
+	VkPhysicalDeviceProperties			properties;
+	uint64_t							meshletDraws = static_cast<uint64_t>(drawList.size()) * geometryPool.getMesh(sceneMesh).meshletCount;
+	uint32_t							maxDraws = static_cast<uint32_t>(drawList.size());
+
+	if (!gpuCullingSupported) {
+		if (options.gpuCulling) {
+			std::cout << "Multi-draw indirect is not supported, culling on the CPU" << std::endl;
+			activeGpuCulling = false;
+			activeMeshletCulling = false;
+		}
+		return;
+	}
 
-	uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-	uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-	uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	meshletCullingSupported = meshletDraws > 0 && meshletDraws <= std::min<uint64_t>(MAX_MESHLET_DRAWS, properties.limits.maxDrawIndirectCount);
+	if (meshletCullingSupported) {
+		maxDraws = static_cast<uint32_t>(meshletDraws);
+	} else if (options.meshletCulling) {
+		std::cout << meshletDraws << " object meshlets exceed the indirect draw limit, culling per object" << std::endl;
+		activeMeshletCulling = false;
+	}
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
-		vkMapMemory(device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
+	if (drawIndirectCountSupported) {
+		drawIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCount>(
+				vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
 	}
+
+	computeShader = loadShaderModule("shaders/cull.spv");
+	gpuCuller.init(device, allocator, pipelineCache.get(), computeShader, framesInFlight, objectBuffer, sizeof(DrawItem),
+			static_cast<uint32_t>(drawList.size()), geometryPool.getMeshletBuffer(), maxDraws, drawIndirectCount);
 }
 
 void	HelloTriApp::createDescriptorPool(void) {
@@ -1186,58 +1517,67 @@ void	HelloTriApp::createDescriptorPool(void) {
 
 	VkDescriptorPoolCreateInfo	poolInfo{};
 
-	uboPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	uboPoolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	uboPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	uboPoolSize.descriptorCount = framesInFlight * 2;
 
 	samplerPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	samplerPoolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	samplerPoolSize.descriptorCount = framesInFlight;
 
 	std::array<VkDescriptorPoolSize, 2>	poolSizes = {uboPoolSize, samplerPoolSize};
 
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 	poolInfo.pPoolSizes = poolSizes.data();
-	poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	poolInfo.maxSets = framesInFlight;
 
-	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, descriptorPool.replace(device)) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create descriptorPool");
 	}
 }
 
 void	HelloTriApp::createDescriptorSets(void) {
-	std::vector<VkDescriptorSetLayout>	layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
+	std::vector<VkDescriptorSetLayout>	layouts(framesInFlight, descriptorSetLayout);
 	VkDescriptorSetAllocateInfo			allocInfo{};
 
 	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	allocInfo.descriptorPool = descriptorPool;
-	allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	allocInfo.descriptorSetCount = framesInFlight;
 	allocInfo.pSetLayouts = layouts.data();
 
-	descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+	descriptorSets.resize(framesInFlight);
+	boundTextureViews.assign(framesInFlight, getTextureView());
+	boundTextureSamplers.assign(framesInFlight, activeTextureSampler);
 
 	if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
 		throw std::runtime_error("failed to allocate descriptor sets!");
 	}
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+	for (size_t i = 0; i < framesInFlight; i++) {
 		VkDescriptorBufferInfo	bufferInfo{};
+		VkDescriptorBufferInfo	drawBufferInfo{};
 		VkDescriptorImageInfo	imageInfo{};
-		std::array<VkWriteDescriptorSet, 2>	descriptorWrites{};
+		std::array<VkWriteDescriptorSet, 3>	descriptorWrites{};
 
 		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageInfo.imageView = textureImageView;
-		imageInfo.sampler = textureSampler;
+		imageInfo.imageView = getTextureView();
+		imageInfo.sampler = activeTextureSampler;
 
-		bufferInfo.buffer = uniformBuffers[i];
+		// Both point at the start of the ring, the dynamic offsets bound
+		// with each draw select the blocks
+		bufferInfo.buffer = uniformRing.getBuffer();
 		bufferInfo.offset = 0;
 		bufferInfo.range = sizeof(UniformBufferObject);
 
+		drawBufferInfo.buffer = uniformRing.getBuffer();
+		drawBufferInfo.offset = 0;
+		drawBufferInfo.range = sizeof(DrawItem);
+
 		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrites[0].dstSet = descriptorSets[i];
 		descriptorWrites[0].dstBinding = 0;
 		descriptorWrites[0].dstArrayElement = 0;
 		descriptorWrites[0].descriptorCount = 1;
-		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		descriptorWrites[0].pBufferInfo = &bufferInfo;
 
 		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -1248,14 +1588,51 @@ void	HelloTriApp::createDescriptorSets(void) {
 		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		descriptorWrites[1].pImageInfo = &imageInfo;
 
+		descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[2].dstSet = descriptorSets[i];
+		descriptorWrites[2].dstBinding = 2;
+		descriptorWrites[2].dstArrayElement = 0;
+		descriptorWrites[2].descriptorCount = 1;
+		descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		descriptorWrites[2].pBufferInfo = &drawBufferInfo;
+
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 	}
 }
 
+// Called once the frame's timeline point is reached, so its set is not in use
+void	HelloTriApp::bindTextureDescriptor(uint32_t frame) {
+	VkDescriptorImageInfo	imageInfo{};
+	VkWriteDescriptorSet	descriptorWrite{};
+
+	if (boundTextureViews[frame] == getTextureView() && boundTextureSamplers[frame] == activeTextureSampler) {
+		return;
+	}
+
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = getTextureView();
+	imageInfo.sampler = activeTextureSampler;
+
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = descriptorSets[frame];
+	descriptorWrite.dstBinding = 1;
+	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorWrite.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+
+	boundTextureViews[frame] = imageInfo.imageView;
+	boundTextureSamplers[frame] = imageInfo.sampler;
+}
+
 void	HelloTriApp::createCommandBuffers(void)
 {
-	commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	commandBuffers.resize(framesInFlight);
 	VkCommandBufferAllocateInfo	allocInfo{};
+	VkCommandPoolCreateInfo		recordPoolInfo{};
+	QueueFamilyIndices			queueFamilyIndices = findQueueFamilies(physicalDevice);
 
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 	allocInfo.commandPool = graphicsCommandPool;
@@ -1265,16 +1642,70 @@ void	HelloTriApp::createCommandBuffers(void)
 	if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
 		throw std::runtime_error("failed to allocate command buffer");
 	}
+
+	// Secondary buffers are rerecorded every frame, so their pools are
+	// reset as a whole instead of buffer by buffer
+	recordPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	recordPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	recordPoolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+	recordCommandPools.resize(framesInFlight);
+	recordCommandBuffers.resize(framesInFlight);
+	for (size_t i = 0; i < framesInFlight; i++) {
+		recordCommandPools[i].resize(options.recordThreads);
+		recordCommandBuffers[i].resize(options.recordThreads);
+		for (uint32_t thread = 0; thread < options.recordThreads; thread++) {
+			if (vkCreateCommandPool(device, &recordPoolInfo, nullptr, recordCommandPools[i][thread].replace(device)) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create recording command pool");
+			}
+
+			allocInfo.commandPool = recordCommandPools[i][thread];
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(device, &allocInfo, &recordCommandBuffers[i][thread]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to allocate secondary command buffer");
+			}
+		}
+	}
 	std::cout << "created command buffer" << std::endl;
 }
 
+// Lays the objects out on a square grid that covers the original quad, so
+// a single draw looks exactly like the unscaled scene. The scene mesh is
+// first centred and scaled to fit a unit cube, which leaves the quad as
+// it is. Positions of bounds relative layouts are mapped back to mesh
+// space by the same matrix. Objects are tinted by their place in the
+// grid; the scene has a single texture layer.
+void	HelloTriApp::createDrawList(void)
+{
+	uint32_t	side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(options.drawCount))));
+	float		cell = 1.0f / side;
+	glm::vec3	extent = sceneBoundsMax - sceneBoundsMin;
+	float		size = std::max(extent.x, std::max(extent.y, extent.z));
+	glm::mat4	normalize = glm::translate(glm::scale(glm::mat4(1.0f), glm::vec3(size > 0.0f ? 1.0f / size : 1.0f)),
+					-(sceneBoundsMin + sceneBoundsMax) * 0.5f) * sceneQuantization.getDequantizeTransform();
+
+	drawList.resize(options.drawCount);
+
+	for (uint32_t i = 0; i < options.drawCount; i++) {
+		glm::vec3	center(-0.5f + cell * ((i % side) + 0.5f), -0.5f + cell * ((i / side) + 0.5f), 0.0f);
+
+		drawList[i] = DrawItem{};
+		drawList[i].model = glm::scale(glm::translate(glm::mat4(1.0f), center), glm::vec3(cell, cell, 1.0f)) * normalize;
+		drawList[i].tint = glm::vec4(1.0f);
+		if (side > 1) {
+			drawList[i].tint = glm::vec4(0.75f + 0.25f * center.x + 0.125f, 0.75f + 0.25f * center.y + 0.125f, 1.0f, 1.0f);
+		}
+		drawList[i].textureLayer = 0;
+	}
+}
+
 void	HelloTriApp::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
 {
 	VkCommandBufferBeginInfo	beginInfo{};
 	VkRenderPassBeginInfo		renderPassInfo{};
 	VkClearValue				clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-	VkViewport					viewport{};
-	VkRect2D					scissor{};
 
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
@@ -1282,6 +1713,13 @@ void	HelloTriApp::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t im
 		throw std::runtime_error("failed to begin recording command buffer");
 	}
 
+	uploader.acquirePending(commandBuffer, frameWaits, true);
+
+	if (timestampQueryPool != VK_NULL_HANDLE) {
+		vkCmdResetQueryPool(commandBuffer, timestampQueryPool, currentFrame * 2, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, currentFrame * 2);
+	}
+
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	renderPassInfo.renderPass = renderPass;
 	renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
@@ -1289,14 +1727,93 @@ void	HelloTriApp::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t im
 	renderPassInfo.renderArea.extent = swapChainExtent;
 	renderPassInfo.clearValueCount = 1;
 	renderPassInfo.pClearValues = &clearColor;
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
 
-	VkBuffer		vertexBuffers[] = {vertexBuffer};
-	VkDeviceSize	offsets[] = {0};
+	if (activeGpuCulling) {
+		glm::vec3	camera = glm::vec3(glm::inverse(frameUbo.view * frameUbo.model)[3]);
+
+		gpuCuller.cull(commandBuffer, currentFrame, frameUbo.proj * frameUbo.view * frameUbo.model, camera, geometryPool.getMesh(sceneMesh),
+				sceneQuantization.quantize(sceneBoundsMin), sceneQuantization.quantize(sceneBoundsMax), activeMeshletCulling, getLodScale());
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		recordCulled(commandBuffer);
+	} else if (activeInstanced) {
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		recordInstanced(commandBuffer);
+	} else if (activeRecordThreads == 0) {
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		bindDrawState(commandBuffer, graphicsPipeline);
+		recordDraws(commandBuffer, 0, static_cast<uint32_t>(drawList.size()));
+	} else {
+		uint32_t	secondaryCount;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-	vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+		// Each batch owns one pool and secondary buffer whichever worker runs it
+		secondaryCount = jobs.parallelFor(static_cast<uint32_t>(drawList.size()), activeRecordThreads,
+				[this, imageIndex](uint32_t batch, uint32_t firstDraw, uint32_t drawCount) {
+			recordSecondary(batch, imageIndex, firstDraw, drawCount);
+		});
+
+		vkCmdExecuteCommands(commandBuffer, secondaryCount, recordCommandBuffers[currentFrame].data());
+	}
+
+	vkCmdEndRenderPass(commandBuffer);
+
+	if (timestampQueryPool != VK_NULL_HANDLE) {
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, currentFrame * 2 + 1);
+		timestampsWritten[currentFrame] = true;
+	}
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record command buffer");
+	}
+}
+
+void	HelloTriApp::recordSecondary(uint32_t thread, uint32_t imageIndex, uint32_t firstDraw, uint32_t drawCount)
+{
+	VkCommandBuffer					commandBuffer = recordCommandBuffers[currentFrame][thread];
+	VkCommandBufferInheritanceInfo	inheritanceInfo{};
+	VkCommandBufferBeginInfo		beginInfo{};
+
+	vkResetCommandPool(device, recordCommandPools[currentFrame][thread], 0);
+
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = renderPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = swapChainFramebuffers[imageIndex];
+
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording secondary command buffer");
+	}
+
+	bindDrawState(commandBuffer, graphicsPipeline);
+	recordDraws(commandBuffer, firstDraw, drawCount);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record secondary command buffer");
+	}
+}
+
+// Secondary command buffers inherit no state from the primary, so every
+// buffer that draws binds the full set. All meshes share the geometry
+// pool buffers, so this is the only vertex and index buffer bind. The
+// instance binding is part of both pipelines' vertex input, so it is
+// bound even when the shader reads per-draw data from the uniform ring.
+void	HelloTriApp::bindDrawState(VkCommandBuffer commandBuffer, VkPipeline pipeline)
+{
+	VkViewport					viewport{};
+	VkRect2D					scissor{};
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+	VkBuffer		vertexBuffers[] = {geometryPool.getVertexBuffer(), instanceBuffers[currentFrame]};
+	VkDeviceSize	offsets[] = {0, 0};
+
+	vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+	vkCmdBindIndexBuffer(commandBuffer, geometryPool.getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
 
 	viewport.x = 0.0f;
 	viewport.y = 0.0f;
@@ -1309,39 +1826,320 @@ void	HelloTriApp::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t im
 	scissor.offset = {0, 0};
 	scissor.extent = swapChainExtent;
 	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
 
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, nullptr);
+// Pixels a unit of vertex space error covers at distance 1, over the
+// error allowed; 0 while levels of detail are off
+float	HelloTriApp::getLodScale(void) const
+{
+	if (!activeLod || options.lodPixelError <= 0.0f) {
+		return 0.0f;
+	}
+	return std::abs(frameUbo.proj[1][1]) * swapChainExtent.height * 0.5f / options.lodPixelError;
+}
+
+// The coarsest level whose error projects to at most the allowed pixels,
+// searched from the level the object drew last; the error is scaled by
+// the model's largest axis and divided by the distance to the object's
+// bounding sphere. Mirrored by selectLod in cull.comp.
+uint32_t	HelloTriApp::selectLod(uint32_t lod, const glm::mat4& model, const glm::vec3& camera, float lodScale) const
+{
+	const MeshRange&	mesh = geometryPool.getMesh(sceneMesh);
+	glm::vec3			boundsMin = sceneQuantization.quantize(sceneBoundsMin);
+	glm::vec3			boundsMax = sceneQuantization.quantize(sceneBoundsMax);
+	float				scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	glm::vec3			center = glm::vec3(model * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+	float				radius = glm::length(boundsMax - boundsMin) * 0.5f * scale;
+	float				pixels = lodScale * scale / std::max(glm::length(center - camera) - radius, LOD_MIN_DISTANCE);
+
+	if (lodScale <= 0.0f) {
+		return 0;
+	}
 
-	vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+	lod = std::min(lod, mesh.lodCount - 1);
+	while (lod > 0 && mesh.lods[lod].error * pixels > 1.0f) {
+		lod--;
+	}
+	while (lod + 1 < mesh.lodCount && mesh.lods[lod + 1].error * pixels <= LOD_HYSTERESIS) {
+		lod++;
+	}
+	return lod;
+}
 
-	vkCmdEndRenderPass(commandBuffer);
+// Selects every draw's level for the CPU paths from this frame's camera,
+// in the space the draw list's models map to, and counts the triangles
+// they submit
+void	HelloTriApp::updateLods(void)
+{
+	const MeshRange&	mesh = geometryPool.getMesh(sceneMesh);
+	float				lodScale = getLodScale();
+	glm::vec3			camera = glm::vec3(glm::inverse(frameUbo.view * frameUbo.model)[3]);
 
-	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-		throw std::runtime_error("failed to record command buffer");
+	drawLods.resize(drawList.size(), 0);
+	for (size_t i = 0; i < drawList.size(); i++) {
+		drawLods[i] = selectLod(drawLods[i], drawList[i].model, camera, lodScale);
+		frameStats.triangles += mesh.lods[drawLods[i]].indexCount / 3;
 	}
 }
 
+// The batch's blocks are allocated in one go, then each draw rebinds the
+// same descriptor set with its own dynamic offset
+void	HelloTriApp::recordDraws(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t drawCount)
+{
+	UniformAllocation	blocks = uniformRing.allocate(sizeof(DrawItem), drawCount);
+	const MeshRange&	mesh = geometryPool.getMesh(sceneMesh);
+
+	for (uint32_t i = 0; i < drawCount; i++) {
+		uint32_t		dynamicOffsets[] = {frameUniformOffset, blocks.offset + static_cast<uint32_t>(blocks.stride * i)};
+		const MeshLod&	lod = mesh.lods[drawLods[firstDraw + i]];
+
+		memcpy(blocks.mapped + blocks.stride * i, &drawList[firstDraw + i], sizeof(DrawItem));
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 2, dynamicOffsets);
+		vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, lod.firstIndex, mesh.vertexOffset, 0);
+	}
+}
+
+// Streams the draw list to this frame's instance buffer grouped by level
+// of detail and draws each level's quads with one call; the draw uniform
+// block is unused but still needs a valid dynamic offset
+void	HelloTriApp::recordInstanced(VkCommandBuffer commandBuffer)
+{
+	uint32_t			dynamicOffsets[] = {frameUniformOffset, frameUniformOffset};
+	const MeshRange&	mesh = geometryPool.getMesh(sceneMesh);
+	DrawItem*			instances = static_cast<DrawItem*>(instanceBufferAllocations[currentFrame].mapped);
+	uint32_t			lodInstances[MAX_MESH_LODS] = {};
+	uint32_t			firstInstances[MAX_MESH_LODS] = {};
+	uint32_t			cursors[MAX_MESH_LODS];
+
+	for (uint32_t lod : drawLods) {
+		lodInstances[lod]++;
+	}
+	for (uint32_t lod = 1; lod < mesh.lodCount; lod++) {
+		firstInstances[lod] = firstInstances[lod - 1] + lodInstances[lod - 1];
+	}
+	std::copy(firstInstances, firstInstances + MAX_MESH_LODS, cursors);
+	for (size_t i = 0; i < drawList.size(); i++) {
+		memcpy(&instances[cursors[drawLods[i]]++], &drawList[i], sizeof(DrawItem));
+	}
+
+	bindDrawState(commandBuffer, instancedPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 2, dynamicOffsets);
+	for (uint32_t lod = 0; lod < mesh.lodCount; lod++) {
+		if (lodInstances[lod] > 0) {
+			vkCmdDrawIndexed(commandBuffer, mesh.lods[lod].indexCount, lodInstances[lod], mesh.lods[lod].firstIndex, mesh.vertexOffset, firstInstances[lod]);
+		}
+	}
+}
+
+// Draws whatever the cull pass of this frame left visible; the object
+// buffer replaces the streamed instance buffer
+void	HelloTriApp::recordCulled(VkCommandBuffer commandBuffer)
+{
+	uint32_t		dynamicOffsets[] = {frameUniformOffset, frameUniformOffset};
+	VkBuffer		instances = objectBuffer;
+	VkDeviceSize	offset = 0;
+
+	bindDrawState(commandBuffer, instancedPipeline);
+	vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instances, &offset);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 2, dynamicOffsets);
+	gpuCuller.draw(commandBuffer, currentFrame);
+}
+
 void	HelloTriApp::createSyncObjects(void)
 {
-	imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+	imageAvailableSemaphores.resize(framesInFlight);
+	renderFinishedSemaphores.resize(framesInFlight);
+	framePoints.assign(framesInFlight, TimelinePoint{graphicsTimeline, 0});
+	frameStartTimes.resize(framesInFlight);
+	latencyPending.assign(framesInFlight, false);
 
 	VkSemaphoreCreateInfo	semaphoreInfo{};
-	VkFenceCreateInfo		fenceInfo{};
 
 	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+	// Swapchain acquire and present only take binary semaphores
+	for (size_t i = 0; i < framesInFlight; i++) {
+		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, imageAvailableSemaphores[i].replace(device)) != VK_SUCCESS
+				|| vkCreateSemaphore(device, &semaphoreInfo, nullptr, renderFinishedSemaphores[i].replace(device)) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create semaphores");
+		}
+	}
+}
+
+// Left disabled on queues without timestamp support
+void	HelloTriApp::createTimestampQueries(void)
+{
+	QueueFamilyIndices				indices = findQueueFamilies(physicalDevice);
+	VkPhysicalDeviceProperties		properties;
+	VkQueryPoolCreateInfo			poolInfo{};
+	uint32_t						queueFamilyCount = 0;
+	std::vector<VkQueueFamilyProperties>	queueFamilies;
+
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	queueFamilies.resize(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	timestampsWritten.assign(framesInFlight, false);
+
+	if (queueFamilies[indices.graphicsFamily.value()].timestampValidBits == 0) {
+		std::cout << "Graphics queue has no timestamp support, GPU times disabled" << std::endl;
+		return;
+	}
+
+	poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	poolInfo.queryCount = framesInFlight * 2;
+
+	if (vkCreateQueryPool(device, &poolInfo, nullptr, timestampQueryPool.replace(device)) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create timestamp query pool");
+	}
+
+	timestampPeriodMs = properties.limits.timestampPeriod / 1e6;
+}
+
+void	HelloTriApp::readTimestamps(uint32_t frame)
+{
+	uint64_t	timestamps[2];
+
+	if (timestampQueryPool == VK_NULL_HANDLE || !timestampsWritten[frame]) {
+		return;
+	}
+
+	timestampsWritten[frame] = false;
+	if (vkGetQueryPoolResults(device, timestampQueryPool, frame * 2, 2, sizeof(timestamps), timestamps,
+				sizeof(timestamps[0]), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+		return;
+	}
+
+	frameStats.gpuFrames++;
+	frameStats.gpuMs += (timestamps[1] - timestamps[0]) * timestampPeriodMs;
+}
+
+// Everything sized by the frames in flight; the device must be idle
+void	HelloTriApp::cleanupFrameResources(void)
+{
+	uniformRing.destroy();
+
+	if (gpuCullingSupported) {
+		gpuCuller.destroy();
+	}
+
+	instanceBuffers.clear();
+	for (GpuAllocation& allocation : instanceBufferAllocations) {
+		allocator.free(allocation);
+	}
+	instanceBufferAllocations.clear();
+
+	descriptorPool.reset();
+	descriptorSets.clear();
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS
-				|| vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS
-				|| vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create semaphores or fence");
+	imageAvailableSemaphores.clear();
+	renderFinishedSemaphores.clear();
+
+	timestampQueryPool.reset();
+
+	vkFreeCommandBuffers(device, graphicsCommandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+	commandBuffers.clear();
+	recordCommandPools.clear();
+	recordCommandBuffers.clear();
+}
+
+// Rebuilds the per frame arrays for the profile's frames in flight and the
+// swapchain for its present mode; the scene and its uploads are kept. The
+// device idles rather than the timelines, since presentation may still
+// wait on the frame semaphores.
+void	HelloTriApp::setFrameProfile(FrameProfile profile)
+{
+	vkDeviceWaitIdle(device);
+	cleanupFrameResources();
+
+	frameProfile = profile;
+	requestedProfile = profile;
+	framesInFlight = FRAME_PROFILES[static_cast<size_t>(profile)].framesInFlight;
+	currentFrame = 0;
+
+	createCommandBuffers();
+	createUniformBuffers();
+	createInstanceBuffers();
+	if (gpuCullingSupported) {
+		createGpuCuller();
+	}
+	createDescriptorPool();
+	createDescriptorSets();
+	createSyncObjects();
+	createTimestampQueries();
+	recreateSwapChain();
+}
+
+void	HelloTriApp::printFrameProfile(void)
+{
+	std::cout << "Frame profile " << FRAME_PROFILES[static_cast<size_t>(frameProfile)].name << ": "
+		<< framesInFlight << (framesInFlight == 1 ? " frame" : " frames") << " in flight, "
+		<< getPresentModeName(swapChainPresentMode) << " present mode";
+	if (frameStats.frames > 0) {
+		std::cout << ", frame " << frameStats.frameMs / frameStats.frames << " ms";
+	}
+	if (frameStats.latencyFrames > 0) {
+		std::cout << ", input to completion " << frameStats.latencyMs / frameStats.latencyFrames << " ms";
+	}
+	if (frameStats.presentFrames > 0) {
+		std::cout << ", input to present " << frameStats.presentLatencyMs / frameStats.presentFrames << " ms, "
+			<< frameStats.missedRefreshes << " missed refreshes";
+	}
+	if (options.pace && presentPacer.isEnabled()) {
+		std::cout << ", " << presentPacer.getRefreshMs() << " ms refresh";
+	}
+	std::cout << std::endl;
+}
+
+// The estimate runs from when a frame polls its input to when the host
+// sees its submission complete, the earliest it can be presented. Slots
+// are polled every frame, so frames that complete while the host blocks
+// elsewhere count late by at most a frame. With present wait the pacer's
+// measurements to the display are collected as well.
+void	HelloTriApp::updateLatency(void)
+{
+	auto		now = std::chrono::high_resolution_clock::now();
+	uint32_t	presentFrames;
+	double		presentLatencyMs;
+	uint32_t	missedRefreshes;
+
+	for (uint32_t frame = 0; frame < framesInFlight; frame++) {
+		if (latencyPending[frame] && timeline.isComplete(framePoints[frame])) {
+			latencyPending[frame] = false;
+			lastLatencyMs = std::chrono::duration<double, std::milli>(now - frameStartTimes[frame]).count();
+			frameStats.latencyFrames++;
+			frameStats.latencyMs += lastLatencyMs;
 		}
 	}
+
+	if (presentPacer.isEnabled()) {
+		presentPacer.collectLatency(presentFrames, presentLatencyMs, missedRefreshes);
+		frameStats.presentFrames += presentFrames;
+		frameStats.presentLatencyMs += presentLatencyMs;
+		frameStats.missedRefreshes += missedRefreshes;
+	}
+}
+
+// Paces fifo presentation when asked, then polls input. Pacing waits for
+// the previous frame to complete, which times its work, and lets the pacer
+// hold the frame back until its work just fits before the next refresh;
+// without present wait the wait alone keeps a single frame queued.
+void	HelloTriApp::beginFrame(void)
+{
+	uint32_t	previousFrame = (currentFrame + framesInFlight - 1) % framesInFlight;
+
+	if (options.pace && (swapChainPresentMode == VK_PRESENT_MODE_FIFO_KHR
+				|| swapChainPresentMode == VK_PRESENT_MODE_FIFO_RELAXED_KHR)) {
+		timeline.wait(framePoints[previousFrame]);
+		updateLatency();
+		presentPacer.pace(lastLatencyMs);
+	}
+
+	glfwPollEvents();
+	inputTime = std::chrono::high_resolution_clock::now();
 }
 
 void	HelloTriApp::updateUniformBuffer(uint32_t currentFrame) {
@@ -1357,52 +2155,65 @@ void	HelloTriApp::updateUniformBuffer(uint32_t currentFrame) {
 	ubo.proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float)swapChainExtent.height, 0.1f, 10.0f);
 	ubo.proj[1][1] *= -1;
 
-	memcpy(uniformBuffersMapped[currentFrame], &ubo, sizeof(ubo));
+	UniformAllocation	block = uniformRing.allocate(sizeof(ubo));
+
+	memcpy(block.mapped, &ubo, sizeof(ubo));
+	frameUniformOffset = block.offset;
+	frameUbo = ubo;
 }
 
 void	HelloTriApp::drawFrame(void)
 {
 	VkResult				result;
 	uint32_t				imageIndex;
-	VkSubmitInfo			submitInfo{};
-	VkPipelineStageFlags	waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
 	VkPresentInfoKHR		presentInfo{};
 	VkSwapchainKHR			swapChains[] = {swapChain};
-
-	vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+	auto					frameStart = std::chrono::high_resolution_clock::now();
+
+	updateLatency();
+	timeline.wait(framePoints[currentFrame]);
+	updateLatency();
+	readTimestamps(currentFrame);
+	updateTextureStreaming();
+	deletionQueue.update();
+
+	// Recreation may wait for events, which refresh callbacks can't, so
+	// redraw() leaves a stale swapchain to the next frame of the main loop
+	if (framebufferResized) {
+		framebufferResized = false;
+		recreateSwapChain();
+	}
 
 	result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-		recreateSwapChain();
+		framebufferResized = true;
 		return ;
 	} else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
 		throw std::runtime_error("failed to acquire swap chain image!");
 	}
 
-	vkResetFences(device, 1, &inFlightFences[currentFrame]);
+	frameWaits.assign(1, TimelineWait{imageAvailableSemaphores[currentFrame], 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT});
 
-	vkResetCommandBuffer(commandBuffers[currentFrame], 0);
-	recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+	auto	recordStart = std::chrono::high_resolution_clock::now();
 
-	VkSemaphore	signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
+	bindTextureDescriptor(currentFrame);
+	uniformRing.beginFrame(currentFrame);
+	updateUniformBuffer(currentFrame);
+	if (!activeGpuCulling) {
+		updateLods();
+	}
 
-	VkSemaphore	waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
+	vkResetCommandBuffer(commandBuffers[currentFrame], 0);
+	recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
 
-	updateUniformBuffer(currentFrame);
+	std::chrono::duration<double, std::milli>	recordTime = std::chrono::high_resolution_clock::now() - recordStart;
 
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = waitSemaphores;
-	submitInfo.pWaitDstStageMask = waitStages;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = signalSemaphores;
+	VkSemaphore	signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
 
-	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
-		throw std::runtime_error("failed to submit draw command buffer");
-	}
+	framePoints[currentFrame] = timeline.submit(graphicsTimeline, &commandBuffers[currentFrame], 1, frameWaits, {signalSemaphores[0]});
+	frameStartTimes[currentFrame] = inputTime;
+	latencyPending[currentFrame] = true;
 
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	presentInfo.waitSemaphoreCount = 1;
@@ -1411,20 +2222,44 @@ void	HelloTriApp::drawFrame(void)
 	presentInfo.pSwapchains = swapChains;
 	presentInfo.pImageIndices = &imageIndex;
 
-	result = vkQueuePresentKHR(graphicsQueue, &presentInfo);
+	result = presentPacer.present(presentQueue, presentInfo, inputTime);
 
-	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
-		framebufferResized = false;
-		recreateSwapChain();
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+		framebufferResized = true;
 	} else if (result != VK_SUCCESS) {
 		throw std::runtime_error("failed to acquire swap chain image!");
 	}
 
-	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	currentFrame = (currentFrame + 1) % framesInFlight;
+	frameNumber++;
+
+	std::chrono::duration<double, std::milli>	frameTime = std::chrono::high_resolution_clock::now() - frameStart;
+
+	frameStats.frames++;
+	frameStats.recordMs += recordTime.count();
+	frameStats.frameMs += frameTime.count();
 }
 
 void	HelloTriApp::initVulkan(void)
 {
+	auto	startTime = std::chrono::high_resolution_clock::now();
+	auto	phaseStart = startTime;
+	auto	logPhase = [&phaseStart](const char* phase) {
+		auto	now = std::chrono::high_resolution_clock::now();
+
+		std::cout << "Startup phase " << phase << ": "
+			<< std::chrono::duration<double, std::milli>(now - phaseStart).count() << " ms" << std::endl;
+		phaseStart = now;
+	};
+
+	// Decoding needs no Vulkan objects, so it starts before anything else
+	openAssetArchive();
+	if (options.compressTextures) {
+		textureCache.init(options.textureCacheDir);
+	}
+	assetLoader.init(jobs, &assetArchive, &textureCache);
+	loadTextureImage();
+
 	createInstance();
 	std::cout << "Vulkan instance created!" << std::endl;
 	setupDebugMessenger();
@@ -1432,74 +2267,407 @@ void	HelloTriApp::initVulkan(void)
 	pickPhysicalDevice();
 	std::cout << "Selected GPU: " << getPhysicalDeviceName(physicalDevice) << std::endl;
 	createLogicalDevice();
+	createTimeline();
+	createAllocator();
+	createPipelineCache();
+	createMipGenerator();
 	createSwapChain();
 	createImageViews();
 	createRenderPass();
 	createDescriptorSetLayout();
-	createGraphicsPipeline();
+	logPhase("device");
+
+	// Pipeline compilation is the slowest step of startup, so it overlaps
+	// with resource creation and uploads on the main thread
+	JobCounter	pipelinesReady;
+
+	jobs.submit([this]() {
+		createGraphicsPipeline();
+	}, &pipelinesReady);
+
 	createFramebuffers();
 	createCommandPools();
-	createTextureImage();
-	createTextureImageView();
-	createTextureSampler();
-	createVertexBuffer();
-	createIndexBuffer();
+	createUploader();
+	createTextureStreamer();
+	createGeometryPool();
 	createUniformBuffers();
+	createInstanceBuffers();
 	createDescriptorPool();
 	std::cout << "Descriptor pool created!" << std::endl;
-	createDescriptorSets();
-	std::cout << "Descriptor sets created!" << std::endl;
 	createCommandBuffers();
+	createDrawList();
+	createObjectBuffer();
+	createGpuCuller();
 	createSyncObjects();
+	createTimestampQueries();
+	logPhase("resources");
+
+	assetLoader.waitRequired();
+	createTextureImageView();
+	createTextureSampler();
+
+	// Frames only acquire completed upload batches, so everything the
+	// first frame uses has to have landed
+	uploader.wait(uploader.flush());
+	textureStreamer.update(frameNumber);
+
+	createDescriptorSets();
+	std::cout << "Descriptor sets created!" << std::endl;
+	logPhase("first-frame assets");
+
+	jobs.wait(pipelinesReady);
+	logPhase("pipelines");
+
+	allocator.printStats(std::cout);
+
+	std::chrono::duration<double, std::milli>	startupTime = std::chrono::high_resolution_clock::now() - startTime;
+
+	std::cout << "Startup took " << startupTime.count() << " ms ("
+		<< (pipelineCache.isWarm() ? "warm" : "cold") << " pipeline cache)" << std::endl;
+}
+
+void	HelloTriApp::redraw(void)
+{
+	if (!redrawAllowed || framebufferResized) {
+		return;
+	}
+
+	redrawAllowed = false;
+	inputTime = std::chrono::high_resolution_clock::now();
+	drawFrame();
+	redrawAllowed = true;
 }
 
 void	HelloTriApp::mainLoop(void)
 {
+	if (options.benchFrames > 0) {
+		runBenchmark();
+		vkDeviceWaitIdle(device);
+		return;
+	}
+
+	printFrameProfile();
 	while (!glfwWindowShouldClose(window))
 	{
-		glfwPollEvents();
+		redrawAllowed = true;
+		beginFrame();
+		redrawAllowed = false;
+		assetLoader.pump();
+		if (requestedProfile != frameProfile) {
+			printFrameProfile();
+			setFrameProfile(requestedProfile);
+			frameStats = FrameStats{};
+		}
 		drawFrame();
 	}
 
 	vkDeviceWaitIdle(device);
+	printFrameProfile();
+}
+
+// Renders the scene once inline and once per recording job count, one
+// draw call per quad, then once more with every quad in a single
+// instanced draw and, where supported, once culled on the GPU, and
+// reports average CPU recording and frame times for each
+void	HelloTriApp::runBenchmark(void)
+{
+	double		baselineRecordMs = 0.0;
+	double		baselineGpuMs = 0.0;
+	uint32_t	instancedPass = options.recordThreads + 1;
+	uint32_t	culledPass = instancedPass + 1;
+	uint32_t	meshletPass = culledPass + 1;
+	uint32_t	lastPass = meshletCullingSupported ? meshletPass : (gpuCullingSupported ? culledPass : instancedPass);
+
+	std::cout << "Benchmarking " << drawList.size() << " draws of " << geometryPool.getMesh(sceneMesh).lods[0].indexCount / 3 << " triangles ("
+		<< VERTEX_LAYOUT_NAME << " vertices, " << sizeof(SceneVertex) << " bytes) over " << options.benchFrames << " frames" << std::endl;
+
+	for (uint32_t pass = 0; pass <= lastPass; pass++) {
+		bool	instanced = (pass >= instancedPass);
+		bool	culled = (pass >= culledPass);
+		bool	meshlets = (pass == meshletPass);
+
+		activeInstanced = instanced;
+		activeGpuCulling = culled;
+		activeMeshletCulling = meshlets;
+		activeRecordThreads = instanced ? 0 : pass;
+		frameStats = FrameStats{};
+
+		while (frameStats.frames < options.benchFrames && !glfwWindowShouldClose(window)) {
+			beginFrame();
+			assetLoader.pump();
+			drawFrame();
+		}
+
+		if (frameStats.frames == 0) {
+			break;
+		}
+
+		double	recordMs = frameStats.recordMs / frameStats.frames;
+		double	frameMs = frameStats.frameMs / frameStats.frames;
+
+		double	gpuMs = frameStats.gpuFrames > 0 ? frameStats.gpuMs / frameStats.gpuFrames : 0.0;
+
+		if (pass == 0) {
+			baselineRecordMs = recordMs;
+			baselineGpuMs = gpuMs;
+			std::cout << "  inline:     ";
+		} else if (meshlets) {
+			std::cout << (drawIndirectCountSupported ? "  gpu meshlets: " : "  gpu meshlets (no count): ");
+		} else if (culled) {
+			std::cout << (drawIndirectCountSupported ? "  gpu culled: " : "  gpu culled (no count): ");
+		} else if (instanced) {
+			std::cout << "  instanced:  ";
+		} else {
+			std::cout << "  " << pass << (pass == 1 ? " job:      " : " jobs:     ");
+		}
+		std::cout << "record " << recordMs << " ms, frame " << frameMs << " ms";
+		if (frameStats.gpuFrames > 0) {
+			std::cout << ", gpu " << gpuMs << " ms";
+		}
+		if (pass > 0 && recordMs > 0.0) {
+			std::cout << ", " << baselineRecordMs / recordMs << "x inline recording";
+		}
+		if (instanced && gpuMs > 0.0 && baselineGpuMs > 0.0) {
+			std::cout << ", " << baselineGpuMs / gpuMs << "x inline gpu";
+		}
+		std::cout << std::endl;
+	}
+
+	activeRecordThreads = options.recordThreads;
+	activeInstanced = options.instanced;
+	activeGpuCulling = options.gpuCulling && gpuCullingSupported;
+	activeMeshletCulling = options.meshletCulling && meshletCullingSupported;
+	timeline.waitIdle();
+
+	std::cout << "  uniform ring: " << uniformRing.getPeakFrameUsage() / 1024 << " KiB peak per frame, "
+		<< uniformRing.getStride(sizeof(DrawItem)) << " byte draw blocks" << std::endl;
+
+	if (options.benchMips) {
+		runMipBenchmark();
+	}
+	if (options.benchLod) {
+		runLodBenchmark();
+	}
+	if (options.benchLatency) {
+		runLatencyBenchmark();
+	}
+}
+
+// Renders the scene sampling the full mip chain, then the base level only.
+// Each quad covers a small part of the screen, so without mips neighbouring
+// fragments fetch texels far apart and the GPU time grows with the texture
+// traffic; portable memory bandwidth counters don't exist, so render pass
+// time is what is reported.
+void	HelloTriApp::runMipBenchmark(void)
+{
+	UniqueSampler	baseLevelSampler = createSampler(0.0f);
+	VkDeviceSize	textureBytes = getTextureBytes();
+	VkDeviceSize	baseLevelBytes = textureBytes;
+	double			baselineGpuMs = 0.0;
+
+	// Level 0 is at least 3/4 of a full chain
+	if (textureMipLevels > 1) {
+		baseLevelBytes = textureBytes * 3 / 4;
+	}
+
+	std::cout << "Benchmarking " << drawList.size() << " minified quads, texture has " << textureMipLevels
+		<< " mip levels (" << textureBytes / 1024 << " KiB resident)" << std::endl;
+
+	for (VkSampler sampler : {textureSampler.get(), baseLevelSampler.get()}) {
+		bool	mipmapped = (sampler == textureSampler);
+
+		timeline.waitIdle();
+		activeTextureSampler = sampler;
+		timestampsWritten.assign(framesInFlight, false);
+		frameStats = FrameStats{};
+
+		while (frameStats.frames < options.benchFrames && !glfwWindowShouldClose(window)) {
+			beginFrame();
+			assetLoader.pump();
+			drawFrame();
+		}
+		timeline.waitIdle();
+		for (uint32_t i = 0; i < framesInFlight; i++) {
+			readTimestamps(i);
+		}
+
+		if (frameStats.frames == 0) {
+			break;
+		}
+
+		std::cout << (mipmapped ? "  trilinear:  " : "  base level: ")
+			<< "frame " << frameStats.frameMs / frameStats.frames << " ms";
+		if (frameStats.gpuFrames > 0) {
+			double	gpuMs = frameStats.gpuMs / frameStats.gpuFrames;
+
+			std::cout << ", gpu " << gpuMs << " ms";
+			if (mipmapped) {
+				baselineGpuMs = gpuMs;
+			} else if (baselineGpuMs > 0.0) {
+				std::cout << ", " << gpuMs / baselineGpuMs << "x trilinear";
+			}
+		}
+		std::cout << ", sampled levels " << (mipmapped ? textureBytes : baseLevelBytes) / 1024 << " KiB" << std::endl;
+	}
+
+	timeline.waitIdle();
+	activeTextureSampler = textureSampler;
+}
+
+// Renders the field instanced at full detail, then with levels of detail,
+// and the same on the GPU culled path where supported. Triangle counts
+// are only known on the CPU path; the GPU picks its own levels.
+void	HelloTriApp::runLodBenchmark(void)
+{
+	const MeshRange&	mesh = geometryPool.getMesh(sceneMesh);
+	double				baselineGpuMs = 0.0;
+
+	std::cout << "Benchmarking levels of detail: " << drawList.size() << " draws, " << mesh.lodCount << " levels (";
+	for (uint32_t lod = 0; lod < mesh.lodCount; lod++) {
+		std::cout << (lod > 0 ? "/" : "") << mesh.lods[lod].indexCount / 3;
+	}
+	std::cout << " triangles), " << options.lodPixelError << " pixel error" << std::endl;
+
+	if (options.lodPixelError <= 0.0f) {
+		std::cout << "  skipped, --lod-error is 0" << std::endl;
+		return;
+	}
+
+	for (bool culled : {false, true}) {
+		if (culled && !gpuCullingSupported) {
+			break;
+		}
+
+		for (bool lod : {false, true}) {
+			timeline.waitIdle();
+			activeInstanced = true;
+			activeGpuCulling = culled;
+			activeMeshletCulling = false;
+			activeRecordThreads = 0;
+			activeLod = lod;
+			drawLods.assign(drawList.size(), 0);
+			timestampsWritten.assign(framesInFlight, false);
+			frameStats = FrameStats{};
+
+			while (frameStats.frames < options.benchFrames && !glfwWindowShouldClose(window)) {
+				beginFrame();
+				assetLoader.pump();
+				drawFrame();
+			}
+			timeline.waitIdle();
+			for (uint32_t i = 0; i < framesInFlight; i++) {
+				readTimestamps(i);
+			}
+
+			if (frameStats.frames == 0) {
+				break;
+			}
+
+			double	frameMs = frameStats.frameMs / frameStats.frames;
+
+			std::cout << (culled ? "  gpu culled" : "  instanced") << (lod ? ", lod:  " : ", full: ")
+				<< "frame " << frameMs << " ms";
+			if (frameStats.gpuFrames > 0) {
+				double	gpuMs = frameStats.gpuMs / frameStats.gpuFrames;
+
+				std::cout << ", gpu " << gpuMs << " ms";
+				if (!lod) {
+					baselineGpuMs = gpuMs;
+				} else if (gpuMs > 0.0 && baselineGpuMs > 0.0) {
+					std::cout << ", " << baselineGpuMs / gpuMs << "x full detail";
+				}
+			}
+			if (!culled) {
+				double	triangles = static_cast<double>(frameStats.triangles) / frameStats.frames;
+
+				std::cout << ", " << triangles / 1e6 << " M triangles per frame";
+				if (frameStats.gpuFrames > 0 && frameStats.gpuMs > 0.0) {
+					std::cout << ", " << triangles * frameStats.gpuFrames / frameStats.gpuMs / 1e6 << " G triangles/s";
+				}
+			}
+			std::cout << std::endl;
+		}
+	}
+
+	timeline.waitIdle();
+	activeRecordThreads = options.recordThreads;
+	activeInstanced = options.instanced;
+	activeGpuCulling = options.gpuCulling && gpuCullingSupported;
+	activeMeshletCulling = options.meshletCulling && meshletCullingSupported;
+	activeLod = options.lodPixelError > 0.0f;
+}
+
+// Renders the scene under each frame profile and reports frame time and
+// latency, then returns to the profile from the options
+void	HelloTriApp::runLatencyBenchmark(void)
+{
+	std::cout << "Benchmarking frame profiles" << std::endl;
+
+	for (size_t profile = 0; profile < FRAME_PROFILES.size(); profile++) {
+		setFrameProfile(static_cast<FrameProfile>(profile));
+		frameStats = FrameStats{};
+
+		while (frameStats.frames < options.benchFrames && !glfwWindowShouldClose(window)) {
+			beginFrame();
+			assetLoader.pump();
+			drawFrame();
+		}
+		timeline.waitIdle();
+		updateLatency();
+
+		if (frameStats.frames == 0) {
+			break;
+		}
+
+		std::cout << "  ";
+		printFrameProfile();
+	}
+
+	setFrameProfile(options.frameProfile);
 }
 
 void	HelloTriApp::cleanup(void)
 {
+	presentPacer.destroy();
 	cleanupSwapChain();
 
-	vkDestroySampler(device, textureSampler, nullptr);
-	vkDestroyImageView(device, textureImageView, nullptr);
+	textureSampler.reset();
+	textureImageView.reset();
 
-	vkDestroyImage(device, textureImage, nullptr);
-	vkFreeMemory(device, textureImageMemory, nullptr);
+	textureImage.reset();
+	allocator.free(textureImageAllocation);
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-		vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+	if (textureStreamed) {
+		textureStreamer.printStats(std::cout);
 	}
+	textureStreamer.destroy();
 
-	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	cleanupFrameResources();
 
-	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+	if (gpuCullingSupported) {
+		objectBuffer.reset();
+		allocator.free(objectBufferAllocation);
+	}
 
-	vkDestroyBuffer(device, vertexBuffer, nullptr);
-	vkFreeMemory(device, vertexBufferMemory, nullptr);
+	descriptorSetLayout.reset();
 
-	vkDestroyBuffer(device, indexBuffer, nullptr);
-	vkFreeMemory(device, indexBufferMemory, nullptr);
+	geometryPool.printStats(std::cout);
+	geometryPool.destroy();
 
-	for (size_t i=0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-		vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-		vkDestroyFence(device, inFlightFences[i], nullptr);
-	}
+	graphicsCommandPool.reset();
 
-	vkDestroyCommandPool(device, graphicsCommandPool, nullptr);
+	graphicsPipeline.reset();
+	instancedPipeline.reset();
+	mipGenerator.destroy();
+	pipelineCache.save();
+	pipelineCache.destroy();
+	pipelineLayout.reset();
+	renderPass.reset();
 
-	vkDestroyPipeline(device, graphicsPipeline, nullptr);
-	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-	vkDestroyRenderPass(device, renderPass, nullptr);
+	assetLoader.destroy();
+	uploader.destroy();
+	allocator.destroy();
+	timeline.destroy();
 
 	vkDestroyDevice(device, nullptr);
 
@@ -1510,6 +2678,8 @@ void	HelloTriApp::cleanup(void)
 	vkDestroySurfaceKHR(instance, surface, nullptr);
 	vkDestroyInstance(instance, nullptr);
 
+	jobs.destroy();
+
 	glfwDestroyWindow(window);
 	glfwTerminate();
 	std::cout << "Cleanup..." << std::endl;
@@ -4,6 +4,22 @@
 #include <GLFW/glfw3.h>
 
 #include "readfile.h"
+#include "GpuAllocator.h"
+#include "Uploader.h"
+#include "GpuTimeline.h"
+#include "DeletionQueue.h"
+#include "PresentPacer.h"
+#include "PipelineCache.h"
+#include "Options.h"
+#include "JobSystem.h"
+#include "AssetLoader.h"
+#include "MipGenerator.h"
+#include "TextureStreamer.h"
+#include "UniformRing.h"
+#include "GpuCuller.h"
+#include "GeometryPool.h"
+#include "MeshImporter.h"
+#include "Vertex.h"
 #include <array>
 #include <cstdlib>
 #include <string>
@@ -26,14 +42,35 @@ const bool enableValidationLayers = true;
 const uint32_t	WIDTH = 800;
 const uint32_t	HEIGHT = 600;
 
-const int		MAX_FRAMES_IN_FLIGHT = 2;
+// Most frames in flight any profile uses; per frame arrays are sized for
+// the active profile's count
+const uint32_t	MAX_FRAMES_IN_FLIGHT = 3;
+
+// Least capacity of the shared vertex, index and meshlet buffers, in
+// elements; a larger scene mesh sizes them to fit
+const uint32_t	GEOMETRY_POOL_VERTICES = 1 << 20;
+const uint32_t	GEOMETRY_POOL_INDICES = 3 << 20;
+const uint32_t	GEOMETRY_POOL_MESHLETS = 1 << 16;
+
+// Most (object, meshlet) pairs culled per frame, each one indirect command
+const uint32_t	MAX_MESHLET_DRAWS = 1 << 20;
+
+// An object moves to a coarser level of detail once that level's error
+// projects under this fraction of the allowed pixel error, and back to a
+// finer one only when its own goes over the full amount. Distances are
+// clamped to the near plane. Mirrored in cull.comp.
+const float		LOD_HYSTERESIS = 0.75f;
+const float		LOD_MIN_DISTANCE = 0.1f;
+
+const std::string	PIPELINE_CACHE_PATH = "pipeline_cache.bin";
 
 const std::vector<const char*>		validationLayers = {
 	"VK_LAYER_KHRONOS_validation"
 };
 
 const std::vector<const char *>		deviceExtensions = {
-	VK_KHR_SWAPCHAIN_EXTENSION_NAME
+	VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+	VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME
 };
 
 const std::vector<VkDynamicState>	dynamicStates = {
@@ -41,6 +78,22 @@ const std::vector<VkDynamicState>	dynamicStates = {
 	VK_DYNAMIC_STATE_SCISSOR
 };
 
+// Frames in flight, swapchain images beyond the surface minimum, and
+// present modes in order of preference for each FrameProfile; FIFO, which
+// every surface supports, is the fallback
+struct	FrameProfileInfo {
+	const char*						name;
+	uint32_t						framesInFlight;
+	uint32_t						extraImages;
+	std::vector<VkPresentModeKHR>	presentModes;
+};
+
+const std::array<FrameProfileInfo, 3>	FRAME_PROFILES = {{
+	{"low latency", 1, 0, {VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR}},
+	{"balanced", 2, 1, {VK_PRESENT_MODE_MAILBOX_KHR}},
+	{"throughput", MAX_FRAMES_IN_FLIGHT, 2, {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR}}
+}};
+
 struct	SwapChainSupportDetails {
 	VkSurfaceCapabilitiesKHR		capabilities;
 	std::vector<VkSurfaceFormatKHR>	formats;
@@ -70,71 +123,66 @@ void	DestroyDebugUtilsMessengerEXT(VkInstance instance,
 		VkDebugUtilsMessengerEXT messenger,
 		const VkAllocationCallbacks *pAllocator);
 
-struct	Vertex {
-	glm::vec2	pos;
-	glm::vec3	color;
-	glm::vec2	texCoord;
-
-	static VkVertexInputBindingDescription	getBindingDescription() {
-		VkVertexInputBindingDescription		bindingDescription{};
-
-		bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(Vertex);
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-		return bindingDescription;
-	}
-
-	static	std::array<VkVertexInputAttributeDescription, 3>	getAttributeDescriptions() {
-		std::array<VkVertexInputAttributeDescription, 3>	attributeDescriptions{};
-
-		attributeDescriptions[0].binding = 0;
-		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-		attributeDescriptions[1].binding = 0;
-		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-		attributeDescriptions[2].binding = 0;
-		attributeDescriptions[2].location = 2;
-		attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-
-		return attributeDescriptions;
-	}
-};
-
 struct	UniformBufferObject {
 	glm::mat4	model;
 	glm::mat4	view;
 	glm::mat4	proj;
 };
 
+struct	FrameStats {
+	uint32_t	frames = 0;
+	double		recordMs = 0.0;
+	double		frameMs = 0.0;
+	uint32_t	gpuFrames = 0;
+	double		gpuMs = 0.0;
+	uint64_t	triangles = 0;
+	uint32_t	latencyFrames = 0;
+	double		latencyMs = 0.0;
+	uint32_t	presentFrames = 0;
+	double		presentLatencyMs = 0.0;
+	uint32_t	missedRefreshes = 0;
+};
+
 const	std::vector<Vertex>	vertices = {
-	{{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}, {1.0f, 0.0f}},
-	{{0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},
-	{{0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}},
-	{{-0.5f, 0.5f}, {1.0f, 1.0f, 1.0f}, {1.0f, 1.0f}}
+	{{-0.5f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}, {1.0f, 0.0f}},
+	{{0.5f, -0.5f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},
+	{{0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}},
+	{{-0.5f, 0.5f, 0.0f}, {1.0f, 1.0f, 1.0f}, {1.0f, 1.0f}}
 };
 
-const	std::vector<uint16_t> indices = {
+const	std::vector<uint32_t> indices = {
 	0, 1, 2, 2, 3, 0
 };
 
 class	HelloTriApp
 {
 	public:
-		bool	framebufferResized = false;
+		bool			framebufferResized = false;
+		FrameProfile	requestedProfile = FrameProfile::Balanced;
 
-		void	run(void);
+		void	run(const AppOptions& options);
+
+		// Draws from window refresh callbacks, which some platforms send
+		// instead of returning from event polling while a window is
+		// resized; nothing is drawn until the main loop has recreated a
+		// stale swapchain
+		void	redraw(void);
 
 	private:
+		AppOptions					options;
+		JobSystem					jobs;
+		AssetArchive				assetArchive;
+		AssetLoader					assetLoader;
+		TextureCache				textureCache;
+
 		VkInstance					instance;
 		VkPhysicalDevice			physicalDevice = VK_NULL_HANDLE;
 		VkDevice					device;
+		bool						memoryBudgetSupported = false;
+		bool						gpuCullingSupported = false;
+		bool						meshletCullingSupported = false;
+		bool						drawIndirectCountSupported = false;
+		bool						presentWaitSupported = false;
 
 		VkDebugUtilsMessengerEXT	debugMessenger;
 
@@ -144,47 +192,134 @@ class	HelloTriApp
 
 		VkSurfaceKHR				surface;
 
-		VkSwapchainKHR				swapChain;
-		std::vector<VkImage>		swapChainImages;
-		std::vector<VkImageView>	swapChainImageViews;
+		UniqueSwapchain					swapChain;
+		std::vector<VkImage>			swapChainImages;
+		std::vector<UniqueImageView>	swapChainImageViews;
 		VkFormat					swapChainImageFormat;
 		VkExtent2D					swapChainExtent;
-
-		VkRenderPass				renderPass;
-		VkDescriptorSetLayout		descriptorSetLayout;
-		VkPipelineLayout			pipelineLayout;
-		VkPipeline					graphicsPipeline;
-		std::vector<VkFramebuffer>	swapChainFramebuffers;
-
-		VkDescriptorPool				descriptorPool;
+		VkPresentModeKHR			swapChainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+
+		// Every per frame array below holds framesInFlight slots, set by
+		// the profile and rebuilt when it changes
+		FrameProfile				frameProfile = FrameProfile::Balanced;
+		uint32_t					framesInFlight = MAX_FRAMES_IN_FLIGHT;
+
+		UniqueRenderPass				renderPass;
+		UniqueDescriptorSetLayout		descriptorSetLayout;
+		UniquePipelineLayout			pipelineLayout;
+		UniquePipeline					graphicsPipeline;
+		UniquePipeline					instancedPipeline;
+		PipelineCache					pipelineCache;
+		MipGenerator					mipGenerator;
+		std::vector<UniqueFramebuffer>	swapChainFramebuffers;
+
+		// Objects released mid-run, such as a swapchain replaced by
+		// recreation, wait here for the last submission that used them,
+		// so resizing never idles the device
+		DeletionQueue					deletionQueue;
+
+		// Only while the main loop polls events, so refresh callbacks from
+		// polling inside a frame or a profile change don't nest frames
+		bool							redrawAllowed = false;
+
+		UniqueDescriptorPool			descriptorPool;
 		std::vector<VkDescriptorSet>	descriptorSets;
 
-		VkCommandPool				graphicsCommandPool;
-		VkCommandPool				transferCommandPool;
-
-		VkBuffer					vertexBuffer;
-		VkDeviceMemory				vertexBufferMemory;
-
-		std::vector<VkBuffer>		uniformBuffers;
-		std::vector<VkDeviceMemory>	uniformBuffersMemory;
-		std::vector<void *>			uniformBuffersMapped;
-
-		VkBuffer					indexBuffer;
-		VkDeviceMemory				indexBufferMemory;
-
-		VkImage						textureImage;
-		VkDeviceMemory				textureImageMemory;
-		VkImageView					textureImageView;
-		VkSampler					textureSampler;
+		UniqueCommandPool			graphicsCommandPool;
+
+		// Indexed [frame][batch]; each recording job resets and records only
+		// its own pool, so no locking is needed while recording
+		std::vector<std::vector<UniqueCommandPool>>	recordCommandPools;
+		std::vector<std::vector<VkCommandBuffer>>	recordCommandBuffers;
+		uint32_t									activeRecordThreads = 0;
+		bool										activeInstanced = false;
+		bool										activeGpuCulling = false;
+		bool										activeMeshletCulling = false;
+		bool										activeLod = false;
+
+		std::vector<DrawItem>		drawList;
+		FrameStats					frameStats;
+
+		// Level of detail each draw used last frame on the CPU paths; the
+		// GPU culler keeps its own
+		std::vector<uint32_t>		drawLods;
+
+		GpuAllocator				allocator;
+		Uploader					uploader;
+
+		GeometryPool				geometryPool;
+		uint32_t					sceneMesh = 0;
+		glm::vec3					sceneBoundsMin{0.0f};
+		glm::vec3					sceneBoundsMax{0.0f};
+		VertexQuantization			sceneQuantization;
+
+		UniformRing					uniformRing;
+		uint32_t					frameUniformOffset = 0;
+
+		// Host visible, one per frame in flight, rewritten from drawList
+		// every frame the instanced path is used
+		std::vector<UniqueBuffer>	instanceBuffers;
+		std::vector<GpuAllocation>	instanceBufferAllocations;
+
+		// Device local copy of drawList, culled on the GPU and read as the
+		// instance binding by indirect draws
+		UniqueBuffer				objectBuffer;
+		GpuAllocation				objectBufferAllocation;
+		GpuCuller					gpuCuller;
+
+		UniqueImage					textureImage;
+		GpuAllocation				textureImageAllocation;
+		uint32_t					textureMipLevels = 1;
+		VkFormat					textureFormat = VK_FORMAT_R8G8B8A8_SRGB;
+		VkExtent2D					textureExtent{};
+		UniqueImageView				textureImageView;
+		UniqueSampler				textureSampler;
+
+		// Textures with a precomputed mip chain are streamed; the view and
+		// sampler bound to each frame's descriptor set are rewritten before
+		// that frame is recorded whenever they change
+		TextureStreamer				textureStreamer;
+		bool						textureStreamed = false;
+		uint32_t					streamedTexture = 0;
+		VkSampler					activeTextureSampler = VK_NULL_HANDLE;
+		std::vector<VkImageView>	boundTextureViews;
+		std::vector<VkSampler>		boundTextureSamplers;
 
 		std::vector<VkCommandBuffer>	commandBuffers;
-		std::vector<VkSemaphore>		imageAvailableSemaphores;
-		std::vector<VkSemaphore>		renderFinishedSemaphores;
-		std::vector<VkFence>			inFlightFences;
+		std::vector<UniqueSemaphore>	imageAvailableSemaphores;
+		std::vector<UniqueSemaphore>	renderFinishedSemaphores;
+
+		// Every submit signals its queue's timeline; a frame slot is reused
+		// once the point of its last submit is reached
+		GpuTimeline					timeline;
+		uint32_t					graphicsTimeline = 0;
+		uint32_t					transferTimeline = 0;
+		std::vector<TimelinePoint>	framePoints;
+
+		// Two timestamps per frame in flight around the render pass, read
+		// back once the frame's timeline point is reached
+		UniqueQueryPool				timestampQueryPool;
+		double						timestampPeriodMs = 0.0;
+		std::vector<bool>			timestampsWritten;
+
+		// What the next graphics submit waits on: the swapchain image and
+		// the upload batches whose resources it acquires
+		std::vector<TimelineWait>	frameWaits;
+
+		// When each slot's last frame polled its input, until its
+		// submission is seen to complete; with present wait the pacer also
+		// times each frame to the display
+		std::chrono::high_resolution_clock::time_point				inputTime;
+		std::vector<std::chrono::high_resolution_clock::time_point>	frameStartTimes;
+		std::vector<bool>			latencyPending;
+		double						lastLatencyMs = 0.0;
+		PresentPacer				presentPacer;
 
 		GLFWwindow*					window;
 
 		uint32_t					currentFrame = 0;
+		uint64_t					frameNumber = 0;
+		UniformBufferObject			frameUbo{};
 
 		static VKAPI_ATTR VkBool32 VKAPI_CALL	debugCallback(
 				VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -211,6 +346,8 @@ class	HelloTriApp
 
 		bool	checkDeviceExtensionSupport(VkPhysicalDevice device);
 
+		bool	isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName);
+
 		int	rateDeviceSuitability(VkPhysicalDevice device);
 
 		VkExtent2D	chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
@@ -223,8 +360,6 @@ class	HelloTriApp
 
 		std::string	getPhysicalDeviceName(VkPhysicalDevice&	device);
 
-		uint32_t	findMemoryType(uint32_t	typeFilter, VkMemoryPropertyFlags properties);
-
 		void	initWindow(void);
 
 		void	createInstance(void);
@@ -233,15 +368,25 @@ class	HelloTriApp
 
 		void	createSurface(void);
 
+		void	createTimeline(void);
+
+		void	createAllocator(void);
+
+		void	createPipelineCache(void);
+
 		void	cleanupSwapChain(void);
 
 		void	recreateSwapChain(void);
 
+		void	retireSwapChain(void);
+
 		void	createSwapChain(void);
 
 		void	createImageViews(void);
 
-		VkShaderModule	createShaderModule(const std::vector<char>& code);
+		UniqueShaderModule	createShaderModule(const char* code, size_t size);
+
+		UniqueShaderModule	loadShaderModule(const std::string& path);
 
 		void	createRenderPass(void);
 
@@ -259,40 +404,90 @@ class	HelloTriApp
 
 		void	flushCommandBuffer(VkCommandBuffer commandBuffer);
 
-		void	createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+		void	createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, UniqueBuffer& buffer, GpuAllocation& bufferAllocation);
 
-		VkCommandBuffer	beginSingleTimeCommands(const VkCommandPool& commandPool);
+		void	createUploader(void);
 
-		void	endSingleTimeCommands(VkCommandPool& commandPool, VkCommandBuffer commandBuffer, VkQueue& queue);
+		void	createMipGenerator(void);
 
-		void	transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
+		void	transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseMipLevel = 0, uint32_t levelCount = 1);
 
-		void	copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+		void	createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkImageCreateFlags flags, VkMemoryPropertyFlags properties, UniqueImage &image, GpuAllocation &imageAllocation);
 
-		void	copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+		void	openAssetArchive(void);
 
-		void	createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage &image, VkDeviceMemory &imageMemory);
+		void	loadTextureImage(void);
 
-		void	createTextureImage(void);
+		bool	isTextureFormatSupported(VkFormat format);
+
+		void	createTextureImage(const DecodedImage& image);
 
 		void	createTextureImageView(void);
 
-		void	createTextureSampler(void);
+		void	createTextureStreamer(void);
 
-		void	createVertexBuffer(void);
+		VkImageView	getTextureView(void);
 
-		void	createIndexBuffer(void);
+		VkDeviceSize	getTextureBytes(void);
+
+		void	updateTextureStreaming(void);
+
+		UniqueSampler	createSampler(float maxLod);
+
+		void	createTextureSampler(void);
+
+		void	createGeometryPool(void);
 
 		void	createUniformBuffers(void);
 
+		void	createInstanceBuffers(void);
+
+		void	createObjectBuffer(void);
+
+		void	createGpuCuller(void);
+
 		void	createDescriptorPool(void);
 
 		void	createDescriptorSets(void);
 
+		void	bindTextureDescriptor(uint32_t frame);
+
+		void	createDrawList(void);
+
+		void	bindDrawState(VkCommandBuffer commandBuffer, VkPipeline pipeline);
+
+		float	getLodScale(void) const;
+
+		uint32_t	selectLod(uint32_t lod, const glm::mat4& model, const glm::vec3& camera, float lodScale) const;
+
+		void	updateLods(void);
+
+		void	recordDraws(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t drawCount);
+
+		void	recordInstanced(VkCommandBuffer commandBuffer);
+
+		void	recordCulled(VkCommandBuffer commandBuffer);
+
+		void	recordSecondary(uint32_t thread, uint32_t imageIndex, uint32_t firstDraw, uint32_t drawCount);
+
 		void	recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t	imageIndex);
 
 		void	createSyncObjects(void);
 
+		void	cleanupFrameResources(void);
+
+		void	setFrameProfile(FrameProfile profile);
+
+		void	printFrameProfile(void);
+
+		void	updateLatency(void);
+
+		void	beginFrame(void);
+
+		void	createTimestampQueries(void);
+
+		void	readTimestamps(uint32_t frame);
+
 		void	updateUniformBuffer(uint32_t currentFrame);
 
 		void	drawFrame(void);
@@ -301,5 +496,13 @@ class	HelloTriApp
 
 		void	mainLoop(void);
 
+		void	runBenchmark(void);
+
+		void	runMipBenchmark(void);
+
+		void	runLodBenchmark(void);
+
+		void	runLatencyBenchmark(void);
+
 		void	cleanup(void);
 };
@@ -0,0 +1,218 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+// Queue owned by the current thread. Threads the scheduler does not know
+// about share queue 0 with the thread that initialized it.
+static thread_local uint32_t	threadQueueIndex = 0;
+
+bool	JobCounter::isDone(void) const {
+	return pending.load(std::memory_order_acquire) == 0;
+}
+
+// Only reached with workers still running when startup threw
+JobSystem::~JobSystem(void) {
+	if (!workers.empty()) {
+		destroy();
+	}
+}
+
+void	JobSystem::init(uint32_t workerCount) {
+	queues.clear();
+	for (uint32_t i = 0; i <= workerCount; i++) {
+		queues.push_back(std::make_unique<WorkQueue>());
+	}
+
+	running = true;
+	threadQueueIndex = 0;
+
+	for (uint32_t i = 1; i <= workerCount; i++) {
+		workers.emplace_back(&JobSystem::workerLoop, this, i);
+	}
+}
+
+// Jobs still queued are dropped, so callers wait on their counters first
+void	JobSystem::destroy(void) {
+	{
+		std::lock_guard<std::mutex>	lock(sleepMutex);
+		running = false;
+	}
+	wakeCondition.notify_all();
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	workers.clear();
+	queues.clear();
+}
+
+uint32_t	JobSystem::getWorkerCount(void) const {
+	return static_cast<uint32_t>(workers.size());
+}
+
+void	JobSystem::push(Task task) {
+	WorkQueue&	queue = *queues[threadQueueIndex];
+
+	// Counted before it becomes visible so a thief can never decrement first
+	{
+		std::lock_guard<std::mutex>	lock(sleepMutex);
+		queuedCount++;
+	}
+	{
+		std::lock_guard<std::mutex>	lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+	wakeCondition.notify_one();
+}
+
+void	JobSystem::submit(Job job, JobCounter* counter) {
+	if (counter != nullptr) {
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+	push(Task{std::move(job), counter});
+}
+
+void	JobSystem::submitAfter(JobCounter& dependency, Job job, JobCounter* counter) {
+	if (counter != nullptr) {
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	{
+		std::lock_guard<std::mutex>	lock(dependency.mutex);
+
+		if (!dependency.isDone()) {
+			dependency.continuations.push_back([this, job = std::move(job), counter]() mutable {
+				push(Task{std::move(job), counter});
+			});
+			return;
+		}
+	}
+
+	push(Task{std::move(job), counter});
+}
+
+void	JobSystem::finish(JobCounter* counter) {
+	std::vector<Job>	continuations;
+
+	if (counter == nullptr) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex>	lock(counter->mutex);
+
+		if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			continuations.swap(counter->continuations);
+		}
+	}
+
+	for (auto& continuation : continuations) {
+		continuation();
+	}
+}
+
+bool	JobSystem::tryRunOne(void) {
+	Task		task;
+	bool		found = false;
+	uint32_t	queueCount = static_cast<uint32_t>(queues.size());
+
+	// Own queue from the back for cache locality, others from the front
+	for (uint32_t i = 0; i < queueCount && !found; i++) {
+		WorkQueue&					queue = *queues[(threadQueueIndex + i) % queueCount];
+		std::lock_guard<std::mutex>	lock(queue.mutex);
+
+		if (queue.tasks.empty()) {
+			continue;
+		}
+		if (i == 0) {
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+		} else {
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+		}
+		found = true;
+	}
+
+	if (!found) {
+		return false;
+	}
+	queuedCount--;
+
+	try {
+		task.job();
+	} catch (...) {
+		if (task.counter != nullptr) {
+			std::lock_guard<std::mutex>	lock(task.counter->mutex);
+
+			if (!task.counter->error) {
+				task.counter->error = std::current_exception();
+			}
+		}
+	}
+
+	finish(task.counter);
+	return true;
+}
+
+void	JobSystem::wait(JobCounter& counter) {
+	std::exception_ptr	error;
+
+	while (!counter.isDone()) {
+		if (!tryRunOne()) {
+			std::this_thread::yield();
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex>	lock(counter.mutex);
+		error = counter.error;
+		counter.error = nullptr;
+	}
+
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+// Splits [0, count) into at most batchCount contiguous ranges, runs them as
+// jobs and waits for all of them. Returns the number of batches used.
+uint32_t	JobSystem::parallelFor(uint32_t count, uint32_t batchCount, const std::function<void(uint32_t batch, uint32_t first, uint32_t count)>& func) {
+	JobCounter	counter;
+	uint32_t	batchSize;
+	uint32_t	batches = 0;
+
+	if (count == 0 || batchCount == 0) {
+		return 0;
+	}
+
+	batchSize = (count + batchCount - 1) / batchCount;
+
+	for (uint32_t first = 0; first < count; first += batchSize) {
+		uint32_t	batch = batches++;
+		uint32_t	size = std::min(batchSize, count - first);
+
+		submit([&func, batch, first, size]() {
+			func(batch, first, size);
+		}, &counter);
+	}
+
+	wait(counter);
+
+	return batches;
+}
+
+void	JobSystem::workerLoop(uint32_t index) {
+	threadQueueIndex = index;
+
+	while (running) {
+		if (tryRunOne()) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex>	lock(sleepMutex);
+
+		wakeCondition.wait(lock, [this]() {
+			return !running || queuedCount > 0;
+		});
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using Job = std::function<void(void)>;
+
+// Counts outstanding jobs. Jobs chained with JobSystem::submitAfter are
+// released once the count drops to zero, and the first exception thrown by
+// a counted job is rethrown by JobSystem::wait.
+class	JobCounter
+{
+	public:
+		bool	isDone(void) const;
+
+	private:
+		friend class	JobSystem;
+
+		std::atomic<uint32_t>	pending{0};
+		std::mutex				mutex;
+		std::vector<Job>		continuations;
+		std::exception_ptr		error;
+};
+
+// Work-stealing scheduler. Every worker, and the thread that called init,
+// owns a deque: owners push and pop at the back, idle threads steal from
+// the front of the others. Threads blocked in wait() run jobs instead of
+// sleeping.
+class	JobSystem
+{
+	public:
+		~JobSystem(void);
+
+		void	init(uint32_t workerCount);
+
+		void	destroy(void);
+
+		uint32_t	getWorkerCount(void) const;
+
+		void	submit(Job job, JobCounter* counter = nullptr);
+
+		void	submitAfter(JobCounter& dependency, Job job, JobCounter* counter = nullptr);
+
+		void	wait(JobCounter& counter);
+
+		uint32_t	parallelFor(uint32_t count, uint32_t batchCount, const std::function<void(uint32_t batch, uint32_t first, uint32_t count)>& func);
+
+	private:
+		struct	Task {
+			Job			job;
+			JobCounter*	counter = nullptr;
+		};
+
+		struct	WorkQueue {
+			std::mutex			mutex;
+			std::deque<Task>	tasks;
+		};
+
+		std::vector<std::unique_ptr<WorkQueue>>	queues;
+		std::vector<std::thread>				workers;
+
+		std::atomic<bool>		running{false};
+		std::atomic<uint32_t>	queuedCount{0};
+		std::mutex				sleepMutex;
+		std::condition_variable	wakeCondition;
+
+		void	push(Task task);
+
+		bool	tryRunOne(void);
+
+		void	finish(JobCounter* counter);
+
+		void	workerLoop(uint32_t index);
+};
@@ -0,0 +1,206 @@
+#include "Ktx2.h"
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+
+struct	Ktx2Header {
+	uint8_t		identifier[12];
+	uint32_t	vkFormat;
+	uint32_t	typeSize;
+	uint32_t	pixelWidth;
+	uint32_t	pixelHeight;
+	uint32_t	pixelDepth;
+	uint32_t	layerCount;
+	uint32_t	faceCount;
+	uint32_t	levelCount;
+	uint32_t	supercompressionScheme;
+	uint32_t	dfdByteOffset;
+	uint32_t	dfdByteLength;
+	uint32_t	kvdByteOffset;
+	uint32_t	kvdByteLength;
+	uint64_t	sgdByteOffset;
+	uint64_t	sgdByteLength;
+};
+
+struct	Ktx2LevelIndex {
+	uint64_t	byteOffset;
+	uint64_t	byteLength;
+	uint64_t	uncompressedByteLength;
+};
+
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header layout changed");
+static_assert(sizeof(Ktx2LevelIndex) == 24, "KTX2 level index layout changed");
+
+// Data format descriptor color models and channel ids from the Khronos
+// Data Format specification
+const uint32_t	KHR_DF_MODEL_BC1A = 128;
+const uint32_t	KHR_DF_MODEL_BC3 = 130;
+const uint32_t	KHR_DF_MODEL_BC7 = 133;
+const uint32_t	KHR_DF_CHANNEL_COLOR = 0;
+const uint32_t	KHR_DF_CHANNEL_ALPHA = 15;
+const uint32_t	KHR_DF_PRIMARIES_BT709 = 1;
+const uint32_t	KHR_DF_TRANSFER_LINEAR = 1;
+const uint32_t	KHR_DF_TRANSFER_SRGB = 2;
+
+struct	BlockFormat {
+	VkFormat	format;
+	uint32_t	blockBytes;
+	uint32_t	colorModel;
+	bool		srgb;
+};
+
+static const BlockFormat	blockFormats[] = {
+	{VK_FORMAT_BC1_RGB_UNORM_BLOCK, 8, KHR_DF_MODEL_BC1A, false},
+	{VK_FORMAT_BC1_RGB_SRGB_BLOCK, 8, KHR_DF_MODEL_BC1A, true},
+	{VK_FORMAT_BC1_RGBA_UNORM_BLOCK, 8, KHR_DF_MODEL_BC1A, false},
+	{VK_FORMAT_BC1_RGBA_SRGB_BLOCK, 8, KHR_DF_MODEL_BC1A, true},
+	{VK_FORMAT_BC3_UNORM_BLOCK, 16, KHR_DF_MODEL_BC3, false},
+	{VK_FORMAT_BC3_SRGB_BLOCK, 16, KHR_DF_MODEL_BC3, true},
+	{VK_FORMAT_BC7_UNORM_BLOCK, 16, KHR_DF_MODEL_BC7, false},
+	{VK_FORMAT_BC7_SRGB_BLOCK, 16, KHR_DF_MODEL_BC7, true},
+};
+
+static const BlockFormat*	findBlockFormat(VkFormat format) {
+	for (const BlockFormat& blockFormat : blockFormats) {
+		if (blockFormat.format == format) {
+			return &blockFormat;
+		}
+	}
+	return nullptr;
+}
+
+static uint64_t	alignUp(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+KtxTexture	parseKtx2(const char* data, size_t size) {
+	Ktx2Header			header;
+	KtxTexture			texture;
+	uint32_t			levelCount;
+	const BlockFormat*	blockFormat;
+
+	if (size < sizeof(header)) {
+		throw std::runtime_error("KTX2 file is truncated");
+	}
+	memcpy(&header, data, sizeof(header));
+
+	if (memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+		throw std::runtime_error("not a KTX2 file");
+	}
+	if (header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1 || header.pixelWidth == 0 || header.pixelHeight == 0) {
+		throw std::runtime_error("only single 2D KTX2 images are supported");
+	}
+	if (header.supercompressionScheme != 0) {
+		throw std::runtime_error("supercompressed KTX2 files are not supported");
+	}
+	if (header.vkFormat == VK_FORMAT_UNDEFINED) {
+		throw std::runtime_error("KTX2 file needs transcoding to a Vulkan format");
+	}
+	blockFormat = findBlockFormat(static_cast<VkFormat>(header.vkFormat));
+	if (blockFormat == nullptr) {
+		throw std::runtime_error("KTX2 file uses an unsupported format");
+	}
+
+	levelCount = std::max(header.levelCount, 1u);
+	if (size < sizeof(header) + levelCount * sizeof(Ktx2LevelIndex)) {
+		throw std::runtime_error("KTX2 level index is truncated");
+	}
+
+	texture.format = static_cast<VkFormat>(header.vkFormat);
+	texture.width = header.pixelWidth;
+	texture.height = header.pixelHeight;
+
+	for (uint32_t i = 0; i < levelCount; i++) {
+		Ktx2LevelIndex	index;
+		KtxLevel		level;
+
+		memcpy(&index, data + sizeof(header) + i * sizeof(index), sizeof(index));
+		level.width = std::max(header.pixelWidth >> i, 1u);
+		level.height = std::max(header.pixelHeight >> i, 1u);
+
+		if (index.byteOffset > size || index.byteLength > size - index.byteOffset) {
+			throw std::runtime_error("KTX2 level lies outside the file");
+		}
+		if (index.byteLength != uint64_t((level.width + 3) / 4) * ((level.height + 3) / 4) * blockFormat->blockBytes) {
+			throw std::runtime_error("KTX2 level size doesn't match its format and extent");
+		}
+
+		level.offset = index.byteOffset;
+		level.size = index.byteLength;
+		texture.levels.push_back(level);
+	}
+
+	return texture;
+}
+
+static std::vector<uint32_t>	buildDataFormatDescriptor(const BlockFormat& blockFormat) {
+	std::vector<uint32_t>	samples;
+	std::vector<uint32_t>	dfd;
+	uint32_t				blockBits = blockFormat.blockBytes * 8;
+
+	// BC3 stores the alpha block before the color block
+	if (blockFormat.colorModel == KHR_DF_MODEL_BC3) {
+		samples = {(63u << 16) | (KHR_DF_CHANNEL_ALPHA << 24), 0, 0, UINT32_MAX};
+		samples.insert(samples.end(), {64u | (63u << 16) | (KHR_DF_CHANNEL_COLOR << 24), 0, 0, UINT32_MAX});
+	} else {
+		samples = {((blockBits - 1) << 16) | (KHR_DF_CHANNEL_COLOR << 24), 0, 0, UINT32_MAX};
+	}
+
+	uint32_t	blockSize = 24 + static_cast<uint32_t>(samples.size()) * 4;
+
+	dfd.push_back(4 + blockSize);
+	dfd.push_back(0);
+	dfd.push_back(2 | (blockSize << 16));
+	dfd.push_back(blockFormat.colorModel | (KHR_DF_PRIMARIES_BT709 << 8)
+			| ((blockFormat.srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16));
+	dfd.push_back(3 | (3 << 8));
+	dfd.push_back(blockFormat.blockBytes);
+	dfd.push_back(0);
+	dfd.insert(dfd.end(), samples.begin(), samples.end());
+
+	return dfd;
+}
+
+// Level data is stored smallest first, as the specification requires
+std::vector<char>	writeKtx2(VkFormat format, uint32_t width, uint32_t height, const std::vector<std::vector<unsigned char>>& levels) {
+	const BlockFormat*			blockFormat = findBlockFormat(format);
+	Ktx2Header					header{};
+	std::vector<Ktx2LevelIndex>	indices(levels.size());
+	std::vector<uint32_t>		dfd;
+	std::vector<char>			file;
+	uint64_t					offset;
+
+	if (blockFormat == nullptr) {
+		throw std::runtime_error("unsupported KTX2 output format");
+	}
+	dfd = buildDataFormatDescriptor(*blockFormat);
+
+	memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	header.vkFormat = format;
+	header.typeSize = 1;
+	header.pixelWidth = width;
+	header.pixelHeight = height;
+	header.faceCount = 1;
+	header.levelCount = static_cast<uint32_t>(levels.size());
+	header.dfdByteOffset = static_cast<uint32_t>(sizeof(header) + indices.size() * sizeof(Ktx2LevelIndex));
+	header.dfdByteLength = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+
+	offset = header.dfdByteOffset + header.dfdByteLength;
+	for (size_t i = levels.size(); i-- > 0;) {
+		offset = alignUp(offset, blockFormat->blockBytes);
+		indices[i].byteOffset = offset;
+		indices[i].byteLength = levels[i].size();
+		indices[i].uncompressedByteLength = levels[i].size();
+		offset += levels[i].size();
+	}
+
+	file.resize(offset);
+	memcpy(file.data(), &header, sizeof(header));
+	memcpy(file.data() + sizeof(header), indices.data(), indices.size() * sizeof(Ktx2LevelIndex));
+	memcpy(file.data() + header.dfdByteOffset, dfd.data(), header.dfdByteLength);
+	for (size_t i = 0; i < levels.size(); i++) {
+		memcpy(file.data() + indices[i].byteOffset, levels[i].data(), levels[i].size());
+	}
+
+	return file;
+}
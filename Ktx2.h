@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// Minimal KTX2 container support: single 2D images with an optional mip
+// chain and no supercompression, which is what the texture cache writes
+// and what offline encoders emit for BCn data.
+const uint8_t	KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+// Offsets are from the start of the file
+struct	KtxLevel {
+	uint64_t	offset;
+	uint64_t	size;
+	uint32_t	width;
+	uint32_t	height;
+};
+
+struct	KtxTexture {
+	VkFormat				format = VK_FORMAT_UNDEFINED;
+	uint32_t				width = 0;
+	uint32_t				height = 0;
+	std::vector<KtxLevel>	levels;
+};
+
+KtxTexture	parseKtx2(const char* data, size_t size);
+
+// Levels are passed largest first; only BC1, BC3 and BC7 can be written
+std::vector<char>	writeKtx2(VkFormat format, uint32_t width, uint32_t height, const std::vector<std::vector<unsigned char>>& levels);
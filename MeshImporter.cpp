@@ -0,0 +1,836 @@
+#include "MeshImporter.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+// Bytes of a source file, from the archive mapping or a file mapping
+struct	MeshSource {
+	AssetData	archived;
+	MappedFile	mapped;
+	const char*	data = nullptr;
+	size_t		size = 0;
+};
+
+static void	openSource(const AssetArchive* archive, const std::string& path, MeshSource& source) {
+	const ArchiveEntry*	entry = archive != nullptr ? archive->find(path) : nullptr;
+
+	if (entry != nullptr) {
+		source.archived = archive->load(*entry);
+		source.data = source.archived.data;
+		source.size = source.archived.size;
+	} else {
+		source.mapped = MappedFile(path, MapHint::Sequential);
+		source.data = source.mapped.data();
+		source.size = source.mapped.size();
+	}
+}
+
+static bool	hasExtension(const std::string& path, const char* extension) {
+	std::string	lower = std::filesystem::path(path).extension().string();
+
+	std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+	return lower == extension;
+}
+
+// OBJ
+
+static int	resolveObjIndex(long index, size_t count, const std::string& path) {
+	long	resolved = index < 0 ? static_cast<long>(count) + index : index - 1;
+
+	if (index == 0 || resolved < 0 || resolved >= static_cast<long>(count)) {
+		throw std::runtime_error("invalid face index in " + path);
+	}
+	return static_cast<int>(resolved);
+}
+
+// Faces are fanned into triangles; a vertex colour following the position
+// (a common extension) is used when present. OBJ texture coordinates
+// start at the bottom, Vulkan's at the top.
+static void	parseObj(const char* data, size_t size, const std::string& path, std::vector<Vertex>& corners) {
+	std::vector<glm::vec3>	positions;
+	std::vector<glm::vec3>	colors;
+	std::vector<glm::vec2>	texCoords;
+	std::vector<Vertex>		face;
+	std::istringstream		stream(std::string(data, size));
+	std::string				line;
+
+	while (std::getline(stream, line)) {
+		std::istringstream	tokens(line);
+		std::string			keyword;
+
+		tokens >> keyword;
+
+		if (keyword == "v") {
+			glm::vec3	position(0.0f);
+			glm::vec3	color(1.0f);
+
+			tokens >> position.x >> position.y >> position.z;
+			if (!(tokens >> color.x >> color.y >> color.z)) {
+				color = glm::vec3(1.0f);
+			}
+			positions.push_back(position);
+			colors.push_back(color);
+		} else if (keyword == "vt") {
+			glm::vec2	texCoord(0.0f, 0.0f);
+
+			tokens >> texCoord.x >> texCoord.y;
+			texCoords.push_back(glm::vec2(texCoord.x, 1.0f - texCoord.y));
+		} else if (keyword == "f") {
+			std::string	corner;
+
+			face.clear();
+			while (tokens >> corner) {
+				Vertex		vertex{};
+				char*		next;
+				long		positionIndex = std::strtol(corner.c_str(), &next, 10);
+				int			position = resolveObjIndex(positionIndex, positions.size(), path);
+
+				vertex.pos = positions[position];
+				vertex.color = colors[position];
+				if (*next == '/' && next[1] != '/' && next[1] != '\0') {
+					vertex.texCoord = texCoords[resolveObjIndex(std::strtol(next + 1, nullptr, 10), texCoords.size(), path)];
+				}
+				face.push_back(vertex);
+			}
+			for (size_t i = 2; i < face.size(); i++) {
+				corners.push_back(face[0]);
+				corners.push_back(face[i - 1]);
+				corners.push_back(face[i]);
+			}
+		}
+	}
+}
+
+// JSON, only as much as glTF needs
+
+struct	JsonValue {
+	enum class	Type {
+		Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object
+	};
+
+	Type					type = Type::Null;
+	bool					boolean = false;
+	double					number = 0.0;
+	std::string				string;
+	std::vector<JsonValue>	elements;
+	std::vector<std::string>	keys;
+
+	const JsonValue*	find(const std::string& key) const {
+		for (size_t i = 0; i < keys.size(); i++) {
+			if (keys[i] == key) {
+				return &elements[i];
+			}
+		}
+		return nullptr;
+	}
+
+	const JsonValue&	at(const std::string& key) const {
+		const JsonValue*	value = find(key);
+
+		if (value == nullptr) {
+			throw std::runtime_error("glTF is missing \"" + key + "\"");
+		}
+		return *value;
+	}
+
+	const JsonValue&	at(size_t index) const {
+		if (type != Type::Array || index >= elements.size()) {
+			throw std::runtime_error("glTF index out of range");
+		}
+		return elements[index];
+	}
+
+	size_t	getSize(const std::string& key, size_t fallback) const {
+		const JsonValue*	value = find(key);
+
+		return value != nullptr ? static_cast<size_t>(value->number) : fallback;
+	}
+};
+
+class	JsonParser
+{
+	public:
+		JsonParser(const char* data, size_t size) : cursor(data), end(data + size) {}
+
+		JsonValue	parse(void) {
+			JsonValue	value = parseValue();
+
+			skipSpace();
+			if (cursor != end) {
+				fail();
+			}
+			return value;
+		}
+
+	private:
+		const char*	cursor;
+		const char*	end;
+
+		[[noreturn]] void	fail(void) {
+			throw std::runtime_error("malformed glTF JSON");
+		}
+
+		void	skipSpace(void) {
+			while (cursor != end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r')) {
+				cursor++;
+			}
+		}
+
+		void	expect(char c) {
+			skipSpace();
+			if (cursor == end || *cursor != c) {
+				fail();
+			}
+			cursor++;
+		}
+
+		bool	consume(const char* literal) {
+			size_t	length = strlen(literal);
+
+			if (static_cast<size_t>(end - cursor) < length || memcmp(cursor, literal, length) != 0) {
+				return false;
+			}
+			cursor += length;
+			return true;
+		}
+
+		// \u escapes outside ASCII are replaced, glTF keys and URIs
+		// that matter here are ASCII
+		std::string	parseString(void) {
+			std::string	result;
+
+			expect('"');
+			while (cursor != end && *cursor != '"') {
+				char	c = *cursor++;
+
+				if (c == '\\') {
+					if (cursor == end) {
+						fail();
+					}
+					c = *cursor++;
+					switch (c) {
+						case 'n': c = '\n'; break;
+						case 't': c = '\t'; break;
+						case 'r': c = '\r'; break;
+						case 'b': c = '\b'; break;
+						case 'f': c = '\f'; break;
+						case 'u': {
+							if (end - cursor < 4) {
+								fail();
+							}
+							unsigned long	code = std::strtoul(std::string(cursor, 4).c_str(), nullptr, 16);
+
+							cursor += 4;
+							c = code < 0x80 ? static_cast<char>(code) : '?';
+							break;
+						}
+						default: break;
+					}
+				}
+				result.push_back(c);
+			}
+			expect('"');
+			return result;
+		}
+
+		JsonValue	parseValue(void) {
+			JsonValue	value;
+
+			skipSpace();
+			if (cursor == end) {
+				fail();
+			}
+
+			if (*cursor == '{') {
+				value.type = JsonValue::Type::Object;
+				cursor++;
+				skipSpace();
+				if (cursor != end && *cursor == '}') {
+					cursor++;
+					return value;
+				}
+				do {
+					value.keys.push_back(parseString());
+					expect(':');
+					value.elements.push_back(parseValue());
+					skipSpace();
+				} while (cursor != end && *cursor == ',' && ++cursor);
+				expect('}');
+			} else if (*cursor == '[') {
+				value.type = JsonValue::Type::Array;
+				cursor++;
+				skipSpace();
+				if (cursor != end && *cursor == ']') {
+					cursor++;
+					return value;
+				}
+				do {
+					value.elements.push_back(parseValue());
+					skipSpace();
+				} while (cursor != end && *cursor == ',' && ++cursor);
+				expect(']');
+			} else if (*cursor == '"') {
+				value.type = JsonValue::Type::String;
+				value.string = parseString();
+			} else if (consume("true")) {
+				value.type = JsonValue::Type::Bool;
+				value.boolean = true;
+			} else if (consume("false")) {
+				value.type = JsonValue::Type::Bool;
+			} else if (consume("null")) {
+				value.type = JsonValue::Type::Null;
+			} else {
+				std::string	number;
+
+				while (cursor != end && (isdigit(static_cast<unsigned char>(*cursor)) || strchr("+-.eE", *cursor) != nullptr)) {
+					number.push_back(*cursor++);
+				}
+				if (number.empty()) {
+					fail();
+				}
+				value.type = JsonValue::Type::Number;
+				value.number = std::strtod(number.c_str(), nullptr);
+			}
+			return value;
+		}
+};
+
+// glTF
+
+const uint32_t	GLB_MAGIC = 0x46546c67;			// "glTF"
+const uint32_t	GLB_CHUNK_JSON = 0x4e4f534a;	// "JSON"
+const uint32_t	GLB_CHUNK_BIN = 0x004e4942;		// "BIN\0"
+
+const uint32_t	GLTF_BYTE = 5120;
+const uint32_t	GLTF_UNSIGNED_BYTE = 5121;
+const uint32_t	GLTF_SHORT = 5122;
+const uint32_t	GLTF_UNSIGNED_SHORT = 5123;
+const uint32_t	GLTF_UNSIGNED_INT = 5125;
+const uint32_t	GLTF_FLOAT = 5126;
+const uint32_t	GLTF_TRIANGLES = 4;
+
+struct	GltfBuffer {
+	MeshSource			source;
+	std::vector<char>	decoded;
+	const char*			data = nullptr;
+	size_t				size = 0;
+};
+
+static std::vector<char>	decodeBase64(const std::string& text) {
+	std::vector<char>	bytes;
+	uint32_t			bits = 0;
+	int					bitCount = 0;
+
+	for (char c : text) {
+		int	value;
+
+		if (c >= 'A' && c <= 'Z') {
+			value = c - 'A';
+		} else if (c >= 'a' && c <= 'z') {
+			value = c - 'a' + 26;
+		} else if (c >= '0' && c <= '9') {
+			value = c - '0' + 52;
+		} else if (c == '+') {
+			value = 62;
+		} else if (c == '/') {
+			value = 63;
+		} else {
+			continue;
+		}
+		bits = (bits << 6) | static_cast<uint32_t>(value);
+		bitCount += 6;
+		if (bitCount >= 8) {
+			bitCount -= 8;
+			bytes.push_back(static_cast<char>((bits >> bitCount) & 0xff));
+		}
+	}
+	return bytes;
+}
+
+static uint32_t	componentSize(uint32_t componentType) {
+	switch (componentType) {
+		case GLTF_BYTE:
+		case GLTF_UNSIGNED_BYTE:
+			return 1;
+		case GLTF_SHORT:
+		case GLTF_UNSIGNED_SHORT:
+			return 2;
+		case GLTF_UNSIGNED_INT:
+		case GLTF_FLOAT:
+			return 4;
+		default:
+			throw std::runtime_error("unsupported glTF component type");
+	}
+}
+
+static uint32_t	componentCount(const std::string& type) {
+	if (type == "SCALAR") {
+		return 1;
+	} else if (type == "VEC2") {
+		return 2;
+	} else if (type == "VEC3") {
+		return 3;
+	} else if (type == "VEC4") {
+		return 4;
+	}
+	throw std::runtime_error("unsupported glTF accessor type " + type);
+}
+
+// Reads any accessor as doubles, normalized integers mapped to [0, 1] or
+// [-1, 1] as the spec says; values are returned count * components
+static std::vector<double>	readAccessor(const JsonValue& gltf, const std::vector<GltfBuffer>& buffers, size_t accessorIndex, uint32_t& components) {
+	const JsonValue&	accessor = gltf.at("accessors").at(accessorIndex);
+	uint32_t			type = static_cast<uint32_t>(accessor.at("componentType").number);
+	size_t				count = accessor.getSize("count", 0);
+	const JsonValue*	normalizedValue = accessor.find("normalized");
+	bool				normalized = normalizedValue != nullptr && normalizedValue->boolean;
+	uint32_t			size = componentSize(type);
+	std::vector<double>	values;
+
+	if (accessor.find("sparse") != nullptr || accessor.find("bufferView") == nullptr) {
+		throw std::runtime_error("sparse glTF accessors are not supported");
+	}
+
+	const JsonValue&	view = gltf.at("bufferViews").at(accessor.getSize("bufferView", 0));
+	const GltfBuffer&	buffer = buffers.at(view.getSize("buffer", 0));
+	size_t				offset = view.getSize("byteOffset", 0) + accessor.getSize("byteOffset", 0);
+	size_t				stride;
+
+	components = componentCount(accessor.at("type").string);
+	stride = view.getSize("byteStride", static_cast<size_t>(size) * components);
+
+	if (count > 0 && (offset > buffer.size || (count - 1) * stride + static_cast<size_t>(size) * components > buffer.size - offset)) {
+		throw std::runtime_error("glTF accessor is out of bounds");
+	}
+
+	values.resize(count * components);
+	for (size_t i = 0; i < count; i++) {
+		const char*	element = buffer.data + offset + i * stride;
+
+		for (uint32_t c = 0; c < components; c++) {
+			const char*	src = element + c * size;
+			double		value = 0.0;
+
+			switch (type) {
+				case GLTF_BYTE: {
+					int8_t	v; memcpy(&v, src, 1);
+					value = normalized ? std::max(v / 127.0, -1.0) : v;
+					break;
+				}
+				case GLTF_UNSIGNED_BYTE: {
+					uint8_t	v; memcpy(&v, src, 1);
+					value = normalized ? v / 255.0 : v;
+					break;
+				}
+				case GLTF_SHORT: {
+					int16_t	v; memcpy(&v, src, 2);
+					value = normalized ? std::max(v / 32767.0, -1.0) : v;
+					break;
+				}
+				case GLTF_UNSIGNED_SHORT: {
+					uint16_t	v; memcpy(&v, src, 2);
+					value = normalized ? v / 65535.0 : v;
+					break;
+				}
+				case GLTF_UNSIGNED_INT: {
+					uint32_t	v; memcpy(&v, src, 4);
+					value = v;
+					break;
+				}
+				case GLTF_FLOAT: {
+					float	v; memcpy(&v, src, 4);
+					value = v;
+					break;
+				}
+			}
+			values[i * components + c] = value;
+		}
+	}
+	return values;
+}
+
+// Loads the JSON and every buffer of a .gltf or .glb file; the hash covers
+// external buffers too, so editing one invalidates the cache
+static JsonValue	loadGltf(const AssetArchive* archive, const std::string& path, const MeshSource& source, std::vector<GltfBuffer>& buffers, uint64_t& sourceHash) {
+	const char*		json = source.data;
+	size_t			jsonSize = source.size;
+	const char*		binary = nullptr;
+	size_t			binarySize = 0;
+	JsonValue		gltf;
+	std::string		directory = std::filesystem::path(path).parent_path().string();
+
+	sourceHash = fnv1a64(source.data, source.size);
+
+	if (source.size >= 12 && *reinterpret_cast<const uint32_t*>(source.data) == GLB_MAGIC) {
+		size_t	offset = 12;
+
+		json = nullptr;
+		while (offset + 8 <= source.size) {
+			uint32_t	chunkLength;
+			uint32_t	chunkType;
+
+			memcpy(&chunkLength, source.data + offset, 4);
+			memcpy(&chunkType, source.data + offset + 4, 4);
+			if (chunkLength > source.size - offset - 8) {
+				throw std::runtime_error("truncated GLB chunk in " + path);
+			}
+			if (chunkType == GLB_CHUNK_JSON && json == nullptr) {
+				json = source.data + offset + 8;
+				jsonSize = chunkLength;
+			} else if (chunkType == GLB_CHUNK_BIN && binary == nullptr) {
+				binary = source.data + offset + 8;
+				binarySize = chunkLength;
+			}
+			offset += 8 + ((chunkLength + 3) & ~3u);
+		}
+		if (json == nullptr) {
+			throw std::runtime_error("GLB without a JSON chunk: " + path);
+		}
+	}
+
+	gltf = JsonParser(json, jsonSize).parse();
+
+	if (const JsonValue* bufferList = gltf.find("buffers")) {
+		buffers.resize(bufferList->elements.size());
+
+		for (size_t i = 0; i < buffers.size(); i++) {
+			const JsonValue*	uri = bufferList->elements[i].find("uri");
+			GltfBuffer&			buffer = buffers[i];
+
+			if (uri == nullptr) {
+				if (binary == nullptr) {
+					throw std::runtime_error("glTF buffer without data in " + path);
+				}
+				buffer.data = binary;
+				buffer.size = binarySize;
+			} else if (uri->string.compare(0, 5, "data:") == 0) {
+				size_t	comma = uri->string.find(',');
+
+				if (comma == std::string::npos) {
+					throw std::runtime_error("malformed data URI in " + path);
+				}
+				buffer.decoded = decodeBase64(uri->string.substr(comma + 1));
+				buffer.data = buffer.decoded.data();
+				buffer.size = buffer.decoded.size();
+			} else {
+				std::string	bufferPath = directory.empty() ? uri->string : directory + "/" + uri->string;
+
+				openSource(archive, bufferPath, buffer.source);
+				buffer.data = buffer.source.data;
+				buffer.size = buffer.source.size;
+				sourceHash = sourceHash * 31 + fnv1a64(buffer.data, buffer.size);
+			}
+		}
+	}
+	return gltf;
+}
+
+static void	parseGltf(const JsonValue& gltf, const std::vector<GltfBuffer>& buffers, const std::string& path, std::vector<Vertex>& corners) {
+	const JsonValue*	meshes = gltf.find("meshes");
+
+	if (meshes == nullptr) {
+		throw std::runtime_error("glTF without meshes: " + path);
+	}
+
+	for (const JsonValue& mesh : meshes->elements) {
+		for (const JsonValue& primitive : mesh.at("primitives").elements) {
+			const JsonValue&		attributes = primitive.at("attributes");
+			const JsonValue*		texCoordAccessor = attributes.find("TEXCOORD_0");
+			const JsonValue*		colorAccessor = attributes.find("COLOR_0");
+			const JsonValue*		indexAccessor = primitive.find("indices");
+			uint32_t				positionComponents;
+			uint32_t				texCoordComponents = 0;
+			uint32_t				colorComponents = 0;
+			uint32_t				indexComponents = 1;
+			std::vector<double>		positions;
+			std::vector<double>		texCoords;
+			std::vector<double>		colors;
+			std::vector<double>		indices;
+			size_t					vertexCount;
+			size_t					cornerCount;
+
+			if (primitive.getSize("mode", GLTF_TRIANGLES) != GLTF_TRIANGLES) {
+				std::cout << "Skipping non-triangle primitive in " << path << std::endl;
+				continue;
+			}
+
+			if (attributes.find("POSITION") == nullptr) {
+				throw std::runtime_error("glTF primitive without positions in " + path);
+			}
+			positions = readAccessor(gltf, buffers, attributes.getSize("POSITION", 0), positionComponents);
+			if (positionComponents != 3) {
+				throw std::runtime_error("glTF primitive without VEC3 positions in " + path);
+			}
+			vertexCount = positions.size() / 3;
+
+			if (texCoordAccessor != nullptr) {
+				texCoords = readAccessor(gltf, buffers, static_cast<size_t>(texCoordAccessor->number), texCoordComponents);
+			}
+			if (colorAccessor != nullptr) {
+				colors = readAccessor(gltf, buffers, static_cast<size_t>(colorAccessor->number), colorComponents);
+			}
+			if (indexAccessor != nullptr) {
+				indices = readAccessor(gltf, buffers, static_cast<size_t>(indexAccessor->number), indexComponents);
+			}
+
+			cornerCount = indexAccessor != nullptr ? indices.size() : vertexCount;
+			for (size_t i = 0; i + 2 < cornerCount; i += 3) {
+				for (size_t k = 0; k < 3; k++) {
+					size_t	index = indexAccessor != nullptr ? static_cast<size_t>(indices[i + k]) : i + k;
+					Vertex	vertex{};
+
+					if (index >= vertexCount) {
+						throw std::runtime_error("glTF index out of range in " + path);
+					}
+					vertex.pos = glm::vec3(positions[index * 3], positions[index * 3 + 1], positions[index * 3 + 2]);
+					vertex.color = glm::vec3(1.0f);
+					if (texCoordComponents == 2 && index * 2 + 1 < texCoords.size()) {
+						vertex.texCoord = glm::vec2(texCoords[index * 2], texCoords[index * 2 + 1]);
+					}
+					if (colorComponents >= 3 && (index + 1) * colorComponents <= colors.size()) {
+						vertex.color = glm::vec3(colors[index * colorComponents], colors[index * colorComponents + 1],
+								colors[index * colorComponents + 2]);
+					}
+					corners.push_back(vertex);
+				}
+			}
+		}
+	}
+}
+
+// Importer
+
+void	MeshImporter::init(const std::string& cacheDirectory, const AssetArchive* archive) {
+	this->cacheDirectory = cacheDirectory;
+	this->archive = archive;
+
+	if (!cacheDirectory.empty()) {
+		std::filesystem::create_directories(cacheDirectory);
+	}
+}
+
+std::string	MeshImporter::pathFor(uint64_t sourceHash) const {
+	std::ostringstream	path;
+
+	path << cacheDirectory << "/" << std::hex << std::setw(16) << std::setfill('0') << sourceHash << ".mesh";
+	return path.str();
+}
+
+ImportedMesh	MeshImporter::load(const std::string& path) const {
+	ImportedMesh			mesh;
+	MeshSource				source;
+	std::vector<GltfBuffer>	buffers;
+	JsonValue				gltf;
+	uint64_t				sourceHash;
+	bool					isObj = hasExtension(path, ".obj");
+	std::vector<Vertex>		corners;
+
+	mesh.path = path;
+	openSource(archive, path, source);
+
+	if (isObj) {
+		sourceHash = fnv1a64(source.data, source.size);
+	} else if (hasExtension(path, ".gltf") || hasExtension(path, ".glb")) {
+		gltf = loadGltf(archive, path, source, buffers, sourceHash);
+	} else {
+		throw std::runtime_error("unsupported mesh format: " + path);
+	}
+	sourceHash ^= static_cast<uint64_t>(MESH_CACHE_VERSION) << 56;
+
+	if (loadCached(sourceHash, mesh)) {
+		return mesh;
+	}
+
+	if (isObj) {
+		parseObj(source.data, source.size, path, corners);
+	} else {
+		parseGltf(gltf, buffers, path, corners);
+	}
+	if (corners.empty()) {
+		throw std::runtime_error("mesh has no triangles: " + path);
+	}
+
+	deduplicateVertices(corners, mesh.vertices, mesh.indices);
+	mesh.source = analyzeVertexCache(mesh.indices, static_cast<uint32_t>(mesh.vertices.size()));
+
+	optimizeVertexCache(mesh.indices, static_cast<uint32_t>(mesh.vertices.size()));
+	optimizeOverdraw(mesh.indices, mesh.vertices);
+	optimizeVertexFetch(mesh.vertices, mesh.indices);
+	mesh.optimized = analyzeVertexCache(mesh.indices, static_cast<uint32_t>(mesh.vertices.size()));
+	mesh.meshlets = buildMeshlets(mesh.vertices, mesh.indices);
+	mesh.lods = buildLods(mesh.vertices, mesh.indices);
+
+	mesh.indexType = mesh.vertices.size() <= 0x10000 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+	mesh.boundsMin = mesh.vertices[0].pos;
+	mesh.boundsMax = mesh.vertices[0].pos;
+	for (const Vertex& vertex : mesh.vertices) {
+		mesh.boundsMin = glm::min(mesh.boundsMin, vertex.pos);
+		mesh.boundsMax = glm::max(mesh.boundsMax, vertex.pos);
+	}
+
+	storeCached(sourceHash, mesh);
+	return mesh;
+}
+
+static bool	inRange(uint32_t first, uint32_t count, uint32_t total) {
+	return first <= total && count <= total - first;
+}
+
+// A stale or corrupt cache file is rejected, and the mesh rebuilt, rather
+// than letting out of range indices reach the GPU
+bool	MeshImporter::loadCached(uint64_t sourceHash, ImportedMesh& mesh) const {
+	std::string		path = pathFor(sourceHash);
+	MappedFile		file;
+	MeshCacheHeader	header;
+	size_t			vertexBytes;
+	size_t			indexBytes;
+	size_t			meshletBytes;
+	size_t			lodBytes;
+	const char*		indices;
+
+	if (cacheDirectory.empty() || !std::filesystem::exists(path)) {
+		return false;
+	}
+
+	file = MappedFile(path, MapHint::Sequential);
+	if (file.size() < sizeof(header)) {
+		return false;
+	}
+	memcpy(&header, file.data(), sizeof(header));
+
+	vertexBytes = static_cast<size_t>(header.vertexCount) * sizeof(Vertex);
+	indexBytes = static_cast<size_t>(header.indexCount) * header.indexSize;
+	meshletBytes = static_cast<size_t>(header.meshletCount) * sizeof(Meshlet);
+	lodBytes = static_cast<size_t>(header.lodCount) * sizeof(MeshLod);
+	if (header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION || header.vertexStride != sizeof(Vertex)
+			|| (header.indexSize != 2 && header.indexSize != 4) || header.lodCount == 0 || header.lodCount > MAX_MESH_LODS
+			|| file.size() - sizeof(header) < vertexBytes + indexBytes + meshletBytes + lodBytes) {
+		return false;
+	}
+
+	mesh.vertices.resize(header.vertexCount);
+	memcpy(mesh.vertices.data(), file.data() + sizeof(header), vertexBytes);
+
+	indices = file.data() + sizeof(header) + vertexBytes;
+	mesh.indices.resize(header.indexCount);
+	for (uint32_t i = 0; i < header.indexCount; i++) {
+		if (header.indexSize == 2) {
+			uint16_t	index;
+
+			memcpy(&index, indices + i * 2, 2);
+			mesh.indices[i] = index;
+		} else {
+			memcpy(&mesh.indices[i], indices + i * 4, 4);
+		}
+		if (mesh.indices[i] >= header.vertexCount) {
+			return false;
+		}
+	}
+
+	mesh.meshlets.resize(header.meshletCount);
+	memcpy(mesh.meshlets.data(), indices + indexBytes, meshletBytes);
+	mesh.lods.resize(header.lodCount);
+	memcpy(mesh.lods.data(), indices + indexBytes + meshletBytes, lodBytes);
+
+	for (const Meshlet& meshlet : mesh.meshlets) {
+		if (!inRange(meshlet.firstIndex, meshlet.indexCount, header.indexCount)) {
+			return false;
+		}
+	}
+	for (const MeshLod& lod : mesh.lods) {
+		if (!inRange(lod.firstIndex, lod.indexCount, header.indexCount)) {
+			return false;
+		}
+	}
+
+	mesh.indexType = header.indexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+	mesh.boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	mesh.boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+	mesh.source.triangles = mesh.lods[0].indexCount / 3;
+	mesh.source.vertices = header.vertexCount;
+	mesh.source.acmr = header.sourceAcmr;
+	mesh.source.atvr = header.sourceAtvr;
+	mesh.optimized = mesh.source;
+	mesh.optimized.acmr = header.acmr;
+	mesh.optimized.atvr = header.atvr;
+	mesh.cached = true;
+	return true;
+}
+
+// Written next to the final name and renamed over it, like the texture
+// cache
+void	MeshImporter::storeCached(uint64_t sourceHash, const ImportedMesh& mesh) const {
+	std::string			path = pathFor(sourceHash);
+	std::ostringstream	tmpPath;
+	MeshCacheHeader		header{};
+	std::ofstream		file;
+
+	if (cacheDirectory.empty()) {
+		return;
+	}
+
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.vertexStride = sizeof(Vertex);
+	header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+	header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+	header.indexSize = mesh.indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4;
+	for (int i = 0; i < 3; i++) {
+		header.boundsMin[i] = mesh.boundsMin[i];
+		header.boundsMax[i] = mesh.boundsMax[i];
+	}
+	header.sourceAcmr = mesh.source.acmr;
+	header.sourceAtvr = mesh.source.atvr;
+	header.acmr = mesh.optimized.acmr;
+	header.atvr = mesh.optimized.atvr;
+	header.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+	header.lodCount = static_cast<uint32_t>(mesh.lods.size());
+
+	tmpPath << path << "." << std::this_thread::get_id() << ".tmp";
+	file.open(tmpPath.str(), std::ios::binary | std::ios::trunc);
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(mesh.vertices.data()), static_cast<std::streamsize>(mesh.vertices.size() * sizeof(Vertex)));
+	if (header.indexSize == 2) {
+		std::vector<uint16_t>	narrow(mesh.indices.begin(), mesh.indices.end());
+
+		file.write(reinterpret_cast<const char*>(narrow.data()), static_cast<std::streamsize>(narrow.size() * 2));
+	} else {
+		file.write(reinterpret_cast<const char*>(mesh.indices.data()), static_cast<std::streamsize>(mesh.indices.size() * 4));
+	}
+	file.write(reinterpret_cast<const char*>(mesh.meshlets.data()), static_cast<std::streamsize>(mesh.meshlets.size() * sizeof(Meshlet)));
+	file.write(reinterpret_cast<const char*>(mesh.lods.data()), static_cast<std::streamsize>(mesh.lods.size() * sizeof(MeshLod)));
+	file.close();
+	if (!file) {
+		std::filesystem::remove(tmpPath.str());
+		throw std::runtime_error("failed to write mesh cache file " + tmpPath.str());
+	}
+
+	std::filesystem::rename(tmpPath.str(), path);
+}
+
+void	MeshImporter::printStats(const ImportedMesh& mesh, std::ostream& out) {
+	out << std::fixed << std::setprecision(3)
+		<< "Mesh " << mesh.path << ": " << mesh.optimized.triangles << " triangles, " << mesh.optimized.vertices << " vertices, "
+		<< (mesh.indexType == VK_INDEX_TYPE_UINT16 ? 16 : 32) << "-bit indices, " << mesh.meshlets.size() << " meshlets, ACMR " << mesh.source.acmr << " -> " << mesh.optimized.acmr
+		<< ", ATVR " << mesh.source.atvr << " -> " << mesh.optimized.atvr << (mesh.cached ? " (cached)" : "") << std::endl;
+	out << "  " << mesh.lods.size() << " levels of detail:";
+	for (const MeshLod& lod : mesh.lods) {
+		out << " " << lod.indexCount / 3 << " (" << lod.error << ")";
+	}
+	out << " triangles (error)" << std::endl;
+	out << std::defaultfloat;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Vertex.h"
+#include "MeshOptimizer.h"
+#include "AssetArchive.h"
+#include "readfile.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Bumped whenever the optimizer output or the Vertex layout changes
+const uint32_t	MESH_CACHE_VERSION = 3;
+const uint32_t	MESH_CACHE_MAGIC = 0x48534d56;	// "VMSH"
+
+// Cached meshes are this header followed by the vertices, the indices of
+// every level of detail, each indexSize bytes, the meshlets and the levels
+struct	MeshCacheHeader {
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	vertexStride;
+	uint32_t	vertexCount;
+	uint32_t	indexCount;
+	uint32_t	indexSize;
+	float		boundsMin[3];
+	float		boundsMax[3];
+	float		sourceAcmr;
+	float		sourceAtvr;
+	float		acmr;
+	float		atvr;
+	uint32_t	meshletCount;
+	uint32_t	lodCount;
+	uint32_t	padding[2];
+};
+
+static_assert(sizeof(MeshCacheHeader) == 80, "mesh cache header layout changed");
+
+// indexType is the smallest index size the mesh fits; indices are kept
+// 32-bit in memory. source holds the cache statistics of the file as it
+// was authored, after vertex deduplication. indices holds every level of
+// detail back to back, lods[0] being the full mesh; meshlets cover that
+// level only.
+struct	ImportedMesh {
+	std::string				path;
+	std::vector<Vertex>		vertices;
+	std::vector<uint32_t>	indices;
+	std::vector<Meshlet>	meshlets;
+	std::vector<MeshLod>	lods;
+	VkIndexType				indexType = VK_INDEX_TYPE_UINT32;
+	glm::vec3				boundsMin{0.0f};
+	glm::vec3				boundsMax{0.0f};
+	VertexCacheStats		source;
+	VertexCacheStats		optimized;
+	bool					cached = false;
+};
+
+// Loads triangle meshes from OBJ and glTF (.gltf with external or data
+// URI buffers, and .glb) files, from the archive or disk. Vertices are
+// deduplicated, triangles reordered for the vertex cache and then for
+// overdraw, and vertices for fetch locality; the final triangle order is
+// then split into meshlets and simplified into levels of detail. The
+// result is cached in a binary file named after a hash of the source
+// bytes, so a cache hit is one read and a copy.
+//
+// Every primitive of every glTF mesh is merged in mesh space; node
+// transforms, normals and materials are ignored since Vertex holds none.
+class	MeshImporter
+{
+	public:
+		void	init(const std::string& cacheDirectory, const AssetArchive* archive = nullptr);
+
+		ImportedMesh	load(const std::string& path) const;
+
+		static void	printStats(const ImportedMesh& mesh, std::ostream& out);
+
+	private:
+		std::string			cacheDirectory;
+		const AssetArchive*	archive = nullptr;
+
+		std::string	pathFor(uint64_t sourceHash) const;
+
+		bool	loadCached(uint64_t sourceHash, ImportedMesh& mesh) const;
+
+		void	storeCached(uint64_t sourceHash, const ImportedMesh& mesh) const;
+};
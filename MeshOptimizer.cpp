@@ -0,0 +1,718 @@
+#include "MeshOptimizer.h"
+#include "AssetArchive.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+VertexCacheStats	analyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize) {
+	VertexCacheStats		stats;
+	std::vector<uint32_t>	timestamps(vertexCount, 0);
+	uint32_t				time = cacheSize + 1;
+	uint32_t				misses = 0;
+
+	// A vertex is in the FIFO if it was pushed less than cacheSize misses ago
+	for (uint32_t index : indices) {
+		if (time - timestamps[index] > cacheSize) {
+			timestamps[index] = time++;
+			misses++;
+		}
+	}
+
+	stats.triangles = static_cast<uint32_t>(indices.size() / 3);
+	stats.vertices = vertexCount;
+	stats.acmr = stats.triangles > 0 ? static_cast<float>(misses) / stats.triangles : 0.0f;
+	stats.atvr = vertexCount > 0 ? static_cast<float>(misses) / vertexCount : 0.0f;
+	return stats;
+}
+
+struct	VertexHasher {
+	size_t	operator()(const Vertex& vertex) const {
+		return static_cast<size_t>(fnv1a64(reinterpret_cast<const char*>(&vertex), sizeof(Vertex)));
+	}
+};
+
+struct	VertexEqual {
+	bool	operator()(const Vertex& a, const Vertex& b) const {
+		return memcmp(&a, &b, sizeof(Vertex)) == 0;
+	}
+};
+
+void	deduplicateVertices(const std::vector<Vertex>& corners, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	std::unordered_map<Vertex, uint32_t, VertexHasher, VertexEqual>	unique;
+
+	vertices.clear();
+	indices.clear();
+	indices.reserve(corners.size());
+	unique.reserve(corners.size());
+
+	for (const Vertex& corner : corners) {
+		auto	inserted = unique.emplace(corner, static_cast<uint32_t>(vertices.size()));
+
+		if (inserted.second) {
+			vertices.push_back(corner);
+		}
+		indices.push_back(inserted.first->second);
+	}
+}
+
+// Scoring constants from Forsyth's article
+static const uint32_t	FORSYTH_CACHE_SIZE = 32;
+static const float		FORSYTH_CACHE_DECAY = 1.5f;
+static const float		FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+static const float		FORSYTH_VALENCE_SCALE = 2.0f;
+static const float		FORSYTH_VALENCE_POWER = 0.5f;
+
+static float	forsythScore(int cachePosition, uint32_t remainingValence) {
+	float	score = 0.0f;
+
+	if (remainingValence == 0) {
+		return -1.0f;
+	}
+
+	if (cachePosition >= 0) {
+		if (cachePosition < 3) {
+			score = FORSYTH_LAST_TRIANGLE_SCORE;
+		} else {
+			float	scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+
+			score = std::pow(1.0f - (cachePosition - 3) * scale, FORSYTH_CACHE_DECAY);
+		}
+	}
+
+	return score + FORSYTH_VALENCE_SCALE * std::pow(static_cast<float>(remainingValence), -FORSYTH_VALENCE_POWER);
+}
+
+void	optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount) {
+	uint32_t				triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	std::vector<uint32_t>	valence(vertexCount, 0);
+	std::vector<uint32_t>	adjacencyOffsets(vertexCount + 1, 0);
+	std::vector<uint32_t>	adjacency(indices.size());
+	std::vector<int>		cachePosition(vertexCount, -1);
+	std::vector<float>		vertexScores(vertexCount);
+	std::vector<float>		triangleScores(triangleCount);
+	std::vector<bool>		emitted(triangleCount, false);
+	std::vector<uint32_t>	cache;
+	std::vector<uint32_t>	newCache;
+	std::vector<uint32_t>	result;
+	uint32_t				scanCursor = 0;
+
+	if (triangleCount == 0) {
+		return;
+	}
+
+	for (uint32_t index : indices) {
+		valence[index]++;
+	}
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + valence[v];
+	}
+	{
+		std::vector<uint32_t>	fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+		for (uint32_t t = 0; t < triangleCount; t++) {
+			for (int k = 0; k < 3; k++) {
+				adjacency[fill[indices[t * 3 + k]]++] = t;
+			}
+		}
+	}
+
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		vertexScores[v] = forsythScore(-1, valence[v]);
+	}
+	for (uint32_t t = 0; t < triangleCount; t++) {
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+	}
+
+	result.reserve(indices.size());
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+	while (result.size() < indices.size()) {
+		int		best = -1;
+		float	bestScore = -1.0f;
+
+		// Candidates are the triangles of the vertices in the cache
+		for (uint32_t v : cache) {
+			for (uint32_t i = adjacencyOffsets[v]; i < adjacencyOffsets[v + 1]; i++) {
+				uint32_t	t = adjacency[i];
+
+				if (!emitted[t] && triangleScores[t] > bestScore) {
+					bestScore = triangleScores[t];
+					best = static_cast<int>(t);
+				}
+			}
+		}
+
+		// Dead end: restart from the next triangle in input order
+		if (best < 0) {
+			while (emitted[scanCursor]) {
+				scanCursor++;
+			}
+			best = static_cast<int>(scanCursor);
+		}
+
+		emitted[best] = true;
+		newCache.clear();
+
+		for (int k = 0; k < 3; k++) {
+			uint32_t	v = indices[best * 3 + k];
+
+			result.push_back(v);
+			valence[v]--;
+			newCache.push_back(v);
+		}
+		for (uint32_t v : cache) {
+			if (std::find(newCache.begin(), newCache.end(), v) == newCache.end()) {
+				newCache.push_back(v);
+			}
+		}
+
+		// Vertices pushed out of the cache lose their position score too
+		for (uint32_t i = 0; i < newCache.size(); i++) {
+			uint32_t	v = newCache[i];
+
+			cachePosition[v] = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+		}
+		for (uint32_t v : newCache) {
+			float	score = forsythScore(cachePosition[v], valence[v]);
+			float	delta = score - vertexScores[v];
+
+			vertexScores[v] = score;
+			for (uint32_t i = adjacencyOffsets[v]; i < adjacencyOffsets[v + 1]; i++) {
+				triangleScores[adjacency[i]] += delta;
+			}
+		}
+
+		if (newCache.size() > FORSYTH_CACHE_SIZE) {
+			newCache.resize(FORSYTH_CACHE_SIZE);
+		}
+		cache.swap(newCache);
+	}
+
+	indices.swap(result);
+}
+
+struct	TriangleCluster {
+	uint32_t	start;
+	uint32_t	end;
+	float		sortKey;
+};
+
+// Counts the misses of one triangle in a FIFO cache simulated with
+// timestamps; bumping time by more than the cache size empties it
+static uint32_t	updateCache(const uint32_t* triangle, std::vector<uint32_t>& timestamps, uint32_t& time) {
+	uint32_t	misses = 0;
+
+	for (int k = 0; k < 3; k++) {
+		if (time - timestamps[triangle[k]] > VERTEX_CACHE_SIZE) {
+			timestamps[triangle[k]] = time++;
+			misses++;
+		}
+	}
+	return misses;
+}
+
+void	optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold) {
+	uint32_t					triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	std::vector<uint32_t>		timestamps(vertices.size(), 0);
+	uint32_t					time = VERTEX_CACHE_SIZE + 1;
+	std::vector<uint32_t>		hardBoundaries;
+	std::vector<TriangleCluster>	clusters;
+	glm::vec3					meshCentroid(0.0f);
+	float						meshArea = 0.0f;
+	std::vector<uint32_t>		result;
+
+	if (triangleCount < 2) {
+		return;
+	}
+
+	// A triangle whose three vertices all miss starts a hard cluster;
+	// reordering those costs nothing
+	for (uint32_t t = 0; t < triangleCount; t++) {
+		if (updateCache(&indices[t * 3], timestamps, time) == 3 || t == 0) {
+			hardBoundaries.push_back(t);
+		}
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	// Hard clusters are split further wherever the part since the last
+	// split, including its cold start, is within threshold of the
+	// cluster's own ACMR
+	for (size_t c = 0; c + 1 < hardBoundaries.size(); c++) {
+		uint32_t	start = hardBoundaries[c];
+		uint32_t	end = hardBoundaries[c + 1];
+		uint32_t	clusterMisses = 0;
+		uint32_t	runningMisses = 0;
+		uint32_t	softStart = start;
+		float		limit;
+
+		time += VERTEX_CACHE_SIZE + 1;
+		for (uint32_t t = start; t < end; t++) {
+			clusterMisses += updateCache(&indices[t * 3], timestamps, time);
+		}
+		limit = threshold * clusterMisses / (end - start);
+
+		time += VERTEX_CACHE_SIZE + 1;
+		for (uint32_t t = start; t < end; t++) {
+			runningMisses += updateCache(&indices[t * 3], timestamps, time);
+			if (t + 1 == end || static_cast<float>(runningMisses) / (t + 1 - softStart) <= limit) {
+				clusters.push_back({softStart, t + 1, 0.0f});
+				softStart = t + 1;
+				runningMisses = 0;
+				time += VERTEX_CACHE_SIZE + 1;
+			}
+		}
+	}
+
+	for (uint32_t t = 0; t < triangleCount; t++) {
+		const glm::vec3&	a = vertices[indices[t * 3]].pos;
+		const glm::vec3&	b = vertices[indices[t * 3 + 1]].pos;
+		const glm::vec3&	c = vertices[indices[t * 3 + 2]].pos;
+		float				area = glm::length(glm::cross(b - a, c - a));
+
+		meshCentroid += (a + b + c) * (area / 3.0f);
+		meshArea += area;
+	}
+	if (meshArea > 0.0f) {
+		meshCentroid /= meshArea;
+	}
+
+	// Clusters whose area weighted normal points away from the mesh
+	// centre are the likely occluders
+	for (TriangleCluster& cluster : clusters) {
+		glm::vec3	centroid(0.0f);
+		glm::vec3	normal(0.0f);
+		float		area = 0.0f;
+
+		for (uint32_t t = cluster.start; t < cluster.end; t++) {
+			const glm::vec3&	a = vertices[indices[t * 3]].pos;
+			const glm::vec3&	b = vertices[indices[t * 3 + 1]].pos;
+			const glm::vec3&	c = vertices[indices[t * 3 + 2]].pos;
+			glm::vec3			faceNormal = glm::cross(b - a, c - a);
+			float				faceArea = glm::length(faceNormal);
+
+			centroid += (a + b + c) * (faceArea / 3.0f);
+			normal += faceNormal;
+			area += faceArea;
+		}
+		if (area > 0.0f) {
+			centroid /= area;
+		}
+		if (glm::length(normal) > 0.0f) {
+			normal = glm::normalize(normal);
+		}
+		cluster.sortKey = glm::dot(centroid - meshCentroid, normal);
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const TriangleCluster& a, const TriangleCluster& b) {
+		return a.sortKey > b.sortKey;
+	});
+
+	result.reserve(indices.size());
+	for (const TriangleCluster& cluster : clusters) {
+		result.insert(result.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+	}
+	indices.swap(result);
+}
+
+void	optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	std::vector<uint32_t>	remap(vertices.size(), UINT32_MAX);
+	std::vector<Vertex>		reordered;
+
+	reordered.reserve(vertices.size());
+
+	for (uint32_t& index : indices) {
+		if (remap[index] == UINT32_MAX) {
+			remap[index] = static_cast<uint32_t>(reordered.size());
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	vertices.swap(reordered);
+}
+
+// Bounding sphere around the box of the vertices, and the narrowest cone
+// around the average normal that holds every triangle normal
+static void	computeMeshletBounds(Meshlet& meshlet, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+	glm::vec3				boundsMin = vertices[indices[meshlet.firstIndex]].pos;
+	glm::vec3				boundsMax = boundsMin;
+	glm::vec3				axis(0.0f);
+	float					minDot = 1.0f;
+	std::vector<glm::vec3>	normals;
+
+	normals.reserve(meshlet.indexCount / 3);
+
+	for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3) {
+		const glm::vec3&	a = vertices[indices[i]].pos;
+		const glm::vec3&	b = vertices[indices[i + 1]].pos;
+		const glm::vec3&	c = vertices[indices[i + 2]].pos;
+		glm::vec3			normal = glm::cross(b - a, c - a);
+
+		boundsMin = glm::min(boundsMin, glm::min(a, glm::min(b, c)));
+		boundsMax = glm::max(boundsMax, glm::max(a, glm::max(b, c)));
+
+		// Degenerate triangles are never rasterized, so they don't widen the cone
+		if (glm::length(normal) > 0.0f) {
+			normals.push_back(glm::normalize(normal));
+			axis += normals.back();
+		}
+	}
+
+	meshlet.center = (boundsMin + boundsMax) * 0.5f;
+	meshlet.radius = 0.0f;
+	for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i++) {
+		meshlet.radius = std::max(meshlet.radius, glm::length(vertices[indices[i]].pos - meshlet.center));
+	}
+
+	meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	meshlet.coneCutoff = 1.0f;
+	if (normals.empty() || glm::length(axis) == 0.0f) {
+		return;
+	}
+
+	axis = glm::normalize(axis);
+	for (const glm::vec3& normal : normals) {
+		minDot = std::min(minDot, glm::dot(axis, normal));
+	}
+
+	// Normals spread close to a hemisphere leave no back facing region
+	// worth testing
+	meshlet.coneAxis = axis;
+	if (minDot > 0.1f) {
+		meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+}
+
+std::vector<Meshlet>	buildMeshlets(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+	std::vector<Meshlet>	meshlets;
+	std::vector<uint32_t>	owner(vertices.size(), UINT32_MAX);
+	Meshlet					current{};
+
+	for (uint32_t i = 0; i + 2 < indices.size(); i += 3) {
+		const uint32_t*	triangle = &indices[i];
+		uint32_t		id = static_cast<uint32_t>(meshlets.size());
+		uint32_t		newVertices = 0;
+
+		for (int k = 0; k < 3; k++) {
+			bool	repeated = (k > 0 && triangle[k] == triangle[0]) || (k > 1 && triangle[k] == triangle[1]);
+
+			if (owner[triangle[k]] != id && !repeated) {
+				newVertices++;
+			}
+		}
+
+		if (current.indexCount > 0 && (current.vertexCount + newVertices > MESHLET_MAX_VERTICES
+				|| current.indexCount / 3 == MESHLET_MAX_TRIANGLES)) {
+			meshlets.push_back(current);
+			current = Meshlet{};
+			current.firstIndex = i;
+			id++;
+			newVertices = 3 - (triangle[1] == triangle[0]) - (triangle[2] == triangle[0] || triangle[2] == triangle[1]);
+		}
+
+		for (int k = 0; k < 3; k++) {
+			owner[triangle[k]] = id;
+		}
+		current.vertexCount += newVertices;
+		current.indexCount += 3;
+	}
+	if (current.indexCount > 0) {
+		meshlets.push_back(current);
+	}
+
+	for (Meshlet& meshlet : meshlets) {
+		computeMeshletBounds(meshlet, vertices, indices);
+	}
+	return meshlets;
+}
+
+// Sum of squared distances to a set of planes, each weighted by the area
+// of the triangle it came from
+struct	Quadric {
+	double	xx = 0.0, xy = 0.0, xz = 0.0, xw = 0.0;
+	double	yy = 0.0, yz = 0.0, yw = 0.0;
+	double	zz = 0.0, zw = 0.0;
+	double	ww = 0.0;
+	double	weight = 0.0;
+
+	void	add(const Quadric& other) {
+		xx += other.xx; xy += other.xy; xz += other.xz; xw += other.xw;
+		yy += other.yy; yz += other.yz; yw += other.yw;
+		zz += other.zz; zw += other.zw;
+		ww += other.ww;
+		weight += other.weight;
+	}
+
+	double	evaluate(const glm::vec3& p) const {
+		double	x = p.x, y = p.y, z = p.z;
+
+		return xx * x * x + 2.0 * xy * x * y + 2.0 * xz * x * z + 2.0 * xw * x
+			+ yy * y * y + 2.0 * yz * y * z + 2.0 * yw * y
+			+ zz * z * z + 2.0 * zw * z
+			+ ww;
+	}
+};
+
+static Quadric	planeQuadric(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+	glm::vec3	normal = glm::cross(b - a, c - a);
+	float		length = glm::length(normal);
+	Quadric		q;
+
+	if (length == 0.0f) {
+		return q;
+	}
+
+	normal /= length;
+	double	x = normal.x, y = normal.y, z = normal.z;
+	double	d = -glm::dot(normal, a);
+	double	w = length * 0.5;
+
+	q.xx = w * x * x; q.xy = w * x * y; q.xz = w * x * z; q.xw = w * x * d;
+	q.yy = w * y * y; q.yz = w * y * z; q.yw = w * y * d;
+	q.zz = w * z * z; q.zw = w * z * d;
+	q.ww = w * d * d;
+	q.weight = w;
+	return q;
+}
+
+static bool	samePosition(const Vertex& a, const Vertex& b) {
+	return a.pos.x == b.pos.x && a.pos.y == b.pos.y && a.pos.z == b.pos.z;
+}
+
+static bool	lessPosition(const Vertex& a, const Vertex& b) {
+	if (a.pos.x != b.pos.x) {
+		return a.pos.x < b.pos.x;
+	}
+	if (a.pos.y != b.pos.y) {
+		return a.pos.y < b.pos.y;
+	}
+	return a.pos.z < b.pos.z;
+}
+
+// Whether moving vertex from onto to turns any of from's other triangles over
+static bool	collapseFlips(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+		const uint32_t* triangles, uint32_t triangleCount, uint32_t from, uint32_t to) {
+	for (uint32_t i = 0; i < triangleCount; i++) {
+		const uint32_t*	triangle = &indices[triangles[i] * 3];
+		glm::vec3		p[3];
+		glm::vec3		moved[3];
+
+		if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+			continue;
+		}
+		for (int k = 0; k < 3; k++) {
+			p[k] = vertices[triangle[k]].pos;
+			moved[k] = triangle[k] == from ? vertices[to].pos : p[k];
+		}
+		if (glm::dot(glm::cross(p[1] - p[0], p[2] - p[0]), glm::cross(moved[1] - moved[0], moved[2] - moved[0])) <= 0.0f) {
+			return true;
+		}
+	}
+	return false;
+}
+
+std::vector<uint32_t>	simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float& error) {
+	struct	Collapse {
+		uint32_t	from;
+		uint32_t	to;
+		double		cost;
+	};
+
+	uint32_t				vertexCount = static_cast<uint32_t>(vertices.size());
+	std::vector<uint32_t>	result(indices.begin(), indices.begin() + indices.size() / 3 * 3);
+	std::vector<uint32_t>	byPosition(vertexCount);
+	std::vector<uint32_t>	canonical(vertexCount);
+	std::vector<uint32_t>	copies(vertexCount, 0);
+	std::vector<bool>		locked(vertexCount, false);
+	std::vector<Quadric>	quadrics(vertexCount);
+
+	error = 0.0f;
+
+	// Vertices sharing a position but not attributes sit on a seam; only
+	// the first of each group counts as the position's vertex
+	for (uint32_t i = 0; i < vertexCount; i++) {
+		byPosition[i] = i;
+	}
+	std::sort(byPosition.begin(), byPosition.end(), [&](uint32_t a, uint32_t b) {
+		return lessPosition(vertices[a], vertices[b]);
+	});
+	for (uint32_t i = 0; i < vertexCount; i++) {
+		uint32_t	vertex = byPosition[i];
+
+		if (i > 0 && samePosition(vertices[vertex], vertices[byPosition[i - 1]])) {
+			canonical[vertex] = canonical[byPosition[i - 1]];
+		} else {
+			canonical[vertex] = vertex;
+		}
+		copies[canonical[vertex]]++;
+	}
+
+	// Edges without exactly two triangles, counted by position so seams
+	// don't read as borders, pin both of their ends
+	std::unordered_map<uint64_t, uint32_t>	edges;
+
+	for (size_t i = 0; i < result.size(); i += 3) {
+		for (int k = 0; k < 3; k++) {
+			uint32_t	a = canonical[result[i + k]];
+			uint32_t	b = canonical[result[i + (k + 1) % 3]];
+
+			edges[static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b)]++;
+		}
+		Quadric	q = planeQuadric(vertices[result[i]].pos, vertices[result[i + 1]].pos, vertices[result[i + 2]].pos);
+
+		for (int k = 0; k < 3; k++) {
+			quadrics[result[i + k]].add(q);
+		}
+	}
+	for (const auto& [edge, count] : edges) {
+		if (count != 2) {
+			locked[static_cast<uint32_t>(edge >> 32)] = true;
+			locked[static_cast<uint32_t>(edge)] = true;
+		}
+	}
+
+	// A vertex may move if its position is its own and isn't pinned; it may
+	// be moved onto if its position is its own, so no seam loses a side
+	auto	movable = [&](uint32_t vertex) {
+		return copies[canonical[vertex]] == 1 && !locked[canonical[vertex]];
+	};
+	auto	target = [&](uint32_t vertex) {
+		return copies[canonical[vertex]] == 1;
+	};
+
+	// Each pass takes the cheapest collapses that don't touch each other's
+	// neighbourhoods, then rebuilds the triangle list
+	while (result.size() > targetIndexCount) {
+		uint32_t				triangleCount = static_cast<uint32_t>(result.size() / 3);
+		std::vector<uint32_t>	offsets(vertexCount + 1, 0);
+		std::vector<uint32_t>	adjacency(result.size());
+		std::vector<Collapse>	collapses;
+		std::vector<uint32_t>	remap(vertexCount);
+		std::vector<bool>		touched(vertexCount, false);
+		size_t					removable = (result.size() - targetIndexCount) / 3;
+		size_t					removed = 0;
+
+		for (uint32_t index : result) {
+			offsets[index + 1]++;
+		}
+		for (uint32_t i = 0; i < vertexCount; i++) {
+			offsets[i + 1] += offsets[i];
+			remap[i] = i;
+		}
+		std::vector<uint32_t>	fill(offsets.begin(), offsets.end() - 1);
+
+		for (uint32_t t = 0; t < triangleCount; t++) {
+			for (int k = 0; k < 3; k++) {
+				adjacency[fill[result[t * 3 + k]]++] = t;
+			}
+		}
+
+		for (uint32_t t = 0; t < triangleCount; t++) {
+			for (int k = 0; k < 3; k++) {
+				uint32_t	a = result[t * 3 + k];
+				uint32_t	b = result[t * 3 + (k + 1) % 3];
+
+				for (int direction = 0; direction < 2; direction++) {
+					if (movable(a) && target(b)) {
+						Quadric	q = quadrics[a];
+
+						q.add(quadrics[b]);
+						collapses.push_back({a, b, std::max(q.evaluate(vertices[b].pos), 0.0)});
+					}
+					std::swap(a, b);
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+			return a.cost < b.cost;
+		});
+
+		for (const Collapse& collapse : collapses) {
+			const uint32_t*	triangles = &adjacency[offsets[collapse.from]];
+			uint32_t		count = offsets[collapse.from + 1] - offsets[collapse.from];
+			size_t			shared = 0;
+
+			if (removed >= removable) {
+				break;
+			}
+			if (touched[collapse.from] || touched[collapse.to]
+					|| collapseFlips(vertices, result, triangles, count, collapse.from, collapse.to)) {
+				continue;
+			}
+
+			for (uint32_t i = 0; i < count; i++) {
+				const uint32_t*	triangle = &result[triangles[i] * 3];
+
+				for (int k = 0; k < 3; k++) {
+					touched[triangle[k]] = true;
+					shared += triangle[k] == collapse.to;
+				}
+			}
+			remap[collapse.from] = collapse.to;
+			removed += shared;
+
+			double	weight = quadrics[collapse.from].weight + quadrics[collapse.to].weight;
+
+			if (weight > 0.0) {
+				error = std::max(error, static_cast<float>(std::sqrt(collapse.cost / weight)));
+			}
+			quadrics[collapse.to].add(quadrics[collapse.from]);
+		}
+
+		if (removed == 0) {
+			break;
+		}
+
+		size_t	kept = 0;
+
+		for (size_t i = 0; i < result.size(); i += 3) {
+			uint32_t	a = remap[result[i]];
+			uint32_t	b = remap[result[i + 1]];
+			uint32_t	c = remap[result[i + 2]];
+
+			if (a != b && b != c && a != c) {
+				result[kept++] = a;
+				result[kept++] = b;
+				result[kept++] = c;
+			}
+		}
+		result.resize(kept);
+	}
+	return result;
+}
+
+std::vector<MeshLod>	buildLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	// Levels below this many triangles, or that fail to drop a sixth of
+	// their parent's, aren't worth a draw of their own
+	const size_t	minTriangles = 16;
+	const double	minReduction = 5.0 / 6.0;
+
+	std::vector<MeshLod>	lods;
+	std::vector<uint32_t>	parent(indices);
+	float					error = 0.0f;
+
+	lods.push_back({0, static_cast<uint32_t>(indices.size()), 0.0f, 0});
+
+	while (lods.size() < MAX_MESH_LODS) {
+		size_t	target = parent.size() / 6 * 3;
+		float	levelError = 0.0f;
+
+		if (target < minTriangles * 3) {
+			break;
+		}
+
+		std::vector<uint32_t>	level = simplifyMesh(vertices, parent, target, levelError);
+
+		if (level.empty() || level.size() > parent.size() * minReduction) {
+			break;
+		}
+		optimizeVertexCache(level, static_cast<uint32_t>(vertices.size()));
+
+		error += levelError;
+		lods.push_back({static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(level.size()), error, 0});
+		indices.insert(indices.end(), level.begin(), level.end());
+		parent.swap(level);
+	}
+	return lods;
+}
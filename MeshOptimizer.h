@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Vertex.h"
+
+#include <cstdint>
+#include <vector>
+
+// Size of the FIFO post-transform cache the statistics are simulated with
+const uint32_t	VERTEX_CACHE_SIZE = 16;
+
+// ACMR is transformed vertices per triangle (0.5 is ideal on regular
+// grids, 3 is no reuse at all); ATVR is transformed vertices per unique
+// vertex (1 is ideal)
+struct	VertexCacheStats {
+	uint32_t	triangles = 0;
+	uint32_t	vertices = 0;
+	float		acmr = 0.0f;
+	float		atvr = 0.0f;
+};
+
+VertexCacheStats	analyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Builds an indexed mesh from a triangle list of unindexed vertices,
+// merging bitwise identical ones
+void	deduplicateVertices(const std::vector<Vertex>& corners, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// Reorders triangles for the post-transform cache (Forsyth's linear
+// speed algorithm)
+void	optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount);
+
+// Splits the cache optimized order into clusters at cache restarts and
+// draws outward facing clusters first, so they occlude the rest (Sander,
+// Nehab and Barczak). threshold bounds the ACMR a split may cost.
+void	optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+
+// Renumbers vertices in order of first use so fetches walk memory
+// forwards; unreferenced vertices are dropped
+void	optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// Meshlet size limits, the ones mesh shading hardware favours
+const uint32_t	MESHLET_MAX_VERTICES = 64;
+const uint32_t	MESHLET_MAX_TRIANGLES = 124;
+
+// A contiguous range of a mesh's index list with the bounds of its
+// triangles. The sphere is used for frustum culling; every triangle is
+// back facing from a camera at p when
+// dot(center - p, coneAxis) >= coneCutoff * length(center - p) + radius * (1 + coneCutoff).
+// A cutoff of 1 never culls. Laid out to match the std430 struct in
+// cull.comp.
+struct	Meshlet {
+	glm::vec3	center;
+	float		radius;
+	glm::vec3	coneAxis;
+	float		coneCutoff;
+	uint32_t	firstIndex;
+	uint32_t	indexCount;
+	uint32_t	vertexCount;
+	uint32_t	padding;
+};
+
+// Splits the index list, in its current order, into meshlets; run after
+// the reordering passes, which keep neighbouring triangles together
+std::vector<Meshlet>	buildMeshlets(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+// Most levels of detail a mesh keeps, the full detail one included
+const uint32_t	MAX_MESH_LODS = 8;
+
+// One level of detail: a range of the mesh's index list, drawn against
+// the same vertices as every other level, and the simplifier's error in
+// mesh units. Laid out to match the std430 struct in cull.comp.
+struct	MeshLod {
+	uint32_t	firstIndex;
+	uint32_t	indexCount;
+	float		error;
+	uint32_t	padding;
+};
+
+// Collapses edges onto existing vertices by lowest quadric error
+// (Garland and Heckbert) until at most targetIndexCount indices are left
+// or no collapse is possible. Border and attribute seam vertices are kept
+// in place and collapses that flip a triangle are refused. error is the
+// largest collapse error, an RMS distance in mesh units.
+std::vector<uint32_t>	simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float& error);
+
+// Appends up to MAX_MESH_LODS - 1 simplified levels, each about half the
+// triangles of the last, to the index list and returns every level; the
+// first is the list as it was. Levels are cache optimized and their
+// errors accumulate, so a level is never rated better than its parent.
+std::vector<MeshLod>	buildLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
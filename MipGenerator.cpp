@@ -0,0 +1,321 @@
+#include "MipGenerator.h"
+#include <stdexcept>
+#include <algorithm>
+#include <array>
+
+uint32_t	MipGenerator::mipLevelsFor(uint32_t width, uint32_t height) {
+	uint32_t	levels = 1;
+
+	for (uint32_t size = std::max(width, height); size > 1; size /= 2) {
+		levels++;
+	}
+	return levels;
+}
+
+bool	MipGenerator::supportsBlit(VkPhysicalDevice physicalDevice, VkFormat format) {
+	VkFormatProperties	properties;
+	VkFormatFeatureFlags	required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT
+		| VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+
+	return (properties.optimalTilingFeatures & required) == required;
+}
+
+// Storage views only exist for UNORM formats, sRGB data is converted in
+// the shader instead
+static VkFormat	storageFormatFor(VkFormat format) {
+	switch (format) {
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_R8G8B8A8_UNORM:
+			return VK_FORMAT_R8G8B8A8_UNORM;
+		default:
+			return VK_FORMAT_UNDEFINED;
+	}
+}
+
+void	MipGenerator::init(VkPhysicalDevice physicalDevice, VkDevice device, DeletionQueue& deletionQueue, VkPipelineCache pipelineCache, VkShaderModule computeShader) {
+	std::array<VkDescriptorSetLayoutBinding, 2>	bindings{};
+	VkDescriptorSetLayoutCreateInfo				layoutInfo{};
+	VkPushConstantRange							pushConstantRange{};
+	VkPipelineLayoutCreateInfo					pipelineLayoutInfo{};
+	VkComputePipelineCreateInfo					pipelineInfo{};
+	VkDescriptorSetLayout						setLayout;
+
+	this->physicalDevice = physicalDevice;
+	this->device = device;
+	this->deletionQueue = &deletionQueue;
+
+	if (computeShader == VK_NULL_HANDLE) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, descriptorSetLayout.replace(device)) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create mip descriptor set layout!");
+	}
+	setLayout = descriptorSetLayout;
+
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.size = sizeof(MipConstants);
+
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, pipelineLayout.replace(device)) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create mip pipeline layout!");
+	}
+
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = computeShader;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = pipelineLayout;
+
+	if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, pipeline.replace(device)) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create mip pipeline!");
+	}
+}
+
+void	MipGenerator::destroy(void) {
+	pipeline.reset();
+	pipelineLayout.reset();
+	descriptorSetLayout.reset();
+}
+
+VkImageCreateFlags	MipGenerator::getImageFlags(VkFormat format) const {
+	if (supportsBlit(physicalDevice, format) || storageFormatFor(format) == format) {
+		return 0;
+	}
+	return VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT;
+}
+
+VkImageUsageFlags	MipGenerator::getImageUsage(VkFormat format) const {
+	if (supportsBlit(physicalDevice, format)) {
+		return VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
+	return VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+}
+
+// Expects every level in TRANSFER_DST_OPTIMAL with level 0 written, and
+// leaves every level in SHADER_READ_ONLY_OPTIMAL
+void	MipGenerator::generate(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, TimelinePoint lastUse) {
+	if (supportsBlit(physicalDevice, format)) {
+		generateWithBlit(commandBuffer, image, width, height, mipLevels);
+	} else if (pipeline != VK_NULL_HANDLE && storageFormatFor(format) != VK_FORMAT_UNDEFINED) {
+		generateWithCompute(commandBuffer, image, format, width, height, mipLevels, lastUse);
+	} else {
+		throw std::runtime_error("no mip generation path for texture format!");
+	}
+}
+
+void	MipGenerator::generateWithBlit(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels) {
+	VkImageMemoryBarrier	barrier{};
+	int32_t					mipWidth = static_cast<int32_t>(width);
+	int32_t					mipHeight = static_cast<int32_t>(height);
+
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.image = image;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.subresourceRange.levelCount = 1;
+
+	for (uint32_t i = 1; i < mipLevels; i++) {
+		VkImageBlit	blit{};
+
+		barrier.subresourceRange.baseMipLevel = i - 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		blit.srcOffsets[0] = {0, 0, 0};
+		blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = i - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = 1;
+
+		mipWidth = std::max(mipWidth / 2, 1);
+		mipHeight = std::max(mipHeight / 2, 1);
+
+		blit.dstOffsets[0] = {0, 0, 0};
+		blit.dstOffsets[1] = {mipWidth, mipHeight, 1};
+		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.mipLevel = i;
+		blit.dstSubresource.baseArrayLayer = 0;
+		blit.dstSubresource.layerCount = 1;
+
+		vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	// The last level is only ever written
+	barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+UniqueImageView	MipGenerator::createLevelView(VkImage image, VkFormat format, uint32_t level) {
+	VkImageViewCreateInfo	createInfo{};
+	UniqueImageView			view;
+
+	createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	createInfo.image = image;
+	createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	createInfo.format = format;
+	createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	createInfo.subresourceRange.baseMipLevel = level;
+	createInfo.subresourceRange.levelCount = 1;
+	createInfo.subresourceRange.baseArrayLayer = 0;
+	createInfo.subresourceRange.layerCount = 1;
+
+	if (vkCreateImageView(device, &createInfo, nullptr, view.replace(device)) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create mip level view!");
+	}
+
+	return view;
+}
+
+void	MipGenerator::generateWithCompute(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, TimelinePoint lastUse) {
+	VkFormat						storageFormat = storageFormatFor(format);
+	VkDescriptorPoolSize			poolSize{};
+	VkDescriptorPoolCreateInfo		poolInfo{};
+	UniqueDescriptorPool			pool;
+	std::vector<VkDescriptorSetLayout>	layouts(mipLevels - 1, descriptorSetLayout);
+	std::vector<VkDescriptorSet>	sets(mipLevels - 1);
+	VkDescriptorSetAllocateInfo		allocInfo{};
+	VkImageMemoryBarrier			barrier{};
+	std::vector<UniqueImageView>	levelViews;
+	MipConstants					constants{};
+
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSize.descriptorCount = 2 * std::max(mipLevels - 1, 1u);
+
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = std::max(mipLevels - 1, 1u);
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, pool.replace(device)) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create mip descriptor pool!");
+	}
+
+	for (uint32_t level = 0; level < mipLevels; level++) {
+		levelViews.push_back(createLevelView(image, storageFormat, level));
+	}
+
+	if (mipLevels > 1) {
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = pool;
+		allocInfo.descriptorSetCount = mipLevels - 1;
+		allocInfo.pSetLayouts = layouts.data();
+
+		if (vkAllocateDescriptorSets(device, &allocInfo, sets.data()) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate mip descriptor sets!");
+		}
+	}
+
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.image = image;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = mipLevels;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+	constants.srgb = (format != storageFormat) ? 1 : 0;
+	constants.dstSize[0] = static_cast<int32_t>(width);
+	constants.dstSize[1] = static_cast<int32_t>(height);
+
+	for (uint32_t level = 1; level < mipLevels; level++) {
+		std::array<VkDescriptorImageInfo, 2>	imageInfos{};
+		std::array<VkWriteDescriptorSet, 2>		writes{};
+
+		for (uint32_t i = 0; i < 2; i++) {
+			imageInfos[i].imageView = levelViews[level - 1 + i];
+			imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = sets[level - 1];
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			writes[i].pImageInfo = &imageInfos[i];
+		}
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+		constants.srcSize[0] = constants.dstSize[0];
+		constants.srcSize[1] = constants.dstSize[1];
+		constants.dstSize[0] = std::max(constants.dstSize[0] / 2, 1);
+		constants.dstSize[1] = std::max(constants.dstSize[1] / 2, 1);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &sets[level - 1], 0, nullptr);
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+		vkCmdDispatch(commandBuffer, (constants.dstSize[0] + 7) / 8, (constants.dstSize[1] + 7) / 8, 1);
+
+		// The level just written is the source of the next dispatch
+		barrier.subresourceRange.baseMipLevel = level;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = mipLevels;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	// The recorded dispatches reference the views and sets until the
+	// submission that executes them completes
+	for (UniqueImageView& view : levelViews) {
+		deletionQueue->retire(std::move(view), lastUse);
+	}
+	deletionQueue->retire(std::move(pool), lastUse);
+}
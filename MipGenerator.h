@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "DeletionQueue.h"
+#include "DeviceHandle.h"
+
+#include <vector>
+
+// Fills the mip chain of a texture from its base level on a graphics
+// queue. Formats that support linear blits are downsampled with
+// vkCmdBlitImage; anything else falls back to a box filter compute shader,
+// which needs the image created with getImageFlags/getImageUsage.
+class	MipGenerator
+{
+	public:
+		static uint32_t	mipLevelsFor(uint32_t width, uint32_t height);
+
+		static bool	supportsBlit(VkPhysicalDevice physicalDevice, VkFormat format);
+
+		void	init(VkPhysicalDevice physicalDevice, VkDevice device, DeletionQueue& deletionQueue, VkPipelineCache pipelineCache, VkShaderModule computeShader);
+
+		void	destroy(void);
+
+		VkImageCreateFlags	getImageFlags(VkFormat format) const;
+
+		VkImageUsageFlags	getImageUsage(VkFormat format) const;
+
+		// lastUse is the submission that executes commandBuffer; compute
+		// generation retires its views and descriptor pool there
+		void	generate(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, TimelinePoint lastUse);
+
+	private:
+		struct	MipConstants {
+			int32_t		srcSize[2];
+			int32_t		dstSize[2];
+			uint32_t	srgb;
+		};
+
+		VkPhysicalDevice			physicalDevice = VK_NULL_HANDLE;
+		VkDevice					device = VK_NULL_HANDLE;
+		DeletionQueue*				deletionQueue = nullptr;
+		UniqueDescriptorSetLayout	descriptorSetLayout;
+		UniquePipelineLayout		pipelineLayout;
+		UniquePipeline				pipeline;
+
+		void	generateWithBlit(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels);
+
+		void	generateWithCompute(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, TimelinePoint lastUse);
+
+		UniqueImageView	createLevelView(VkImage image, VkFormat format, uint32_t level);
+};
@@ -0,0 +1,184 @@
+#include "Options.h"
+#include <stdexcept>
+#include <string>
+#include <iostream>
+#include <cstdlib>
+#include <thread>
+#include <algorithm>
+
+static uint32_t	parseCount(const std::string& name, const char* value) {
+	size_t			end = 0;
+	unsigned long	count;
+
+	if (value == nullptr) {
+		throw std::runtime_error("missing value for " + name);
+	}
+
+	try {
+		count = std::stoul(value, &end);
+	} catch (const std::exception&) {
+		end = 0;
+	}
+
+	if (end == 0 || value[end] != '\0' || count > UINT32_MAX) {
+		throw std::runtime_error("invalid value for " + name + ": " + value);
+	}
+
+	return static_cast<uint32_t>(count);
+}
+
+static float	parseFloat(const std::string& name, const char* value) {
+	size_t	end = 0;
+	float	number;
+
+	if (value == nullptr) {
+		throw std::runtime_error("missing value for " + name);
+	}
+
+	try {
+		number = std::stof(value, &end);
+	} catch (const std::exception&) {
+		end = 0;
+	}
+
+	if (end == 0 || value[end] != '\0' || !(number >= 0.0f)) {
+		throw std::runtime_error("invalid value for " + name + ": " + value);
+	}
+
+	return number;
+}
+
+static FrameProfile	parseFrameProfile(const std::string& name, const char* value) {
+	std::string	profile;
+
+	if (value == nullptr) {
+		throw std::runtime_error("missing value for " + name);
+	}
+
+	profile = value;
+	if (profile == "low") {
+		return FrameProfile::LowLatency;
+	} else if (profile == "balanced") {
+		return FrameProfile::Balanced;
+	} else if (profile == "throughput") {
+		return FrameProfile::Throughput;
+	}
+	throw std::runtime_error("invalid value for " + name + ": " + value);
+}
+
+static void	printUsage(const char* name) {
+	std::cout << "usage: " << name << " [options]\n"
+		<< "  --workers N        job system worker threads (default: one per extra core)\n"
+		<< "  --threads N        record draws as N parallel jobs (0 records inline)\n"
+		<< "  --draws N          number of textured quads in the scene\n"
+		<< "  --instanced        draw all quads with one instanced draw call\n"
+		<< "  --gpu-cull         frustum cull on the GPU and draw with indirect commands\n"
+		<< "  --cull-meshlets    with --gpu-cull, cull and draw each meshlet of each object\n"
+		<< "  --lod-error PX     screen space error a level of detail may show (default 1, 0 disables)\n"
+		<< "  --latency MODE     low, balanced or throughput frames in flight and present mode (default balanced,\n"
+		<< "                     keys 1 to 3 switch at runtime)\n"
+		<< "  --pace             with fifo present modes, delay each frame to just make the next refresh\n"
+		<< "  --bench-frames N   render N frames per configuration, report timings and exit\n"
+		<< "  --bench-mips       with --bench-frames, also compare sampling with and without mips\n"
+		<< "  --bench-lod        with --bench-frames, also compare instanced drawing with and without LOD\n"
+		<< "  --bench-latency    with --bench-frames, also compare the latency profiles\n"
+		<< "  --archive FILE     asset archive to load from before loose files (default assets.pak)\n"
+		<< "  --texture-cache DIR  where transcoded BCn textures are kept (default texture_cache)\n"
+		<< "  --texture-budget MIB  VRAM budget for streamed textures (default: driver budget or half the heap)\n"
+		<< "  --no-compressed-textures  upload textures as RGBA8 instead of BCn\n"
+		<< "  --mesh FILE        draw an OBJ, glTF or GLB mesh instead of the quad\n"
+		<< "  --mesh-cache DIR   where optimized meshes are kept (default mesh_cache)\n"
+		<< "  --bench-io FILE    compare readFile and MappedFile on FILE, cold and warm (repeatable)\n";
+}
+
+AppOptions	parseOptions(int argc, char** argv) {
+	AppOptions	options;
+
+	options.workerThreads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+	for (int i = 1; i < argc; i++) {
+		std::string	arg = argv[i];
+		const char*	value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+		if (arg == "--workers") {
+			options.workerThreads = parseCount(arg, value);
+			i++;
+		} else if (arg == "--threads") {
+			options.recordThreads = parseCount(arg, value);
+			i++;
+		} else if (arg == "--draws") {
+			options.drawCount = parseCount(arg, value);
+			i++;
+		} else if (arg == "--instanced") {
+			options.instanced = true;
+		} else if (arg == "--gpu-cull") {
+			options.gpuCulling = true;
+		} else if (arg == "--cull-meshlets") {
+			options.meshletCulling = true;
+		} else if (arg == "--bench-frames") {
+			options.benchFrames = parseCount(arg, value);
+			i++;
+		} else if (arg == "--lod-error") {
+			options.lodPixelError = parseFloat(arg, value);
+			i++;
+		} else if (arg == "--pace") {
+			options.pace = true;
+		} else if (arg == "--latency") {
+			options.frameProfile = parseFrameProfile(arg, value);
+			i++;
+		} else if (arg == "--bench-mips") {
+			options.benchMips = true;
+		} else if (arg == "--bench-lod") {
+			options.benchLod = true;
+		} else if (arg == "--bench-latency") {
+			options.benchLatency = true;
+		} else if (arg == "--archive") {
+			if (value == nullptr) {
+				throw std::runtime_error("missing value for " + arg);
+			}
+			options.archivePath = value;
+			i++;
+		} else if (arg == "--texture-cache") {
+			if (value == nullptr) {
+				throw std::runtime_error("missing value for " + arg);
+			}
+			options.textureCacheDir = value;
+			i++;
+		} else if (arg == "--texture-budget") {
+			options.textureBudgetMiB = parseCount(arg, value);
+			i++;
+		} else if (arg == "--no-compressed-textures") {
+			options.compressTextures = false;
+		} else if (arg == "--mesh") {
+			if (value == nullptr) {
+				throw std::runtime_error("missing value for " + arg);
+			}
+			options.meshPath = value;
+			i++;
+		} else if (arg == "--mesh-cache") {
+			if (value == nullptr) {
+				throw std::runtime_error("missing value for " + arg);
+			}
+			options.meshCacheDir = value;
+			i++;
+		} else if (arg == "--bench-io") {
+			if (value == nullptr) {
+				throw std::runtime_error("missing value for " + arg);
+			}
+			options.ioBenchFiles.push_back(value);
+			i++;
+		} else if (arg == "--help" || arg == "-h") {
+			printUsage(argv[0]);
+			std::exit(EXIT_SUCCESS);
+		} else {
+			printUsage(argv[0]);
+			throw std::runtime_error("unknown option " + arg);
+		}
+	}
+
+	if (options.drawCount == 0) {
+		throw std::runtime_error("--draws must be at least 1");
+	}
+
+	return options;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// How far the CPU may run ahead of the display: one frame in flight with a
+// tearing present mode, two with mailbox, or three with mailbox and an
+// extra swapchain image. See FRAME_PROFILES in HelloTriApp.h.
+enum class	FrameProfile {
+	LowLatency,
+	Balanced,
+	Throughput
+};
+
+// Command line switches, mostly used to size stress scenes and benchmarks
+struct	AppOptions {
+	uint32_t	workerThreads = 0;
+	uint32_t	recordThreads = 0;
+	uint32_t	drawCount = 1;
+	uint32_t	benchFrames = 0;
+	bool		benchMips = false;
+	bool		benchLod = false;
+	bool		benchLatency = false;
+	bool		instanced = false;
+	bool		gpuCulling = false;
+	bool		meshletCulling = false;
+	bool		pace = false;
+	float		lodPixelError = 1.0f;
+	FrameProfile	frameProfile = FrameProfile::Balanced;
+
+	std::string					archivePath = "assets.pak";
+	std::string					textureCacheDir = "texture_cache";
+	bool						compressTextures = true;
+	uint32_t					textureBudgetMiB = 0;
+	std::string					meshPath;
+	std::string					meshCacheDir = "mesh_cache";
+	std::vector<std::string>	ioBenchFiles;
+};
+
+AppOptions	parseOptions(int argc, char** argv);
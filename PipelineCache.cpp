@@ -0,0 +1,156 @@
+#include "PipelineCache.h"
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+
+void	PipelineCache::init(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& path) {
+	VkPipelineCacheCreateInfo	createInfo{};
+	std::vector<char>			data;
+	std::ifstream				file(path, std::ios::ate | std::ios::binary);
+
+	this->device = device;
+	this->path = path;
+
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	if (file.is_open()) {
+		data.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(data.data(), data.size());
+		file.close();
+
+		if (!isCompatible(data)) {
+			std::cout << "Pipeline cache " << path << " does not match this device, starting cold" << std::endl;
+			data.clear();
+		}
+	}
+
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = data.size();
+	createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	if (vkCreatePipelineCache(device, &createInfo, nullptr, &cache) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create pipeline cache!");
+	}
+
+	warm = !data.empty();
+	if (warm) {
+		std::cout << "Loaded pipeline cache " << path << " (" << data.size() << " bytes)" << std::endl;
+	}
+}
+
+void	PipelineCache::destroy(void) {
+	std::lock_guard<std::mutex>	lock(mutex);
+
+	for (VkPipelineCache workerCache : workerCaches) {
+		vkDestroyPipelineCache(device, workerCache, nullptr);
+	}
+	workerCaches.clear();
+
+	vkDestroyPipelineCache(device, cache, nullptr);
+	cache = VK_NULL_HANDLE;
+}
+
+VkPipelineCache	PipelineCache::get(void) const {
+	return cache;
+}
+
+bool	PipelineCache::isWarm(void) const {
+	return warm;
+}
+
+// Header layout is fixed by the spec for VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+bool	PipelineCache::isCompatible(const std::vector<char>& data) {
+	uint32_t	headerSize;
+	uint32_t	headerVersion;
+	uint32_t	vendorID;
+	uint32_t	deviceID;
+
+	if (data.size() < 16 + VK_UUID_SIZE) {
+		return false;
+	}
+
+	memcpy(&headerSize, data.data(), 4);
+	memcpy(&headerVersion, data.data() + 4, 4);
+	memcpy(&vendorID, data.data() + 8, 4);
+	memcpy(&deviceID, data.data() + 12, 4);
+
+	return headerSize >= 16 + VK_UUID_SIZE
+		&& headerSize <= data.size()
+		&& headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+		&& vendorID == properties.vendorID
+		&& deviceID == properties.deviceID
+		&& memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+VkPipelineCache	PipelineCache::createWorkerCache(void) {
+	VkPipelineCacheCreateInfo	createInfo{};
+	VkPipelineCache				workerCache;
+
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+	if (vkCreatePipelineCache(device, &createInfo, nullptr, &workerCache) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create worker pipeline cache!");
+	}
+
+	std::lock_guard<std::mutex>	lock(mutex);
+	workerCaches.push_back(workerCache);
+
+	return workerCache;
+}
+
+// Worker caches must no longer be in use by their threads
+void	PipelineCache::mergeWorkerCaches(void) {
+	std::lock_guard<std::mutex>	lock(mutex);
+
+	if (workerCaches.empty()) {
+		return;
+	}
+
+	if (vkMergePipelineCaches(device, cache, static_cast<uint32_t>(workerCaches.size()), workerCaches.data()) != VK_SUCCESS) {
+		throw std::runtime_error("failed to merge pipeline caches!");
+	}
+
+	for (VkPipelineCache workerCache : workerCaches) {
+		vkDestroyPipelineCache(device, workerCache, nullptr);
+	}
+	workerCaches.clear();
+}
+
+// Written to a temporary file first so a crash mid-write never leaves a
+// truncated cache behind
+void	PipelineCache::save(void) {
+	size_t				size = 0;
+	std::vector<char>	data;
+	std::string			tmpPath = path + ".tmp";
+
+	mergeWorkerCaches();
+
+	if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS || size == 0) {
+		return;
+	}
+	data.resize(size);
+	if (vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS) {
+		return;
+	}
+
+	std::ofstream	file(tmpPath, std::ios::binary | std::ios::trunc);
+
+	if (!file.is_open()) {
+		std::cerr << "failed to write pipeline cache " << tmpPath << std::endl;
+		return;
+	}
+
+	file.write(data.data(), size);
+	file.close();
+
+	if (!file || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+		std::cerr << "failed to write pipeline cache " << path << std::endl;
+		std::remove(tmpPath.c_str());
+		return;
+	}
+
+	std::cout << "Saved pipeline cache " << path << " (" << size << " bytes)" << std::endl;
+}
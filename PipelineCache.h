@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+// VkPipelineCache backed by a file on disk. Data written by another driver
+// or GPU is rejected by comparing the cache header against the device, so a
+// stale file only costs a cold start. Threads building pipelines in
+// parallel get their own cache, merged back before the file is written.
+class	PipelineCache
+{
+	public:
+		void	init(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& path);
+
+		void	destroy(void);
+
+		VkPipelineCache	get(void) const;
+
+		bool	isWarm(void) const;
+
+		VkPipelineCache	createWorkerCache(void);
+
+		void	mergeWorkerCaches(void);
+
+		void	save(void);
+
+	private:
+		VkDevice						device = VK_NULL_HANDLE;
+		VkPhysicalDeviceProperties		properties{};
+		VkPipelineCache					cache = VK_NULL_HANDLE;
+		std::string						path;
+		bool							warm = false;
+
+		std::mutex						mutex;
+		std::vector<VkPipelineCache>	workerCaches;
+
+		bool	isCompatible(const std::vector<char>& data);
+};
@@ -0,0 +1,226 @@
+#include "PresentPacer.h"
+#include <stdexcept>
+#include <algorithm>
+
+static double	toMs(PresentPacer::Clock::duration duration) {
+	return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+bool	PresentPacer::isSupported(VkPhysicalDevice physicalDevice) {
+	VkPhysicalDevicePresentIdFeaturesKHR	presentIdFeatures{};
+	VkPhysicalDevicePresentWaitFeaturesKHR	presentWaitFeatures{};
+	VkPhysicalDeviceFeatures2				features{};
+
+	presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+	presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+	presentWaitFeatures.pNext = &presentIdFeatures;
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &presentWaitFeatures;
+
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+	return presentIdFeatures.presentId == VK_TRUE && presentWaitFeatures.presentWait == VK_TRUE;
+}
+
+void	PresentPacer::init(VkDevice device, bool presentWait) {
+	this->device = device;
+	enabled = presentWait;
+
+	if (!enabled) {
+		return;
+	}
+
+	waitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(device, "vkWaitForPresentKHR"));
+	if (waitForPresent == nullptr) {
+		throw std::runtime_error("failed to load vkWaitForPresentKHR!");
+	}
+
+	stopping = false;
+	waiter = std::thread(&PresentPacer::run, this);
+}
+
+void	PresentPacer::destroy(void) {
+	if (!enabled) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex>	lock(mutex);
+
+		stopping = true;
+		pending.clear();
+	}
+	condition.notify_all();
+	waiter.join();
+}
+
+bool	PresentPacer::isEnabled(void) const {
+	return enabled;
+}
+
+VkResult	PresentPacer::present(VkQueue queue, VkPresentInfoKHR& presentInfo, Clock::time_point inputTime) {
+	VkPresentIdKHR	presentId{};
+	uint64_t		id = nextId + 1;
+	VkResult		result;
+
+	if (!enabled) {
+		return vkQueuePresentKHR(queue, &presentInfo);
+	}
+
+	// Ids only have to grow per swapchain, so one counter serves them all
+	presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+	presentId.pNext = presentInfo.pNext;
+	presentId.swapchainCount = 1;
+	presentId.pPresentIds = &id;
+	presentInfo.pNext = &presentId;
+
+	result = vkQueuePresentKHR(queue, &presentInfo);
+	presentInfo.pNext = presentId.pNext;
+	nextId = id;
+
+	if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+		{
+			std::lock_guard<std::mutex>	lock(mutex);
+
+			pending.push_back(PendingPresent{presentInfo.pSwapchains[0], id, inputTime});
+		}
+		condition.notify_all();
+	}
+	return result;
+}
+
+void	PresentPacer::pace(double workMs) {
+	std::unique_lock<std::mutex>	lock(mutex);
+	double							workEstimate = 0.0;
+	Clock::time_point				start;
+
+	if (!enabled) {
+		return;
+	}
+
+	workHistory[workIndex++ % WORK_HISTORY] = workMs;
+	for (double work : workHistory) {
+		workEstimate = std::max(workEstimate, work);
+	}
+
+	// Missing a refresh costs a whole frame of latency, so the margin
+	// doubles on a miss and only creeps back
+	if (missedFrames > pacedMissed) {
+		marginMs = std::min(marginMs * 2.0, std::max(refreshMs * 0.5, MIN_MARGIN_MS));
+	} else {
+		marginMs = std::max(marginMs * 0.98, MIN_MARGIN_MS);
+	}
+	pacedMissed = missedFrames;
+
+	// Nothing is left queued once the last present is on screen, or was
+	// dropped by a drain
+	if (!condition.wait_for(lock, std::chrono::nanoseconds(WAIT_TIMEOUT_NS), [this]() { return pending.empty(); })
+			|| refreshMs == 0.0) {
+		return;
+	}
+
+	start = presentedTime + std::chrono::duration_cast<Clock::duration>(
+			std::chrono::duration<double, std::milli>(refreshMs - workEstimate - marginMs));
+	lock.unlock();
+
+	if (start > Clock::now()) {
+		std::this_thread::sleep_until(start);
+	}
+}
+
+// Presents are waited for in order, so the swapchain's are done once none
+// is pending and the waiter is past them
+void	PresentPacer::drain(VkSwapchainKHR swapchain) {
+	std::unique_lock<std::mutex>	lock(mutex);
+	auto							presented = [this, swapchain]() {
+		return waitingSwapchain != swapchain && std::none_of(pending.begin(), pending.end(), [swapchain](const PendingPresent& present) {
+			return present.swapchain == swapchain;
+		});
+	};
+
+	if (!enabled) {
+		return;
+	}
+
+	condition.wait_for(lock, std::chrono::nanoseconds(DRAIN_TIMEOUT_NS), presented);
+	pending.erase(std::remove_if(pending.begin(), pending.end(), [swapchain](const PendingPresent& present) {
+		return present.swapchain == swapchain;
+	}), pending.end());
+	condition.notify_all();
+	condition.wait(lock, [this, swapchain]() { return waitingSwapchain != swapchain; });
+}
+
+void	PresentPacer::collectLatency(uint32_t& frames, double& totalMs, uint32_t& missed) {
+	std::lock_guard<std::mutex>	lock(mutex);
+
+	frames = latencyFrames;
+	totalMs = latencyMs;
+	missed = static_cast<uint32_t>(missedFrames - collectedMissed);
+	latencyFrames = 0;
+	latencyMs = 0.0;
+	collectedMissed = missedFrames;
+}
+
+double	PresentPacer::getRefreshMs(void) const {
+	std::lock_guard<std::mutex>	lock(mutex);
+
+	return refreshMs;
+}
+
+// Presents are waited for in order, each one for at most WAIT_TIMEOUT_NS at
+// a time so a drain is noticed. The refresh interval follows consecutive
+// presents that land one refresh apart; a gap of more than one and a half
+// counts as a missed refresh.
+void	PresentPacer::run(void) {
+	std::unique_lock<std::mutex>	lock(mutex);
+
+	while (true) {
+		PendingPresent		present;
+		VkResult			result;
+		Clock::time_point	now;
+
+		condition.wait(lock, [this]() { return stopping || !pending.empty(); });
+		if (stopping) {
+			return;
+		}
+
+		present = pending.front();
+		waitingSwapchain = present.swapchain;
+		lock.unlock();
+
+		result = waitForPresent(device, present.swapchain, present.id, WAIT_TIMEOUT_NS);
+		now = Clock::now();
+
+		lock.lock();
+		waitingSwapchain = VK_NULL_HANDLE;
+		condition.notify_all();
+
+		if (pending.empty() || pending.front().id != present.id || result == VK_TIMEOUT) {
+			continue;
+		}
+		pending.pop_front();
+		condition.notify_all();
+
+		// Out of date swapchains are reported by the next present as well
+		if (result != VK_SUCCESS) {
+			continue;
+		}
+
+		if (presentedId != 0 && present.id == presentedId + 1 && toMs(now - presentedTime) >= MIN_REFRESH_MS) {
+			double	interval = toMs(now - presentedTime);
+
+			if (refreshMs == 0.0 || interval < refreshMs * 0.75) {
+				refreshMs = interval;
+			} else if (interval < refreshMs * 1.5) {
+				refreshMs = refreshMs * 0.9 + interval * 0.1;
+			} else {
+				missedFrames++;
+			}
+		}
+
+		presentedId = present.id;
+		presentedTime = now;
+		latencyFrames++;
+		latencyMs += toMs(now - present.inputTime);
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Presents through VK_KHR_present_id and waits for each present on a
+// thread of its own with VK_KHR_present_wait, which tells when a frame
+// reached the display. From that it measures input to present latency and
+// the refresh interval, and paces frames: pace() holds the next frame back
+// until the latest start that still makes the following refresh, so input
+// is sampled as late as the frame's work allows.
+//
+// Without present wait, present() only presents, and pace() and the
+// latency it would measure are left to the caller's fence based estimates.
+class	PresentPacer
+{
+	public:
+		using Clock = std::chrono::high_resolution_clock;
+
+		// Both features; the caller checks the extensions first
+		static bool	isSupported(VkPhysicalDevice physicalDevice);
+
+		void	init(VkDevice device, bool presentWait);
+
+		void	destroy(void);
+
+		bool	isEnabled(void) const;
+
+		// Tags the present with the next id when enabled; inputTime is when
+		// the frame sampled its input
+		VkResult	present(VkQueue queue, VkPresentInfoKHR& presentInfo, Clock::time_point inputTime);
+
+		// Waits for the last present to reach the display, then sleeps until
+		// workMs, the time the last frame took from input to completion,
+		// plus a margin fits before the next refresh. Misses grow the margin.
+		void	pace(double workMs);
+
+		// Waits for the presents queued to swapchain, before it is
+		// destroyed; those still pending after DRAIN_TIMEOUT_NS are dropped
+		void	drain(VkSwapchainKHR swapchain);
+
+		// Latency of the frames presented since the last call
+		void	collectLatency(uint32_t& frames, double& totalMs, uint32_t& missedFrames);
+
+		double	getRefreshMs(void) const;
+
+	private:
+		struct	PendingPresent {
+			VkSwapchainKHR		swapchain;
+			uint64_t			id;
+			Clock::time_point	inputTime;
+		};
+
+		// Waits are bounded so drain() and destroy() never block for long
+		static const uint64_t	WAIT_TIMEOUT_NS = 100000000;
+
+		// A hidden window may never show a present
+		static const uint64_t	DRAIN_TIMEOUT_NS = 1000000000;
+
+		static const uint32_t	WORK_HISTORY = 32;
+
+		// Presents observed closer together than this completed on the
+		// same refresh, as mailbox replacements do
+		static constexpr double	MIN_REFRESH_MS = 0.5;
+
+		// Slack kept before the refresh however steady the frames are
+		static constexpr double	MIN_MARGIN_MS = 0.5;
+
+		VkDevice				device = VK_NULL_HANDLE;
+		bool					enabled = false;
+		PFN_vkWaitForPresentKHR	waitForPresent = nullptr;
+		uint64_t				nextId = 0;
+
+		std::thread					waiter;
+		mutable std::mutex			mutex;
+		std::condition_variable		condition;
+		std::deque<PendingPresent>	pending;
+		VkSwapchainKHR				waitingSwapchain = VK_NULL_HANDLE;
+		bool						stopping = false;
+
+		// Guarded by mutex, written by the waiter
+		uint64_t			presentedId = 0;
+		Clock::time_point	presentedTime;
+		double				refreshMs = 0.0;
+		uint32_t			latencyFrames = 0;
+		double				latencyMs = 0.0;
+		uint64_t			missedFrames = 0;
+		uint64_t			collectedMissed = 0;
+
+		// Only touched by pace()
+		double				workHistory[WORK_HISTORY]{};
+		uint32_t			workIndex = 0;
+		double				marginMs = 1.0;
+		uint64_t			pacedMissed = 0;
+
+		void	run(void);
+};
@@ -0,0 +1,168 @@
+#include "TextureCache.h"
+#include "AssetArchive.h"
+#include "Ktx2.h"
+#define STB_DXT_IMPLEMENTATION
+#include <stb/stb_dxt.h>
+#include <stdexcept>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+void	TextureCache::init(const std::string& directory) {
+	this->directory = directory;
+
+	if (!directory.empty()) {
+		std::filesystem::create_directories(directory);
+	}
+}
+
+bool	TextureCache::isEnabled(void) const {
+	return !directory.empty();
+}
+
+uint64_t	TextureCache::hashSource(const char* data, size_t size) {
+	return fnv1a64(data, size) ^ (static_cast<uint64_t>(TEXTURE_CACHE_VERSION) << 56);
+}
+
+std::string	TextureCache::pathFor(uint64_t sourceHash) const {
+	std::ostringstream	path;
+
+	path << directory << "/" << std::hex << std::setw(16) << std::setfill('0') << sourceHash << ".ktx2";
+	return path.str();
+}
+
+bool	TextureCache::open(uint64_t sourceHash, MappedFile& file) const {
+	std::string	path = pathFor(sourceHash);
+
+	if (!isEnabled() || !std::filesystem::exists(path)) {
+		return false;
+	}
+
+	file = MappedFile(path, MapHint::Sequential);
+	return true;
+}
+
+// Written next to the final name and renamed over it, so concurrent
+// loaders and crashes never leave a partial file behind
+void	TextureCache::store(uint64_t sourceHash, const std::vector<char>& ktx) const {
+	std::string		path = pathFor(sourceHash);
+	std::ostringstream	tmpPath;
+
+	if (!isEnabled()) {
+		return;
+	}
+
+	tmpPath << path << "." << std::this_thread::get_id() << ".tmp";
+
+	std::ofstream	file(tmpPath.str(), std::ios::binary | std::ios::trunc);
+
+	file.write(ktx.data(), static_cast<std::streamsize>(ktx.size()));
+	file.close();
+	if (!file) {
+		std::filesystem::remove(tmpPath.str());
+		throw std::runtime_error("failed to write texture cache file " + tmpPath.str());
+	}
+
+	std::filesystem::rename(tmpPath.str(), path);
+}
+
+static const std::array<float, 256>&	srgbToLinearTable(void) {
+	static const std::array<float, 256>	table = []() {
+		std::array<float, 256>	values;
+
+		for (int i = 0; i < 256; i++) {
+			float	c = i / 255.0f;
+
+			values[i] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		return values;
+	}();
+
+	return table;
+}
+
+static unsigned char	linearToSrgb(float c) {
+	c = (c <= 0.0031308f) ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+	return static_cast<unsigned char>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// Box filter in linear space, alpha is averaged as is
+static std::vector<unsigned char>	downsample(const std::vector<unsigned char>& src, uint32_t width, uint32_t height) {
+	const std::array<float, 256>&	toLinear = srgbToLinearTable();
+	uint32_t						dstWidth = std::max(width / 2, 1u);
+	uint32_t						dstHeight = std::max(height / 2, 1u);
+	std::vector<unsigned char>		dst(static_cast<size_t>(dstWidth) * dstHeight * 4);
+
+	for (uint32_t y = 0; y < dstHeight; y++) {
+		for (uint32_t x = 0; x < dstWidth; x++) {
+			uint32_t	x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+			uint32_t	y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+			size_t		texels[4] = {
+				(static_cast<size_t>(y0) * width + x0) * 4, (static_cast<size_t>(y0) * width + x1) * 4,
+				(static_cast<size_t>(y1) * width + x0) * 4, (static_cast<size_t>(y1) * width + x1) * 4
+			};
+			unsigned char*	out = &dst[(static_cast<size_t>(y) * dstWidth + x) * 4];
+
+			for (int c = 0; c < 3; c++) {
+				float	sum = 0.0f;
+
+				for (size_t texel : texels) {
+					sum += toLinear[src[texel + c]];
+				}
+				out[c] = linearToSrgb(sum * 0.25f);
+			}
+			out[3] = static_cast<unsigned char>((src[texels[0] + 3] + src[texels[1] + 3] + src[texels[2] + 3] + src[texels[3] + 3] + 2) / 4);
+		}
+	}
+
+	return dst;
+}
+
+// Edge blocks of levels that aren't a multiple of 4 repeat the last texel
+static std::vector<unsigned char>	encodeLevel(const std::vector<unsigned char>& rgba, uint32_t width, uint32_t height, bool alpha) {
+	uint32_t					blocksX = (width + 3) / 4;
+	uint32_t					blocksY = (height + 3) / 4;
+	size_t						blockBytes = alpha ? 16 : 8;
+	std::vector<unsigned char>	blocks(blocksX * blocksY * blockBytes);
+	unsigned char				block[64];
+
+	for (uint32_t by = 0; by < blocksY; by++) {
+		for (uint32_t bx = 0; bx < blocksX; bx++) {
+			for (uint32_t i = 0; i < 16; i++) {
+				uint32_t	x = std::min(bx * 4 + i % 4, width - 1);
+				uint32_t	y = std::min(by * 4 + i / 4, height - 1);
+
+				memcpy(&block[i * 4], &rgba[(static_cast<size_t>(y) * width + x) * 4], 4);
+			}
+			stb_compress_dxt_block(&blocks[(by * blocksX + bx) * blockBytes], block, alpha ? 1 : 0, STB_DXT_HIGHQUAL);
+		}
+	}
+
+	return blocks;
+}
+
+std::vector<char>	TextureCache::transcode(const unsigned char* rgba, uint32_t width, uint32_t height) {
+	std::vector<unsigned char>				level(rgba, rgba + static_cast<size_t>(width) * height * 4);
+	std::vector<std::vector<unsigned char>>	encoded;
+	bool									alpha = false;
+
+	for (size_t i = 3; i < level.size() && !alpha; i += 4) {
+		alpha = level[i] != 255;
+	}
+
+	for (uint32_t w = width, h = height;; w = std::max(w / 2, 1u), h = std::max(h / 2, 1u)) {
+		encoded.push_back(encodeLevel(level, w, h, alpha));
+		if (w == 1 && h == 1) {
+			break;
+		}
+		level = downsample(level, w, h);
+	}
+
+	return writeKtx2(alpha ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC1_RGB_SRGB_BLOCK, width, height, encoded);
+}
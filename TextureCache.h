@@ -0,0 +1,38 @@
+#pragma once
+
+#include "readfile.h"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Bumped whenever the encoder output changes, so stale cache files are
+// never picked up again
+const uint32_t	TEXTURE_CACHE_VERSION = 1;
+
+// Block compressed copies of decoded images, stored as KTX2 files named
+// after a hash of the source bytes. Transcoding builds the mip chain on
+// the CPU and encodes every level to BC1, or BC3 when the image has
+// alpha, so a cache hit costs one mapping and no decode at all.
+class	TextureCache
+{
+	public:
+		void	init(const std::string& directory);
+
+		bool	isEnabled(void) const;
+
+		static uint64_t	hashSource(const char* data, size_t size);
+
+		bool	open(uint64_t sourceHash, MappedFile& file) const;
+
+		void	store(uint64_t sourceHash, const std::vector<char>& ktx) const;
+
+		static std::vector<char>	transcode(const unsigned char* rgba, uint32_t width, uint32_t height);
+
+	private:
+		std::string	directory;
+
+		std::string	pathFor(uint64_t sourceHash) const;
+};
@@ -0,0 +1,437 @@
+#include "TextureStreamer.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+// Textures start with the largest level that fits in this many texels
+const uint32_t	INITIAL_RESIDENT_SIZE = 64;
+
+void	TextureStreamer::init(VkPhysicalDevice physicalDevice, VkDevice device, GpuAllocator& allocator, Uploader& uploader,
+		GpuTimeline& timeline, DeletionQueue& deletionQueue, uint32_t consumerQueue, uint32_t framesInFlight, VkDeviceSize budget, bool useMemoryBudget) {
+	VkPhysicalDeviceMemoryProperties	memProperties;
+
+	this->physicalDevice = physicalDevice;
+	this->device = device;
+	this->allocator = &allocator;
+	this->uploader = &uploader;
+	this->timeline = &timeline;
+	this->deletionQueue = &deletionQueue;
+	this->consumerQueue = consumerQueue;
+	this->framesInFlight = framesInFlight;
+	this->useMemoryBudget = useMemoryBudget;
+	configuredBudget = budget;
+
+	// Without a budget from the user or the driver, textures may take half
+	// of the largest device local heap
+	if (configuredBudget == 0 && !useMemoryBudget) {
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+		for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++) {
+			if (memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+				configuredBudget = std::max(configuredBudget, memProperties.memoryHeaps[i].size / 2);
+			}
+		}
+	}
+
+	refreshBudget();
+}
+
+void	TextureStreamer::destroy(void) {
+	for (auto& texture : textures) {
+		destroyImage(texture.current);
+		destroyImage(texture.pending);
+	}
+	textures.clear();
+}
+
+// Levels are repacked back to back, largest first
+uint32_t	TextureStreamer::addTexture(const DecodedImage& image) {
+	StreamedTexture	texture;
+	uint32_t		levelCount = static_cast<uint32_t>(image.levels.size());
+	uint32_t		initialBase = levelCount - 1;
+	size_t			offset = 0;
+
+	texture.path = image.path;
+	texture.format = image.format;
+
+	for (const ImageLevel& level : image.levels) {
+		texture.levels.push_back({offset, level.size, level.width, level.height});
+		offset += level.size;
+	}
+
+	texture.data.resize(offset);
+	for (uint32_t i = 0; i < levelCount; i++) {
+		memcpy(texture.data.data() + texture.levels[i].offset, image.pixels + image.levels[i].offset, image.levels[i].size);
+	}
+
+	for (uint32_t i = 0; i < levelCount; i++) {
+		if (std::max(texture.levels[i].width, texture.levels[i].height) <= INITIAL_RESIDENT_SIZE) {
+			initialBase = i;
+			break;
+		}
+	}
+
+	texture.residency.levelCount = levelCount;
+	texture.residency.residentBase = levelCount;
+	texture.residency.requestedBase = initialBase;
+
+	textures.push_back(std::move(texture));
+	schedule(textures.back(), initialBase);
+
+	return static_cast<uint32_t>(textures.size() - 1);
+}
+
+void	TextureStreamer::requestLevel(uint32_t texture, uint32_t baseLevel, uint64_t frame) {
+	TextureResidency&	residency = textures[texture].residency;
+
+	residency.requestedBase = std::min(baseLevel, residency.levelCount - 1);
+	residency.lastUsedFrame = frame;
+}
+
+// Called once per frame, before the frame is recorded
+void	TextureStreamer::update(uint64_t frame) {
+	std::vector<StreamedTexture*>	byRecentUse;
+	VkDeviceSize					uploadBytes = 0;
+	bool							scheduled = false;
+
+	refreshBudget();
+
+	for (auto& texture : textures) {
+		if (texture.pending.image == VK_NULL_HANDLE || !uploader->isComplete(texture.pending.batchId)) {
+			continue;
+		}
+
+		if (texture.current.image != VK_NULL_HANDLE) {
+			if (texture.pending.baseLevel < texture.current.baseLevel) {
+				texture.residency.refinements++;
+			} else {
+				texture.residency.evictions++;
+			}
+			retire(texture.current);
+		}
+
+		texture.current = std::move(texture.pending);
+		texture.pending = ResidentImage{};
+		texture.residency.residentBase = texture.current.baseLevel;
+		texture.residency.residentBytes = texture.current.allocation.size;
+	}
+
+	while (projectedBytes() > budget && evictOne(frame, nullptr)) {
+		scheduled = true;
+	}
+
+	for (auto& texture : textures) {
+		byRecentUse.push_back(&texture);
+	}
+	std::stable_sort(byRecentUse.begin(), byRecentUse.end(), [](const StreamedTexture* a, const StreamedTexture* b) {
+		return a->residency.lastUsedFrame > b->residency.lastUsedFrame;
+	});
+
+	for (StreamedTexture* texture : byRecentUse) {
+		uint32_t		base = texture->current.baseLevel;
+		VkDeviceSize	bytes;
+
+		// Only textures that are still on screen are worth refining
+		if (texture->pending.image != VK_NULL_HANDLE || texture->current.image == VK_NULL_HANDLE
+				|| texture->residency.requestedBase >= base || texture->residency.lastUsedFrame + framesInFlight < frame) {
+			continue;
+		}
+
+		// Only the new top level is staged, the rest is copied
+		bytes = bytesFrom(*texture, base - 1);
+		if (uploadBytes > 0 && uploadBytes + texture->levels[base - 1].size > maxUploadBytes) {
+			break;
+		}
+
+		while (projectedBytes() - bytesFrom(*texture, base) + bytes > budget && evictOne(frame, texture)) {
+			scheduled = true;
+		}
+		if (projectedBytes() - bytesFrom(*texture, base) + bytes > budget) {
+			continue;
+		}
+
+		schedule(*texture, base - 1);
+		uploadBytes += texture->levels[base - 1].size;
+		scheduled = true;
+	}
+
+	if (scheduled) {
+		uploader->flush();
+	}
+}
+
+VkImageView	TextureStreamer::getView(uint32_t texture) const {
+	return textures[texture].current.view;
+}
+
+const TextureResidency&	TextureStreamer::getResidency(uint32_t texture) const {
+	return textures[texture].residency;
+}
+
+VkDeviceSize	TextureStreamer::getBudget(void) const {
+	return budget;
+}
+
+VkDeviceSize	TextureStreamer::getResidentBytes(void) const {
+	VkDeviceSize	bytes = retiredBytes;
+
+	for (const auto& texture : textures) {
+		bytes += texture.current.allocation.size + texture.pending.allocation.size;
+	}
+	return bytes;
+}
+
+void	TextureStreamer::printStats(std::ostream& out) const {
+	out << "Texture streaming: " << getResidentBytes() / 1024 << " KiB resident of a "
+		<< budget / 1024 << " KiB budget" << std::endl;
+
+	for (const auto& texture : textures) {
+		const TextureResidency&	residency = texture.residency;
+
+		out << "  " << texture.path << ": levels " << residency.residentBase << "-" << residency.levelCount - 1
+			<< " of " << residency.levelCount << " resident (requested " << residency.requestedBase << "), "
+			<< residency.residentBytes / 1024 << " KiB, last used frame " << residency.lastUsedFrame
+			<< ", " << residency.refinements << " refinements, " << residency.evictions << " evictions" << std::endl;
+	}
+}
+
+VkDeviceSize	TextureStreamer::bytesFrom(const StreamedTexture& texture, uint32_t baseLevel) const {
+	VkDeviceSize	bytes = 0;
+
+	for (uint32_t i = baseLevel; i < texture.levels.size(); i++) {
+		bytes += texture.levels[i].size;
+	}
+	return bytes;
+}
+
+// Memory the textures will hold once every scheduled change has landed
+VkDeviceSize	TextureStreamer::projectedBytes(void) const {
+	VkDeviceSize	bytes = 0;
+
+	for (const auto& texture : textures) {
+		if (texture.pending.image != VK_NULL_HANDLE) {
+			bytes += bytesFrom(texture, texture.pending.baseLevel);
+		} else if (texture.current.image != VK_NULL_HANDLE) {
+			bytes += bytesFrom(texture, texture.current.baseLevel);
+		}
+	}
+	return bytes;
+}
+
+// VK_EXT_memory_budget reports what the process may use of each heap,
+// including other allocations, so the textures get what is left over
+void	TextureStreamer::refreshBudget(void) {
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT	budgetProperties{};
+	VkPhysicalDeviceMemoryProperties2			memProperties{};
+	VkDeviceSize								available = 0;
+
+	if (!useMemoryBudget) {
+		budget = configuredBudget;
+		return;
+	}
+
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+	memProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	memProperties.pNext = &budgetProperties;
+
+	vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memProperties);
+
+	for (uint32_t i = 0; i < memProperties.memoryProperties.memoryHeapCount; i++) {
+		if ((memProperties.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+				&& budgetProperties.heapBudget[i] > budgetProperties.heapUsage[i]) {
+			available = std::max(available, budgetProperties.heapBudget[i] - budgetProperties.heapUsage[i]);
+		}
+	}
+
+	budget = getResidentBytes() + available;
+	if (configuredBudget > 0) {
+		budget = std::min(budget, configuredBudget);
+	}
+}
+
+// Creates an image holding levels [baseLevel, levelCount) as the texture's
+// pending image. Only levels that aren't resident are uploaded; the rest
+// are copied from the current image on the consumer queue once it owns the
+// new one, since the current image belongs to that queue.
+void	TextureStreamer::schedule(StreamedTexture& texture, uint32_t baseLevel) {
+	ResidentImage&			image = texture.pending;
+	uint32_t				levelCount = static_cast<uint32_t>(texture.levels.size()) - baseLevel;
+	uint32_t				firstResident = static_cast<uint32_t>(texture.levels.size());
+	VkImageCreateInfo		imageInfo{};
+	AllocationCreateInfo	allocInfo{};
+	VkImageViewCreateInfo	viewInfo{};
+	VkImageMemoryBarrier	barrier{};
+	std::vector<VkImageCopy>	copies;
+	VkImage					source = texture.current.image;
+	uint32_t				sourceLevels = 0;
+	VkImage					destination;
+
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent.width = texture.levels[baseLevel].width;
+	imageInfo.extent.height = texture.levels[baseLevel].height;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = levelCount;
+	imageInfo.arrayLayers = 1;
+	imageInfo.format = texture.format;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+
+	if (vkCreateImage(device, &imageInfo, nullptr, image.image.replace(device)) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create streamed texture image!");
+	}
+
+	allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	allocInfo.kind = AllocationKind::ImageOptimal;
+	image.allocation = allocator->allocateForImage(image.image, allocInfo);
+	image.baseLevel = baseLevel;
+
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = image.image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+	viewInfo.format = texture.format;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.baseMipLevel = 0;
+	viewInfo.subresourceRange.levelCount = levelCount;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount = 1;
+
+	if (vkCreateImageView(device, &viewInfo, nullptr, image.view.replace(device)) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create streamed texture view!");
+	}
+
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.image = image.image;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.subresourceRange = viewInfo.subresourceRange;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(uploader->getCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	if (source != VK_NULL_HANDLE) {
+		firstResident = std::max(baseLevel, texture.current.baseLevel);
+		sourceLevels = static_cast<uint32_t>(texture.levels.size()) - texture.current.baseLevel;
+	}
+
+	for (uint32_t i = baseLevel; i < firstResident; i++) {
+		const ImageLevel&	level = texture.levels[i];
+
+		uploader->uploadImage(image.image, texture.format, level.width, level.height, texture.data.data() + level.offset, level.size, i - baseLevel);
+	}
+
+	if (firstResident == texture.levels.size()) {
+		uploader->releaseImage(image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		image.batchId = uploader->getCurrentBatchId();
+		return;
+	}
+
+	for (uint32_t i = firstResident; i < texture.levels.size(); i++) {
+		VkImageCopy	copy{};
+
+		copy.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copy.srcSubresource.mipLevel = i - texture.current.baseLevel;
+		copy.srcSubresource.baseArrayLayer = 0;
+		copy.srcSubresource.layerCount = 1;
+		copy.dstSubresource = copy.srcSubresource;
+		copy.dstSubresource.mipLevel = i - baseLevel;
+		copy.extent = {texture.levels[i].width, texture.levels[i].height, 1};
+		copies.push_back(copy);
+	}
+
+	// The current image stays bound until the new one replaces it, so it
+	// goes back to being sampled after the copy
+	destination = image.image;
+	uploader->releaseImage(image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+			[source, sourceLevels, destination, levelCount, copies](VkCommandBuffer commandBuffer) {
+		VkImageMemoryBarrier	barriers[2]{};
+
+		barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barriers[0].image = source;
+		barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[0].subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, sourceLevels, 0, 1};
+		barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barriers[0]);
+
+		vkCmdCopyImage(commandBuffer, source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				static_cast<uint32_t>(copies.size()), copies.data());
+
+		barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		barriers[1] = barriers[0];
+		barriers[1].image = destination;
+		barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barriers[1].subresourceRange.levelCount = levelCount;
+		barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+	});
+	image.batchId = uploader->getCurrentBatchId();
+}
+
+// Everything submitted so far may still sample the image, and the next
+// submission may still copy from it: its replacement's batch is complete,
+// so the frame being recorded acquires it if no earlier one has
+void	TextureStreamer::retire(ResidentImage& image) {
+	TimelinePoint	lastUse = timeline->getLastSubmitted(consumerQueue);
+	GpuAllocation	allocation = image.allocation;
+
+	lastUse.value++;
+	retiredBytes += allocation.size;
+	deletionQueue->retire(std::move(image.view), lastUse);
+	deletionQueue->retire(std::move(image.image), lastUse);
+	deletionQueue->retire([this, allocation]() mutable {
+		retiredBytes -= allocation.size;
+		allocator->free(allocation);
+	}, lastUse);
+	image = ResidentImage{};
+}
+
+void	TextureStreamer::destroyImage(ResidentImage& image) {
+	if (image.image == VK_NULL_HANDLE) {
+		return;
+	}
+
+	image.view.reset();
+	image.image.reset();
+	allocator->free(image.allocation);
+	image = ResidentImage{};
+}
+
+// Drops the top level of the least recently used texture that wasn't
+// requested this frame
+bool	TextureStreamer::evictOne(uint64_t frame, const StreamedTexture* keep) {
+	StreamedTexture*	victim = nullptr;
+
+	for (auto& texture : textures) {
+		if (&texture == keep || texture.pending.image != VK_NULL_HANDLE || texture.current.image == VK_NULL_HANDLE
+				|| texture.current.baseLevel + 1 >= texture.levels.size() || texture.residency.lastUsedFrame >= frame) {
+			continue;
+		}
+		if (victim == nullptr || texture.residency.lastUsedFrame < victim->residency.lastUsedFrame) {
+			victim = &texture;
+		}
+	}
+
+	if (victim == nullptr) {
+		return false;
+	}
+
+	schedule(*victim, victim->current.baseLevel + 1);
+	return true;
+}
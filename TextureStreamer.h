@@ -0,0 +1,114 @@
+#pragma once
+
+#include "DeletionQueue.h"
+#include "DeviceHandle.h"
+#include "GpuAllocator.h"
+#include "Uploader.h"
+#include "GpuTimeline.h"
+#include "AssetLoader.h"
+
+#include <vulkan/vulkan.h>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct	TextureResidency {
+	uint32_t		levelCount = 0;
+	uint32_t		residentBase = 0;
+	uint32_t		requestedBase = 0;
+	VkDeviceSize	residentBytes = 0;
+	uint64_t		lastUsedFrame = 0;
+	uint32_t		refinements = 0;
+	uint32_t		evictions = 0;
+};
+
+// Keeps a CPU copy of every mip chain and only a suffix of each chain on
+// the GPU. Textures start with their small levels resident and are refined
+// one level at a time towards what requestLevel() asks for; when the budget
+// is exceeded, least recently used textures drop their top level.
+//
+// Changing the resident range creates a new image holding levels
+// [base, levelCount). Levels that weren't resident are uploaded on the
+// transfer queue, and the others copied from the old image on the consumer
+// queue when it acquires the new one. The old image stays bound until the
+// upload batch has completed, and is then retired to the deletion queue
+// at the last submission that could still use it, so streaming never
+// makes a frame wait.
+class	TextureStreamer
+{
+	public:
+		void	init(VkPhysicalDevice physicalDevice, VkDevice device, GpuAllocator& allocator, Uploader& uploader,
+				GpuTimeline& timeline, DeletionQueue& deletionQueue, uint32_t consumerQueue, uint32_t framesInFlight, VkDeviceSize budget, bool useMemoryBudget);
+
+		void	destroy(void);
+
+		uint32_t	addTexture(const DecodedImage& image);
+
+		void	requestLevel(uint32_t texture, uint32_t baseLevel, uint64_t frame);
+
+		void	update(uint64_t frame);
+
+		VkImageView	getView(uint32_t texture) const;
+
+		const TextureResidency&	getResidency(uint32_t texture) const;
+
+		VkDeviceSize	getBudget(void) const;
+
+		VkDeviceSize	getResidentBytes(void) const;
+
+		void	printStats(std::ostream& out) const;
+
+	private:
+		struct	ResidentImage {
+			UniqueImage		image;
+			GpuAllocation	allocation;
+			UniqueImageView	view;
+			uint32_t		baseLevel = 0;
+			uint64_t		batchId = 0;
+		};
+
+		struct	StreamedTexture {
+			std::string					path;
+			VkFormat					format;
+			std::vector<ImageLevel>		levels;
+			std::vector<unsigned char>	data;
+			ResidentImage				current;
+			ResidentImage				pending;
+			TextureResidency			residency;
+		};
+
+		VkPhysicalDevice	physicalDevice = VK_NULL_HANDLE;
+		VkDevice			device = VK_NULL_HANDLE;
+		GpuAllocator*		allocator = nullptr;
+		Uploader*			uploader = nullptr;
+		GpuTimeline*		timeline = nullptr;
+		DeletionQueue*		deletionQueue = nullptr;
+		uint32_t			consumerQueue = 0;
+		uint32_t			framesInFlight = 0;
+		VkDeviceSize		configuredBudget = 0;
+		VkDeviceSize		budget = 0;
+		bool				useMemoryBudget = false;
+
+		// Memory of retired images whose deletion is still queued
+		VkDeviceSize		retiredBytes = 0;
+
+		// Caps the bytes staged per update so refinement never fills the ring
+		VkDeviceSize		maxUploadBytes = 8ull << 20;
+
+		std::vector<StreamedTexture>	textures;
+
+		VkDeviceSize	bytesFrom(const StreamedTexture& texture, uint32_t baseLevel) const;
+
+		VkDeviceSize	projectedBytes(void) const;
+
+		void	refreshBudget(void);
+
+		void	schedule(StreamedTexture& texture, uint32_t baseLevel);
+
+		void	retire(ResidentImage& image);
+
+		void	destroyImage(ResidentImage& image);
+
+		bool	evictOne(uint64_t frame, const StreamedTexture* keep);
+};
@@ -0,0 +1,77 @@
+#include "UniformRing.h"
+#include <stdexcept>
+#include <algorithm>
+#include <string>
+
+static VkDeviceSize	alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+void	UniformRing::init(VkPhysicalDevice physicalDevice, VkDevice device, GpuAllocator& allocator, uint32_t framesInFlight, VkDeviceSize frameSize) {
+	VkPhysicalDeviceProperties	properties;
+	VkBufferCreateInfo			bufferInfo{};
+	AllocationCreateInfo		allocInfo{};
+
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	this->device = device;
+	this->allocator = &allocator;
+	alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 16);
+	this->frameSize = alignUp(frameSize, alignment);
+
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = this->frameSize * framesInFlight;
+	bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, buffer.replace(device)) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create uniform ring buffer!");
+	}
+
+	// Device local host visible memory, where there is some, saves the
+	// shaders from reading the constants over the bus
+	allocInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	allocInfo.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	allocInfo.kind = AllocationKind::Buffer;
+
+	allocation = allocator.allocateForBuffer(buffer, allocInfo);
+}
+
+void	UniformRing::destroy(void) {
+	buffer.reset();
+	allocator->free(allocation);
+}
+
+void	UniformRing::beginFrame(uint32_t frame) {
+	peakFrameUsage = std::max(peakFrameUsage, head.load() - frameBase);
+	frameBase = frameSize * frame;
+	head = frameBase;
+}
+
+UniformAllocation	UniformRing::allocate(VkDeviceSize size, uint32_t count) {
+	UniformAllocation	block;
+	VkDeviceSize		offset;
+
+	block.stride = getStride(size);
+	offset = head.fetch_add(block.stride * count);
+
+	if (offset + block.stride * count > frameBase + frameSize) {
+		throw std::runtime_error("uniform ring overflow, frame needs more than " + std::to_string(frameSize) + " bytes!");
+	}
+
+	block.offset = static_cast<uint32_t>(offset);
+	block.mapped = static_cast<char*>(allocation.mapped) + offset;
+	return block;
+}
+
+VkBuffer	UniformRing::getBuffer(void) const {
+	return buffer;
+}
+
+VkDeviceSize	UniformRing::getStride(VkDeviceSize size) const {
+	return alignUp(size, alignment);
+}
+
+VkDeviceSize	UniformRing::getPeakFrameUsage(void) const {
+	return peakFrameUsage;
+}
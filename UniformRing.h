@@ -0,0 +1,53 @@
+#pragma once
+
+#include "DeviceHandle.h"
+#include "GpuAllocator.h"
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+
+// Block of count uniform structs, each stride bytes apart. offset is what
+// is passed as the dynamic offset of the first one.
+struct	UniformAllocation {
+	uint32_t		offset = 0;
+	VkDeviceSize	stride = 0;
+	char*			mapped = nullptr;
+};
+
+// Linear allocator over one persistently mapped buffer bound through
+// VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC. The buffer holds one region
+// per frame in flight; beginFrame() rewinds the region of a frame whose
+// last submit has completed, and blocks are handed out with an atomic
+// bump so recording jobs can allocate concurrently. Descriptors point at
+// the whole buffer and never change, each draw only passes new dynamic
+// offsets.
+class	UniformRing
+{
+	public:
+		void	init(VkPhysicalDevice physicalDevice, VkDevice device, GpuAllocator& allocator, uint32_t framesInFlight, VkDeviceSize frameSize);
+
+		void	destroy(void);
+
+		void	beginFrame(uint32_t frame);
+
+		UniformAllocation	allocate(VkDeviceSize size, uint32_t count = 1);
+
+		VkBuffer	getBuffer(void) const;
+
+		VkDeviceSize	getStride(VkDeviceSize size) const;
+
+		VkDeviceSize	getPeakFrameUsage(void) const;
+
+	private:
+		VkDevice		device = VK_NULL_HANDLE;
+		GpuAllocator*	allocator = nullptr;
+		UniqueBuffer	buffer;
+		GpuAllocation	allocation;
+		VkDeviceSize	alignment = 0;
+		VkDeviceSize	frameSize = 0;
+		VkDeviceSize	frameBase = 0;
+		VkDeviceSize	peakFrameUsage = 0;
+
+		std::atomic<VkDeviceSize>	head{0};
+};
@@ -0,0 +1,436 @@
+#include "Uploader.h"
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+
+static VkDeviceSize	alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+void	Uploader::init(VkDevice device, GpuAllocator& allocator, GpuTimeline& timeline, uint32_t timelineQueue, uint32_t queueFamily, uint32_t dstQueueFamily, VkDeviceSize ringSize) {
+	VkCommandPoolCreateInfo		poolInfo{};
+	VkBufferCreateInfo			bufferInfo{};
+	AllocationCreateInfo		ringAllocInfo{};
+
+	this->device = device;
+	this->allocator = &allocator;
+	this->timeline = &timeline;
+	this->timelineQueue = timelineQueue;
+	this->srcFamily = queueFamily;
+	this->dstFamily = dstQueueFamily;
+	this->ringSize = ringSize;
+
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = queueFamily;
+
+	if (vkCreateCommandPool(device, &poolInfo, nullptr, commandPool.replace(device)) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload command pool");
+	}
+
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = ringSize;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, ringBuffer.replace(device)) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create staging ring buffer!");
+	}
+
+	ringAllocInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	ringAllocInfo.kind = AllocationKind::Buffer;
+	ringAllocInfo.dedicated = true;
+
+	ringAllocation = allocator.allocateForBuffer(ringBuffer, ringAllocInfo);
+}
+
+void	Uploader::destroy(void) {
+	for (auto& batch : batches) {
+		if (batch.inFlight) {
+			timeline->wait(batch.point);
+		}
+	}
+	batches.clear();
+
+	commandPool.reset();
+	ringBuffer.reset();
+	allocator->free(ringAllocation);
+}
+
+Uploader::UploadBatch&	Uploader::createBatch(void) {
+	VkCommandBufferAllocateInfo	allocInfo{};
+	UploadBatch					batch{};
+
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = commandPool;
+	allocInfo.commandBufferCount = 1;
+
+	if (vkAllocateCommandBuffers(device, &allocInfo, &batch.commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload batch");
+	}
+
+	batches.push_back(batch);
+
+	return batches.back();
+}
+
+// Timeline points can be waited on any number of times, so a batch is
+// free as soon as it has executed and its acquires have been recorded
+bool	Uploader::isReusable(UploadBatch& batch) {
+	return !batch.inFlight && !batch.pendingAcquire && &batch != current;
+}
+
+void	Uploader::retireCompleted(void) {
+	while (true) {
+		UploadBatch*	oldest = nullptr;
+
+		for (auto& batch : batches) {
+			if (batch.inFlight && (oldest == nullptr || batch.id < oldest->id)) {
+				oldest = &batch;
+			}
+		}
+
+		if (oldest == nullptr || !timeline->isComplete(oldest->point)) {
+			return;
+		}
+
+		oldest->inFlight = false;
+		ringTail = oldest->ringEnd;
+		completedBatchId = oldest->id;
+	}
+}
+
+void	Uploader::waitOldest(void) {
+	UploadBatch*	oldest = nullptr;
+
+	for (auto& batch : batches) {
+		if (batch.inFlight && (oldest == nullptr || batch.id < oldest->id)) {
+			oldest = &batch;
+		}
+	}
+
+	if (oldest != nullptr) {
+		timeline->wait(oldest->point);
+	}
+	retireCompleted();
+}
+
+VkCommandBuffer	Uploader::getCommandBuffer(void) {
+	VkCommandBufferBeginInfo	beginInfo{};
+
+	if (current != nullptr) {
+		return current->commandBuffer;
+	}
+
+	retireCompleted();
+	for (auto& batch : batches) {
+		if (isReusable(batch)) {
+			current = &batch;
+			break;
+		}
+	}
+	if (current == nullptr) {
+		current = &createBatch();
+	}
+
+	current->id = nextBatchId++;
+	current->acquireStages = 0;
+	current->bufferAcquires.clear();
+	current->imageAcquires.clear();
+	current->acquireCallbacks.clear();
+
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkResetCommandBuffer(current->commandBuffer, 0);
+	if (vkBeginCommandBuffer(current->commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin upload command buffer");
+	}
+
+	return current->commandBuffer;
+}
+
+// Id of the batch commands are being recorded into
+uint64_t	Uploader::getCurrentBatchId(void) {
+	getCommandBuffer();
+	return current->id;
+}
+
+VkDeviceSize	Uploader::allocateRing(VkDeviceSize size, VkDeviceSize alignment) {
+	if (size > ringSize) {
+		throw std::runtime_error("upload larger than the staging ring!");
+	}
+
+	while (true) {
+		VkDeviceSize	offset = alignUp(ringHead, alignment);
+		bool			anyInFlight = false;
+
+		// Never let a copy straddle the end of the ring
+		if (offset % ringSize + size > ringSize) {
+			offset = alignUp(offset, ringSize);
+		}
+
+		if (offset + size - ringTail <= ringSize) {
+			ringHead = offset + size;
+			return offset % ringSize;
+		}
+
+		for (const auto& batch : batches) {
+			anyInFlight = anyInFlight || batch.inFlight;
+		}
+
+		if (anyInFlight) {
+			waitOldest();
+		} else if (current != nullptr) {
+			flush();
+		} else {
+			ringHead = alignUp(ringHead, ringSize);
+			ringTail = ringHead;
+		}
+	}
+}
+
+void	Uploader::uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size) {
+	const char*		src = static_cast<const char*>(data);
+	VkDeviceSize	maxChunk = ringSize / 4;
+
+	while (size > 0) {
+		VkDeviceSize	chunk = std::min(size, maxChunk);
+		VkDeviceSize	ringOffset = allocateRing(chunk, 4);
+		VkBufferCopy	copyRegion{};
+
+		memcpy(static_cast<char*>(ringAllocation.mapped) + ringOffset, src, static_cast<size_t>(chunk));
+
+		copyRegion.srcOffset = ringOffset;
+		copyRegion.dstOffset = dstOffset;
+		copyRegion.size = chunk;
+
+		vkCmdCopyBuffer(getCommandBuffer(), ringBuffer, dstBuffer, 1, &copyRegion);
+
+		src += chunk;
+		dstOffset += chunk;
+		size -= chunk;
+	}
+}
+
+// Edge length and size in bytes of the texel blocks of the formats that
+// textures are uploaded in
+static void	getTexelBlock(VkFormat format, uint32_t& blockSize, VkDeviceSize& blockBytes) {
+	switch (format) {
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+			blockSize = 1;
+			blockBytes = 4;
+			return;
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+		case VK_FORMAT_BC4_SNORM_BLOCK:
+			blockSize = 4;
+			blockBytes = 8;
+			return;
+		case VK_FORMAT_BC2_UNORM_BLOCK:
+		case VK_FORMAT_BC2_SRGB_BLOCK:
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+		case VK_FORMAT_BC5_SNORM_BLOCK:
+		case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+		case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			blockSize = 4;
+			blockBytes = 16;
+			return;
+		default:
+			throw std::runtime_error("unsupported image upload format");
+	}
+}
+
+// Levels are tightly packed rows of texel blocks, split into row ranges of
+// at most a quarter of the ring with one copy per range
+void	Uploader::uploadImage(VkImage dstImage, VkFormat format, uint32_t width, uint32_t height, const void* data, VkDeviceSize size, uint32_t mipLevel) {
+	const char*		src = static_cast<const char*>(data);
+	uint32_t		blockHeight;
+	VkDeviceSize	blockBytes;
+	uint32_t		rows;
+	VkDeviceSize	rowBytes;
+	uint32_t		chunkRows;
+
+	getTexelBlock(format, blockHeight, blockBytes);
+	rows = (height + blockHeight - 1) / blockHeight;
+	rowBytes = (width + blockHeight - 1) / blockHeight * blockBytes;
+	if (rows == 0 || rowBytes == 0 || size != rows * rowBytes) {
+		throw std::runtime_error("image level size doesn't match its format and extent");
+	}
+	chunkRows = static_cast<uint32_t>(std::max<VkDeviceSize>(ringSize / 4 / rowBytes, 1));
+
+	for (uint32_t row = 0; row < rows; row += chunkRows) {
+		uint32_t			count = std::min(chunkRows, rows - row);
+		VkDeviceSize		chunk = rowBytes * count;
+		VkDeviceSize		ringOffset = allocateRing(chunk, 16);
+		uint32_t			y = row * blockHeight;
+		VkBufferImageCopy	region{};
+
+		memcpy(static_cast<char*>(ringAllocation.mapped) + ringOffset, src + rowBytes * row, static_cast<size_t>(chunk));
+
+		region.bufferOffset = ringOffset;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = mipLevel;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+
+		region.imageOffset = {0, static_cast<int32_t>(y), 0};
+		region.imageExtent = {width, std::min(count * blockHeight, height - y), 1};
+
+		vkCmdCopyBufferToImage(getCommandBuffer(), ringBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	}
+}
+
+void	Uploader::releaseBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+	VkCommandBuffer			commandBuffer = getCommandBuffer();
+	VkBufferMemoryBarrier	barrier{};
+
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.buffer = buffer;
+	barrier.offset = offset;
+	barrier.size = size;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	if (srcFamily == dstFamily) {
+		barrier.dstAccessMask = dstAccess;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+		return;
+	}
+
+	barrier.dstAccessMask = 0;
+	barrier.srcQueueFamilyIndex = srcFamily;
+	barrier.dstQueueFamilyIndex = dstFamily;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = dstAccess;
+	current->bufferAcquires.push_back(barrier);
+	current->acquireStages |= dstStage;
+}
+
+void	Uploader::releaseImage(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, std::function<void(VkCommandBuffer)> onAcquire) {
+	VkCommandBuffer			commandBuffer = getCommandBuffer();
+	VkImageMemoryBarrier	barrier{};
+
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.image = image;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	if (srcFamily == dstFamily) {
+		barrier.dstAccessMask = dstAccess;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		if (onAcquire) {
+			onAcquire(commandBuffer);
+		}
+		return;
+	}
+
+	// The layout transition happens once, between the release and the
+	// acquire, so both barriers carry the same old and new layouts
+	barrier.dstAccessMask = 0;
+	barrier.srcQueueFamilyIndex = srcFamily;
+	barrier.dstQueueFamilyIndex = dstFamily;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = dstAccess;
+	current->imageAcquires.push_back(barrier);
+	current->acquireStages |= dstStage;
+	if (onAcquire) {
+		current->acquireCallbacks.push_back(std::move(onAcquire));
+	}
+}
+
+uint64_t	Uploader::flush(void) {
+	if (current == nullptr) {
+		return nextBatchId - 1;
+	}
+
+	if (vkEndCommandBuffer(current->commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record upload command buffer");
+	}
+
+	current->point = timeline->submit(timelineQueue, &current->commandBuffer, 1, {});
+	current->ringEnd = ringHead;
+	current->inFlight = true;
+	current->pendingAcquire = true;
+	current = nullptr;
+
+	return nextBatchId - 1;
+}
+
+// Completed batches are still waited on, which costs nothing on the GPU
+// and is what orders the release before the acquire
+void	Uploader::acquirePending(VkCommandBuffer commandBuffer, std::vector<TimelineWait>& waits, bool completedOnly) {
+	flush();
+
+	for (auto& batch : batches) {
+		if (!batch.pendingAcquire || (completedOnly && !timeline->isComplete(batch.point))) {
+			continue;
+		}
+
+		if (!batch.bufferAcquires.empty() || !batch.imageAcquires.empty()) {
+			vkCmdPipelineBarrier(commandBuffer, batch.acquireStages, batch.acquireStages, 0, 0, nullptr,
+					static_cast<uint32_t>(batch.bufferAcquires.size()), batch.bufferAcquires.data(),
+					static_cast<uint32_t>(batch.imageAcquires.size()), batch.imageAcquires.data());
+		}
+
+		for (auto& callback : batch.acquireCallbacks) {
+			callback(commandBuffer);
+		}
+
+		waits.push_back(timeline->waitFor(batch.point, batch.acquireStages != 0 ? batch.acquireStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT));
+
+		batch.pendingAcquire = false;
+		batch.bufferAcquires.clear();
+		batch.imageAcquires.clear();
+		batch.acquireCallbacks.clear();
+	}
+}
+
+void	Uploader::wait(uint64_t batchId) {
+	batchId = std::min(batchId, nextBatchId - 1);
+
+	if (current != nullptr && batchId >= current->id) {
+		flush();
+	}
+
+	retireCompleted();
+	while (completedBatchId < batchId) {
+		waitOldest();
+	}
+}
+
+bool	Uploader::isComplete(uint64_t batchId) {
+	retireCompleted();
+	return completedBatchId >= batchId;
+}
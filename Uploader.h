@@ -0,0 +1,97 @@
+#pragma once
+
+#include "DeviceHandle.h"
+#include "GpuAllocator.h"
+#include "GpuTimeline.h"
+
+#include <vulkan/vulkan.h>
+#include <deque>
+#include <functional>
+#include <vector>
+
+// Records staging copies into batched command buffers on the transfer
+// queue. Source data is written to a persistently mapped ring buffer
+// whose space is recycled once the timeline point of the batch that
+// consumed it has been reached, so a stream of uploads costs one submit
+// per batch instead of a queue stall per copy.
+//
+// Resources are created with exclusive sharing, so once copied they are
+// released to the graphics family. The matching acquire barriers, and the
+// timeline points the graphics submit has to wait on, are handed out by
+// acquirePending() while the frame is recorded. Frames can ask for
+// completed batches only, so a frame never waits on an upload; resources
+// must then not be used before their batch is complete.
+//
+// Work that needs the graphics queue once the resource is owned there,
+// such as filling a mip chain with blits, is passed to releaseImage() as
+// a callback and recorded right after the acquire.
+class	Uploader
+{
+	public:
+		void	init(VkDevice device, GpuAllocator& allocator, GpuTimeline& timeline, uint32_t timelineQueue, uint32_t queueFamily, uint32_t dstQueueFamily, VkDeviceSize ringSize = 32ull << 20);
+
+		void	destroy(void);
+
+		VkCommandBuffer	getCommandBuffer(void);
+
+		uint64_t	getCurrentBatchId(void);
+
+		void	uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+		void	uploadImage(VkImage dstImage, VkFormat format, uint32_t width, uint32_t height, const void* data, VkDeviceSize size, uint32_t mipLevel = 0);
+
+		void	releaseBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+		void	releaseImage(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, std::function<void(VkCommandBuffer)> onAcquire = nullptr);
+
+		uint64_t	flush(void);
+
+		void	acquirePending(VkCommandBuffer commandBuffer, std::vector<TimelineWait>& waits, bool completedOnly = false);
+
+		void	wait(uint64_t batchId);
+
+		bool	isComplete(uint64_t batchId);
+
+	private:
+		struct	UploadBatch {
+			VkCommandBuffer						commandBuffer = VK_NULL_HANDLE;
+			TimelinePoint						point;
+			uint64_t							id = 0;
+			VkDeviceSize						ringEnd = 0;
+			bool								inFlight = false;
+			bool								pendingAcquire = false;
+			VkPipelineStageFlags				acquireStages = 0;
+			std::vector<VkBufferMemoryBarrier>	bufferAcquires;
+			std::vector<VkImageMemoryBarrier>	imageAcquires;
+			std::vector<std::function<void(VkCommandBuffer)>>	acquireCallbacks;
+		};
+
+		VkDevice			device = VK_NULL_HANDLE;
+		GpuAllocator*		allocator = nullptr;
+		GpuTimeline*		timeline = nullptr;
+		uint32_t			timelineQueue = 0;
+		uint32_t			srcFamily = 0;
+		uint32_t			dstFamily = 0;
+		UniqueCommandPool	commandPool;
+
+		UniqueBuffer		ringBuffer;
+		GpuAllocation		ringAllocation;
+		VkDeviceSize		ringSize = 0;
+		VkDeviceSize		ringHead = 0;
+		VkDeviceSize		ringTail = 0;
+
+		std::deque<UploadBatch>	batches;
+		UploadBatch*	current = nullptr;
+		uint64_t		nextBatchId = 1;
+		uint64_t		completedBatchId = 0;
+
+		bool	isReusable(UploadBatch& batch);
+
+		UploadBatch&	createBatch(void);
+
+		void	retireCompleted(void);
+
+		void	waitOldest(void);
+
+		VkDeviceSize	allocateRing(VkDeviceSize size, VkDeviceSize alignment);
+};
@@ -0,0 +1,113 @@
+#include "Vertex.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Round to nearest even; overflow becomes infinity and tiny values
+// become denormals or zero
+static uint16_t	floatToHalf(float value) {
+	uint32_t	bits;
+	uint32_t	sign;
+	int32_t		exponent;
+	uint32_t	mantissa;
+	uint32_t	half;
+	uint32_t	remainder;
+	uint32_t	halfway;
+
+	memcpy(&bits, &value, sizeof(bits));
+	sign = (bits >> 16) & 0x8000;
+	exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+	mantissa = bits & 0x7fffff;
+
+	if (((bits >> 23) & 0xff) == 0xff) {
+		return static_cast<uint16_t>(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+	}
+	if (exponent >= 31) {
+		return static_cast<uint16_t>(sign | 0x7c00);
+	}
+
+	if (exponent <= 0) {
+		uint32_t	shift;
+
+		if (exponent < -10) {
+			return static_cast<uint16_t>(sign);
+		}
+		mantissa |= 0x800000;
+		shift = static_cast<uint32_t>(14 - exponent);
+		half = mantissa >> shift;
+		remainder = mantissa & ((1u << shift) - 1);
+		halfway = 1u << (shift - 1);
+	} else {
+		half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+		remainder = mantissa & 0x1fff;
+		halfway = 0x1000;
+	}
+
+	// A carry out of the mantissa correctly bumps the exponent
+	if (remainder > halfway || (remainder == halfway && (half & 1) != 0)) {
+		half++;
+	}
+	return static_cast<uint16_t>(sign | half);
+}
+
+static int16_t	toSnorm16(float value) {
+	return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+static uint16_t	toUnorm16(float value) {
+	return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+static uint8_t	toUnorm8(float value) {
+	return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+static Unorm8x4	packColor(const glm::vec3& color) {
+	return Unorm8x4{{toUnorm8(color.x), toUnorm8(color.y), toUnorm8(color.z), 255}};
+}
+
+static Unorm16x2	packTexCoord(const glm::vec2& texCoord) {
+	return Unorm16x2{{toUnorm16(texCoord.x), toUnorm16(texCoord.y)}};
+}
+
+glm::vec3	VertexQuantization::quantize(const glm::vec3& position) const {
+	return (position - offset) * scale;
+}
+
+glm::mat4	VertexQuantization::getDequantizeTransform(void) const {
+	return glm::scale(glm::translate(glm::mat4(1.0f), offset), 1.0f / scale);
+}
+
+// Maps the longest axis of the bounds onto [-1, 1]. The scale is the same
+// on every axis so bounding spheres and normal cones carry over.
+VertexQuantization	makeBoundsQuantization(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+	VertexQuantization	quantization;
+	glm::vec3			halfExtent = (boundsMax - boundsMin) * 0.5f;
+	float				largest = std::max(halfExtent.x, std::max(halfExtent.y, halfExtent.z));
+
+	quantization.offset = (boundsMin + boundsMax) * 0.5f;
+	quantization.scale = glm::vec3(largest > 0.0f ? 1.0f / largest : 1.0f);
+	return quantization;
+}
+
+void	encodeVertex(const Vertex& vertex, const VertexQuantization& quantization, Vertex& out) {
+	out = vertex;
+	out.pos = quantization.quantize(vertex.pos);
+}
+
+void	encodeVertex(const Vertex& vertex, const VertexQuantization& quantization, VertexHalf& out) {
+	glm::vec3	position = quantization.quantize(vertex.pos);
+
+	out.pos = Half4{{floatToHalf(position.x), floatToHalf(position.y), floatToHalf(position.z), floatToHalf(1.0f)}};
+	out.color = packColor(vertex.color);
+	out.texCoord = packTexCoord(vertex.texCoord);
+}
+
+void	encodeVertex(const Vertex& vertex, const VertexQuantization& quantization, VertexSnorm16& out) {
+	glm::vec3	position = quantization.quantize(vertex.pos);
+
+	out.pos = Snorm16x4{{toSnorm16(position.x), toSnorm16(position.y), toSnorm16(position.z), 32767}};
+	out.color = packColor(vertex.color);
+	out.texCoord = packTexCoord(vertex.texCoord);
+}
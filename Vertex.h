@@ -0,0 +1,192 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Per-draw data, either written to the uniform ring for each
+// vkCmdDrawIndexed or streamed to the instance buffer for a single
+// instanced draw. Laid out to match the std140 block in shader.vert.
+struct	DrawItem {
+	glm::mat4	model;
+	glm::vec4	tint;
+	uint32_t	textureLayer;
+	uint32_t	padding[3];
+};
+
+// Packed attribute storage. The vertex input stage converts each format
+// to the float vector the shader declares, so one shader serves every
+// layout. All of these are mandatory vertex buffer formats.
+struct	Half4 {
+	uint16_t	value[4];
+};
+
+struct	Snorm16x4 {
+	int16_t		value[4];
+};
+
+struct	Unorm8x4 {
+	uint8_t		value[4];
+};
+
+struct	Unorm16x2 {
+	uint16_t	value[2];
+};
+
+template<typename T>
+struct	AttributeFormat;
+
+template<> struct	AttributeFormat<glm::vec2> { static constexpr VkFormat	value = VK_FORMAT_R32G32_SFLOAT; };
+template<> struct	AttributeFormat<glm::vec3> { static constexpr VkFormat	value = VK_FORMAT_R32G32B32_SFLOAT; };
+template<> struct	AttributeFormat<glm::vec4> { static constexpr VkFormat	value = VK_FORMAT_R32G32B32A32_SFLOAT; };
+template<> struct	AttributeFormat<uint32_t> { static constexpr VkFormat	value = VK_FORMAT_R32_UINT; };
+template<> struct	AttributeFormat<Half4> { static constexpr VkFormat	value = VK_FORMAT_R16G16B16A16_SFLOAT; };
+template<> struct	AttributeFormat<Snorm16x4> { static constexpr VkFormat	value = VK_FORMAT_R16G16B16A16_SNORM; };
+template<> struct	AttributeFormat<Unorm8x4> { static constexpr VkFormat	value = VK_FORMAT_R8G8B8A8_UNORM; };
+template<> struct	AttributeFormat<Unorm16x2> { static constexpr VkFormat	value = VK_FORMAT_R16G16_UNORM; };
+
+// Vertex layouts all have pos, color and texCoord members. BOUNDS_RELATIVE
+// layouts store positions relative to the mesh bounds, see
+// VertexQuantization.
+
+// 32 bytes. Meshes are imported and optimized in this layout.
+struct	Vertex {
+	static constexpr bool	BOUNDS_RELATIVE = false;
+
+	glm::vec3	pos;
+	glm::vec3	color;
+	glm::vec2	texCoord;
+};
+
+// 16 bytes: half float positions (exact to 11 significant bits), unorm8
+// colors and unorm16 texture coordinates clamped to [0, 1]
+struct	VertexHalf {
+	static constexpr bool	BOUNDS_RELATIVE = false;
+
+	Half4		pos;
+	Unorm8x4	color;
+	Unorm16x2	texCoord;
+};
+
+// 16 bytes: snorm16 positions spanning the mesh bounds, which keeps 16
+// bits of precision along the longest axis whatever the mesh size; colors
+// and texture coordinates as in VertexHalf
+struct	VertexSnorm16 {
+	static constexpr bool	BOUNDS_RELATIVE = true;
+
+	Snorm16x4	pos;
+	Unorm8x4	color;
+	Unorm16x2	texCoord;
+};
+
+// The layout the geometry pool and the pipelines use, picked at build time
+// (make VERTEX_LAYOUT=half or VERTEX_LAYOUT=snorm16)
+#if defined(VERTEX_LAYOUT_HALF)
+using	SceneVertex = VertexHalf;
+const char* const	VERTEX_LAYOUT_NAME = "half";
+#elif defined(VERTEX_LAYOUT_SNORM16)
+using	SceneVertex = VertexSnorm16;
+const char* const	VERTEX_LAYOUT_NAME = "snorm16";
+#else
+using	SceneVertex = Vertex;
+const char* const	VERTEX_LAYOUT_NAME = "float";
+#endif
+
+// Stored position = (mesh position - offset) * scale, with a uniform
+// scale. The inverse is folded into each draw's model matrix instead of
+// decoded in the shader.
+struct	VertexQuantization {
+	glm::vec3	offset{0.0f};
+	glm::vec3	scale{1.0f};
+
+	glm::vec3	quantize(const glm::vec3& position) const;
+
+	glm::mat4	getDequantizeTransform(void) const;
+};
+
+VertexQuantization	makeBoundsQuantization(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+void	encodeVertex(const Vertex& vertex, const VertexQuantization& quantization, Vertex& out);
+void	encodeVertex(const Vertex& vertex, const VertexQuantization& quantization, VertexHalf& out);
+void	encodeVertex(const Vertex& vertex, const VertexQuantization& quantization, VertexSnorm16& out);
+
+template<typename V>
+VertexQuantization	getVertexQuantization(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+	if constexpr (V::BOUNDS_RELATIVE) {
+		return makeBoundsQuantization(boundsMin, boundsMax);
+	} else {
+		return VertexQuantization{};
+	}
+}
+
+template<typename V>
+std::vector<V>	encodeVertices(const std::vector<Vertex>& vertices, const VertexQuantization& quantization) {
+	std::vector<V>	packed(vertices.size());
+
+	for (size_t i = 0; i < vertices.size(); i++) {
+		encodeVertex(vertices[i], quantization, packed[i]);
+	}
+	return packed;
+}
+
+// Binding 0 advances per vertex, binding 1 per instance over DrawItems
+template<typename V>
+std::array<VkVertexInputBindingDescription, 2>	getBindingDescriptions(void) {
+	std::array<VkVertexInputBindingDescription, 2>	bindingDescriptions{};
+
+	bindingDescriptions[0].binding = 0;
+	bindingDescriptions[0].stride = sizeof(V);
+	bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	bindingDescriptions[1].binding = 1;
+	bindingDescriptions[1].stride = sizeof(DrawItem);
+	bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+	return bindingDescriptions;
+}
+
+template<typename V>
+std::array<VkVertexInputAttributeDescription, 9>	getAttributeDescriptions(void) {
+	std::array<VkVertexInputAttributeDescription, 9>	attributeDescriptions{};
+
+	attributeDescriptions[0].binding = 0;
+	attributeDescriptions[0].location = 0;
+	attributeDescriptions[0].format = AttributeFormat<decltype(V::pos)>::value;
+	attributeDescriptions[0].offset = offsetof(V, pos);
+
+	attributeDescriptions[1].binding = 0;
+	attributeDescriptions[1].location = 1;
+	attributeDescriptions[1].format = AttributeFormat<decltype(V::color)>::value;
+	attributeDescriptions[1].offset = offsetof(V, color);
+
+	attributeDescriptions[2].binding = 0;
+	attributeDescriptions[2].location = 2;
+	attributeDescriptions[2].format = AttributeFormat<decltype(V::texCoord)>::value;
+	attributeDescriptions[2].offset = offsetof(V, texCoord);
+
+	// A mat4 attribute takes one location per column
+	for (uint32_t column = 0; column < 4; column++) {
+		attributeDescriptions[3 + column].binding = 1;
+		attributeDescriptions[3 + column].location = 3 + column;
+		attributeDescriptions[3 + column].format = AttributeFormat<glm::vec4>::value;
+		attributeDescriptions[3 + column].offset = offsetof(DrawItem, model) + sizeof(glm::vec4) * column;
+	}
+
+	attributeDescriptions[7].binding = 1;
+	attributeDescriptions[7].location = 7;
+	attributeDescriptions[7].format = AttributeFormat<decltype(DrawItem::tint)>::value;
+	attributeDescriptions[7].offset = offsetof(DrawItem, tint);
+
+	attributeDescriptions[8].binding = 1;
+	attributeDescriptions[8].location = 8;
+	attributeDescriptions[8].format = AttributeFormat<decltype(DrawItem::textureLayer)>::value;
+	attributeDescriptions[8].offset = offsetof(DrawItem, textureLayer);
+
+	return attributeDescriptions;
+}
@@ -24,13 +24,20 @@ void	DestroyDebugUtilsMessengerEXT(VkInstance instance,
 		return func(instance, messenger, pAllocator);
 }
 
-int	main(void)
+int	main(int argc, char** argv)
 {
 	HelloTriApp	app;
 
 	try
 	{
-		app.run();
+		AppOptions	options = parseOptions(argc, argv);
+
+		if (!options.ioBenchFiles.empty()) {
+			benchmarkFileLoading(options.ioBenchFiles, std::cout);
+			return EXIT_SUCCESS;
+		}
+
+		app.run(options);
 	}
 	catch (const std::exception& e)
 	{
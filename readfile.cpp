@@ -1,5 +1,14 @@
 #include "readfile.h"
 #include <fstream>
+#include <stdexcept>
+#include <chrono>
+#include <utility>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 std::vector<char>	readFile(const std::string& filename) {
 	std::ifstream	file(filename, std::ios::ate | std::ios::binary);
@@ -18,3 +27,172 @@ std::vector<char>	readFile(const std::string& filename) {
 
 	return buffer;
 }
+
+static int	toAdvice(MapHint hint) {
+	switch (hint) {
+		case MapHint::Sequential:
+			return MADV_SEQUENTIAL;
+		case MapHint::Random:
+			return MADV_RANDOM;
+		case MapHint::WillNeed:
+			return MADV_WILLNEED;
+		default:
+			return MADV_NORMAL;
+	}
+}
+
+MappedFile::MappedFile(const std::string& filename, MapHint hint) {
+	struct stat	info;
+	int			fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0) {
+		throw std::runtime_error("failed to open file " + filename);
+	}
+
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		throw std::runtime_error("failed to stat file " + filename);
+	}
+
+	length = static_cast<size_t>(info.st_size);
+
+	// mmap rejects empty ranges, an empty file is just an empty view
+	if (length > 0) {
+		mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+
+	if (mapping == MAP_FAILED) {
+		mapping = nullptr;
+		length = 0;
+		throw std::runtime_error("failed to map file " + filename);
+	}
+
+	advise(hint, 0, length);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+	: mapping(std::exchange(other.mapping, nullptr)), length(std::exchange(other.length, 0)) {
+}
+
+MappedFile&	MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this != &other) {
+		unmap();
+		mapping = std::exchange(other.mapping, nullptr);
+		length = std::exchange(other.length, 0);
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile(void) {
+	unmap();
+}
+
+void	MappedFile::unmap(void) {
+	if (mapping != nullptr) {
+		munmap(mapping, length);
+		mapping = nullptr;
+		length = 0;
+	}
+}
+
+const char*	MappedFile::data(void) const {
+	return static_cast<const char*>(mapping);
+}
+
+size_t	MappedFile::size(void) const {
+	return length;
+}
+
+bool	MappedFile::empty(void) const {
+	return length == 0;
+}
+
+// Hints apply to whole pages, so the range is widened to page boundaries
+void	MappedFile::advise(MapHint hint, size_t offset, size_t count) const {
+	size_t	pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t	begin = offset / pageSize * pageSize;
+
+	if (mapping == nullptr || count == 0) {
+		return;
+	}
+
+	madvise(static_cast<char*>(mapping) + begin, offset + count - begin, toAdvice(hint));
+}
+
+// Drops the file's clean pages from the page cache so the next read has to
+// go to the disk
+static void	evictFromPageCache(const std::string& filename) {
+	int	fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0) {
+		return;
+	}
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+}
+
+// Reads one byte per page, which is what a consumer walking the data does
+static size_t	touchPages(const char* data, size_t size) {
+	size_t			pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	volatile size_t	sum = 0;
+
+	for (size_t i = 0; i < size; i += pageSize) {
+		sum = sum + static_cast<unsigned char>(data[i]);
+	}
+	return sum;
+}
+
+template <typename Load>
+static double	timeLoad(const std::string& filename, bool cold, Load load) {
+	if (cold) {
+		evictFromPageCache(filename);
+	}
+
+	auto	start = std::chrono::high_resolution_clock::now();
+
+	load();
+
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void	benchmarkFileLoading(const std::vector<std::string>& filenames, std::ostream& out) {
+	const int	runs = 5;
+
+	out << "File loading, best of " << runs << " runs (cold runs evict the page cache first)" << std::endl;
+
+	for (const auto& filename : filenames) {
+		size_t	size = MappedFile(filename).size();
+
+		out << "  " << filename << " (" << size << " bytes)" << std::endl;
+
+		for (bool cold : {true, false}) {
+			double	readMs = 1e30;
+			double	mapMs = 1e30;
+
+			if (!cold) {
+				readFile(filename);
+			}
+
+			for (int i = 0; i < runs; i++) {
+				readMs = std::min(readMs, timeLoad(filename, cold, [&filename]() {
+					std::vector<char>	data = readFile(filename);
+
+					touchPages(data.data(), data.size());
+				}));
+				mapMs = std::min(mapMs, timeLoad(filename, cold, [&filename]() {
+					MappedFile	file(filename);
+
+					touchPages(file.data(), file.size());
+				}));
+			}
+
+			out << "    " << (cold ? "cold" : "warm") << ": readFile " << readMs << " ms, MappedFile " << mapMs << " ms";
+			if (mapMs > 0.0) {
+				out << " (" << readMs / mapMs << "x)";
+			}
+			out << std::endl;
+		}
+	}
+}
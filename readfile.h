@@ -2,5 +2,51 @@
 
 #include <vector>
 #include <string>
+#include <ostream>
 
 std::vector<char>	readFile(const std::string& filename);
+
+// Access pattern passed to madvise for the whole mapping
+enum class	MapHint {
+	Normal,
+	Sequential,
+	Random,
+	WillNeed
+};
+
+// Read-only view of a whole file, backed by the page cache instead of a
+// heap copy. The mapping is page aligned, so SPIR-V and GPU-ready payloads
+// can be handed to Vulkan or the staging ring straight from data().
+class	MappedFile
+{
+	public:
+		MappedFile(void) = default;
+
+		explicit	MappedFile(const std::string& filename, MapHint hint = MapHint::Sequential);
+
+		MappedFile(MappedFile&& other) noexcept;
+
+		MappedFile&	operator=(MappedFile&& other) noexcept;
+
+		MappedFile(const MappedFile&) = delete;
+
+		MappedFile&	operator=(const MappedFile&) = delete;
+
+		~MappedFile(void);
+
+		const char*	data(void) const;
+
+		size_t	size(void) const;
+
+		bool	empty(void) const;
+
+		void	advise(MapHint hint, size_t offset, size_t count) const;
+
+	private:
+		void*	mapping = nullptr;
+		size_t	length = 0;
+
+		void	unmap(void);
+};
+
+void	benchmarkFileLoading(const std::vector<std::string>& filenames, std::ostream& out);
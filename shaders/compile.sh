@@ -2,3 +2,5 @@
 
 glslc shader.vert -o vert.spv
 glslc shader.frag -o frag.spv
+glslc mip.comp -o mip.spv
+glslc cull.comp -o cull.spv
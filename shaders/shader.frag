@@ -1,13 +1,15 @@
 #version 450
 
-layout(binding = 1) uniform sampler2D texSampler;
+layout(binding = 1) uniform sampler2DArray texSampler;
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in vec4 fragTint;
+layout(location = 3) flat in uint fragTextureLayer;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
 	//outColor = vec4(fragTexCoord, 0.0, 1.0);
-	outColor = texture(texSampler, fragTexCoord);
+	outColor = texture(texSampler, vec3(fragTexCoord, fragTextureLayer)) * fragTint;
 }
@@ -1,20 +1,43 @@
 #version 450
 
+// Set per pipeline: the instanced pipeline reads per-draw data from the
+// instance binding, the other from the uniform block at binding 2
+layout(constant_id = 0) const bool INSTANCED = false;
+
 layout(binding = 0) uniform UniformBufferObject {
 	mat4 model;
 	mat4 view;
 	mat4 proj;
 } ubo;
 
-layout(location = 0) in vec2 inPosition;
+layout(binding = 2) uniform DrawUniforms {
+	mat4 model;
+	vec4 tint;
+	uint textureLayer;
+} draw;
+
+// Vertex attributes may be packed (half, snorm16, unorm8, unorm16, see
+// Vertex.h); the vertex input stage converts them, and bounds relative
+// positions are mapped back by the model matrix, so no variant is needed
+layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 
+layout(location = 3) in mat4 instanceModel;
+layout(location = 7) in vec4 instanceTint;
+layout(location = 8) in uint instanceTextureLayer;
+
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec4 fragTint;
+layout(location = 3) flat out uint fragTextureLayer;
 
 void	main() {
-	gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 0.0, 1.0);
+	mat4	model = INSTANCED ? instanceModel : draw.model;
+
+	gl_Position = ubo.proj * ubo.view * ubo.model * model * vec4(inPosition, 1.0);
 	fragColor = inColor;
 	fragTexCoord = inTexCoord;
+	fragTint = INSTANCED ? instanceTint : draw.tint;
+	fragTextureLayer = INSTANCED ? instanceTextureLayer : draw.textureLayer;
 }
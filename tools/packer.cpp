@@ -0,0 +1,216 @@
+// Packs loose assets into an archive readable by AssetArchive.
+//
+//   packer [--lz4] OUTPUT FILE...
+//
+// Entries are named by the paths given on the command line. Images are
+// decoded to RGBA8 so the runtime only has to copy them into the staging
+// ring; everything else is stored as is.
+
+#include "../AssetArchive.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+#ifdef HAVE_LZ4
+# include <lz4.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+// VK_FORMAT_R8G8B8A8_SRGB, kept numeric so the tool does not need Vulkan
+const uint32_t	FORMAT_R8G8B8A8_SRGB = 43;
+
+struct	PackedAsset {
+	std::string			name;
+	ArchiveEntry		entry{};
+	std::vector<char>	payload;
+};
+
+static bool	isImage(const std::string& name) {
+	std::string	extension = name.substr(name.find_last_of('.') + 1);
+
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return extension == "jpg" || extension == "jpeg" || extension == "png"
+		|| extension == "tga" || extension == "bmp";
+}
+
+static PackedAsset	packAsset(const std::string& name, bool compress) {
+	PackedAsset	asset;
+	MappedFile	file(name);
+
+	asset.name = name;
+	asset.entry.nameHash = fnv1a64(name.data(), name.size());
+	asset.entry.nameLength = static_cast<uint32_t>(name.size());
+
+	if (isImage(name)) {
+		int			width, height, channels;
+		stbi_uc*	pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.data()), static_cast<int>(file.size()),
+				&width, &height, &channels, STBI_rgb_alpha);
+
+		if (pixels == nullptr) {
+			throw std::runtime_error("failed to decode " + name + ": " + stbi_failure_reason());
+		}
+
+		asset.entry.type = AssetType::Image;
+		asset.entry.width = static_cast<uint32_t>(width);
+		asset.entry.height = static_cast<uint32_t>(height);
+		asset.entry.format = FORMAT_R8G8B8A8_SRGB;
+		asset.payload.assign(pixels, pixels + size_t(width) * height * 4);
+		stbi_image_free(pixels);
+	} else {
+		asset.entry.type = AssetType::Raw;
+		asset.payload.assign(file.data(), file.data() + file.size());
+	}
+
+	asset.entry.size = asset.payload.size();
+	asset.entry.compression = AssetCompression::None;
+
+#ifdef HAVE_LZ4
+	// Only kept when it actually saves space
+	if (compress && !asset.payload.empty()) {
+		std::vector<char>	compressed(LZ4_compressBound(static_cast<int>(asset.payload.size())));
+		int					compressedSize = LZ4_compress_default(asset.payload.data(), compressed.data(),
+				static_cast<int>(asset.payload.size()), static_cast<int>(compressed.size()));
+
+		if (compressedSize > 0 && static_cast<size_t>(compressedSize) < asset.payload.size()) {
+			compressed.resize(compressedSize);
+			asset.payload.swap(compressed);
+			asset.entry.compression = AssetCompression::LZ4;
+		}
+	}
+#else
+	(void)compress;
+#endif
+
+	asset.entry.storedSize = asset.payload.size();
+
+	return asset;
+}
+
+static uint64_t	alignUp(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static void	writeArchive(const std::string& output, std::vector<PackedAsset>& assets) {
+	ArchiveHeader			header{};
+	std::vector<uint32_t>	buckets;
+	std::string				names;
+	uint64_t				offset;
+
+	header.magic = ARCHIVE_MAGIC;
+	header.version = ARCHIVE_VERSION;
+	header.entryCount = static_cast<uint32_t>(assets.size());
+
+	// Load factor of at most one half keeps probe sequences short
+	header.bucketCount = 1;
+	while (header.bucketCount < assets.size() * 2 || header.bucketCount <= assets.size()) {
+		header.bucketCount *= 2;
+	}
+	buckets.assign(header.bucketCount, ARCHIVE_EMPTY_BUCKET);
+
+	for (uint32_t i = 0; i < assets.size(); i++) {
+		uint32_t	mask = header.bucketCount - 1;
+		uint32_t	index = static_cast<uint32_t>(assets[i].entry.nameHash) & mask;
+
+		while (buckets[index] != ARCHIVE_EMPTY_BUCKET) {
+			if (assets[buckets[index]].name == assets[i].name) {
+				throw std::runtime_error("duplicate asset " + assets[i].name);
+			}
+			index = (index + 1) & mask;
+		}
+		buckets[index] = i;
+
+		assets[i].entry.nameOffset = static_cast<uint32_t>(names.size());
+		names += assets[i].name;
+	}
+
+	header.bucketsOffset = sizeof(ArchiveHeader);
+	header.entriesOffset = header.bucketsOffset + buckets.size() * sizeof(uint32_t);
+	header.entriesOffset = alignUp(header.entriesOffset, alignof(ArchiveEntry));
+	header.namesOffset = header.entriesOffset + assets.size() * sizeof(ArchiveEntry);
+	header.namesSize = names.size();
+
+	offset = alignUp(header.namesOffset + header.namesSize, ARCHIVE_ALIGNMENT);
+	for (auto& asset : assets) {
+		asset.entry.offset = offset;
+		offset = alignUp(offset + asset.entry.storedSize, ARCHIVE_ALIGNMENT);
+	}
+
+	std::string		tmpOutput = output + ".tmp";
+	std::ofstream	file(tmpOutput, std::ios::binary | std::ios::trunc);
+
+	if (!file.is_open()) {
+		throw std::runtime_error("failed to create " + tmpOutput);
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(buckets.data()), buckets.size() * sizeof(uint32_t));
+	file.seekp(header.entriesOffset);
+	for (const auto& asset : assets) {
+		file.write(reinterpret_cast<const char*>(&asset.entry), sizeof(asset.entry));
+	}
+	file.write(names.data(), names.size());
+	for (const auto& asset : assets) {
+		file.seekp(asset.entry.offset);
+		file.write(asset.payload.data(), asset.payload.size());
+	}
+
+	// Pad to the alignment so the last payload can be mapped in whole pages
+	if (static_cast<uint64_t>(file.tellp()) < offset) {
+		file.seekp(offset - 1);
+		file.put('\0');
+	}
+	file.close();
+
+	if (!file || std::rename(tmpOutput.c_str(), output.c_str()) != 0) {
+		std::remove(tmpOutput.c_str());
+		throw std::runtime_error("failed to write " + output);
+	}
+}
+
+int	main(int argc, char** argv)
+{
+	bool						compress = false;
+	int							first = 1;
+	std::vector<PackedAsset>	assets;
+	uint64_t					rawBytes = 0;
+	uint64_t					storedBytes = 0;
+
+	if (first < argc && std::strcmp(argv[first], "--lz4") == 0) {
+		compress = true;
+		first++;
+#ifndef HAVE_LZ4
+		std::cerr << "packer was built without LZ4, storing entries uncompressed" << std::endl;
+#endif
+	}
+
+	if (argc - first < 2) {
+		std::cerr << "usage: " << argv[0] << " [--lz4] OUTPUT FILE..." << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		for (int i = first + 1; i < argc; i++) {
+			assets.push_back(packAsset(argv[i], compress));
+			rawBytes += assets.back().entry.size;
+			storedBytes += assets.back().entry.storedSize;
+		}
+
+		writeArchive(argv[first], assets);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "Packed " << assets.size() << " assets into " << argv[first] << " ("
+		<< rawBytes << " bytes, " << storedBytes << " stored)" << std::endl;
+
+	return EXIT_SUCCESS;
+}